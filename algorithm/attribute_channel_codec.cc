@@ -0,0 +1,235 @@
+#include "algorithm/attribute_channel_codec.h"
+#include "utils/double.h"
+#include "utils/elias_gamma_codec.h"
+#include "utils/xor_residual_codec.h"
+#include "utils/zig_zag_codec.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+int EstimateEliasGammaBits(uint64_t value) {
+    return 2 * (63 - __builtin_clzll(value)) + 1;
+}
+
+}  // namespace
+
+AttributeChannelCodec::AttributeChannelCodec(const AttributeChannel& channel)
+    : channel_(channel),
+      lossless_float_(!channel.is_integer && channel.epsilon == 0),
+      wraps_(channel.kind == AttributeChannel::HEADING && channel.epsilon > 0),
+      quant_step_(2 * channel.epsilon * 0.999),
+      integer_step_(2 * static_cast<int64_t>(std::floor(channel.epsilon)) + 1) {}
+
+void AttributeChannelCodec::Reset() {
+    size_ = 0;
+    frequency_[LDR] = 60;
+    frequency_[CP] = 10;
+    frequency_[ZP] = 30;
+    Rerank();
+    window_head_ = 0;
+    window_size_ = 0;
+    symbols_seen_ = 0;
+}
+
+int AttributeChannelCodec::WriteChannel(OutputBitStream* out) const {
+    bool lossless = channel_.epsilon == 0;
+    int bits = out->WriteInt(channel_.kind, 2);
+    bits += out->WriteBit(channel_.is_integer);
+    bits += out->WriteBit(lossless);
+    if (!lossless) {
+        bits += out->WriteLong(Double::DoubleToLongBits(channel_.epsilon), 64);
+    }
+    return bits;
+}
+
+AttributeChannel AttributeChannelCodec::ReadChannel(InputBitStream* in) {
+    AttributeChannel channel;
+    channel.kind = static_cast<AttributeChannel::Kind>(in->ReadInt(2));
+    channel.is_integer = in->ReadBit();
+    bool lossless = in->ReadBit();
+    channel.epsilon = lossless ? 0 : Double::LongBitsToDouble(in->ReadLong(64));
+    return channel;
+}
+
+int AttributeChannelCodec::Encode(double value, uint64_t timestamp, OutputBitStream* out) {
+    if (size_ == 0) {
+        if (channel_.is_integer) {
+            int64_t integer_value = std::llround(value);
+            Push(static_cast<double>(integer_value), timestamp);
+            return out->WriteLong(static_cast<uint64_t>(integer_value), 64);
+        }
+        Push(value, timestamp);
+        return out->WriteLong(Double::DoubleToLongBits(value), 64);
+    }
+
+    double predictions[kNumPredictors];
+    Predict(timestamp, predictions);
+
+    Predictor best = LDR;
+    int best_cost = FlagBits(LDR) + EstimateCost(value, predictions[LDR]);
+    for (Predictor predictor : {CP, ZP}) {
+        int cost = FlagBits(predictor) + EstimateCost(value, predictions[predictor]);
+        if (cost < best_cost) {
+            best_cost = cost;
+            best = predictor;
+        }
+    }
+
+    // Rank r: r ones and a terminating zero, except for the last rank
+    int rank = rank_[best];
+    uint32_t code = (1u << rank) - 1;
+    if (rank < kNumPredictors - 1) code <<= 1;
+    int bits = out->WriteInt(code, FlagBits(best));
+    AddToWindow(best);
+
+    double prediction = predictions[best];
+    if (lossless_float_) {
+        bits += XorResidualCodec::Encode(
+            Double::DoubleToLongBits(value) ^ Double::DoubleToLongBits(prediction), out);
+        Push(value, timestamp);
+    } else {
+        int64_t quantized = Quantize(value, prediction);
+        bits += EliasGammaCodec::Encode(ZigZagCodec::Encode(quantized) + 1, out);
+        Push(Reconstruct(prediction, quantized), timestamp);
+    }
+    return bits;
+}
+
+double AttributeChannelCodec::Decode(uint64_t timestamp, InputBitStream* in) {
+    if (size_ == 0) {
+        uint64_t raw = in->ReadLong(64);
+        Push(channel_.is_integer ? static_cast<double>(static_cast<int64_t>(raw)) : Double::LongBitsToDouble(raw),
+             timestamp);
+        return value();
+    }
+
+    double predictions[kNumPredictors];
+    Predict(timestamp, predictions);
+
+    int rank = 0;
+    while (rank < kNumPredictors - 1 && in->ReadBit()) rank++;
+    Predictor predictor = by_rank_[rank];
+    AddToWindow(predictor);
+
+    double prediction = predictions[predictor];
+    if (lossless_float_) {
+        uint64_t xor_value = XorResidualCodec::Decode(in);
+        Push(Double::LongBitsToDouble(Double::DoubleToLongBits(prediction) ^ xor_value), timestamp);
+    } else {
+        int64_t quantized = ZigZagCodec::Decode(EliasGammaCodec::Decode(in) - 1);
+        Push(Reconstruct(prediction, quantized), timestamp);
+    }
+    return value();
+}
+
+void AttributeChannelCodec::Predict(uint64_t timestamp, double predictions[kNumPredictors]) const {
+    double last = history_[2];
+    predictions[ZP] = last;
+    if (size_ < 2) {
+        predictions[LDR] = last;
+        predictions[CP] = last;
+        return;
+    }
+
+    // Same dt fallbacks as the position predictors
+    int64_t delta_time_signed = static_cast<int64_t>(timestamp) - static_cast<int64_t>(timestamps_[2]);
+    double dt = (delta_time_signed > 0) ? static_cast<double>(delta_time_signed) : 1.0;
+
+    double velocity[3] = {0, 0, 0};
+    for (int i = 3 - size_ + 1; i < 3; ++i) {
+        int64_t step = static_cast<int64_t>(timestamps_[i]) - static_cast<int64_t>(timestamps_[i - 1]);
+        if (step > 0) velocity[i] = Difference(history_[i], history_[i - 1]) / static_cast<double>(step);
+    }
+
+    predictions[LDR] = last + velocity[2] * dt;
+    if (size_ >= 3) {
+        double acceleration = velocity[2] - velocity[1];
+        predictions[CP] = last + velocity[2] * dt + acceleration * dt * dt * 0.5;
+    } else {
+        predictions[CP] = predictions[LDR];
+    }
+
+    // Headings wrap: bring the extrapolations back into [0, 360), since after a
+    // long gap they grow so large that prediction + residual loses the bound
+    if (wraps_) {
+        for (int predictor : {LDR, CP}) {
+            double wrapped = std::fmod(predictions[predictor], 360.0);
+            predictions[predictor] = !std::isfinite(wrapped) ? last : wrapped < 0 ? wrapped + 360.0 : wrapped;
+        }
+    }
+}
+
+double AttributeChannelCodec::Difference(double a, double b) const {
+    double difference = a - b;
+    if (channel_.kind == AttributeChannel::HEADING) {
+        difference -= 360.0 * std::round(difference / 360.0);
+    }
+    return difference;
+}
+
+void AttributeChannelCodec::Push(double value, uint64_t timestamp) {
+    history_[0] = history_[1];
+    history_[1] = history_[2];
+    history_[2] = value;
+    timestamps_[0] = timestamps_[1];
+    timestamps_[1] = timestamps_[2];
+    timestamps_[2] = timestamp;
+    if (size_ < 3) size_++;
+}
+
+int64_t AttributeChannelCodec::Quantize(double value, double prediction) const {
+    if (channel_.is_integer) {
+        int64_t residual = std::llround(value) - std::llround(prediction);
+        if (wraps_) residual = ((residual % 360) + 540) % 360 - 180;
+        // Odd step: no ties, |residual - q * step| <= floor(epsilon)
+        int64_t half = integer_step_ / 2;
+        return residual >= 0 ? (residual + half) / integer_step_ : -((half - residual) / integer_step_);
+    }
+    double residual = value - prediction;
+    if (wraps_) residual -= 360.0 * std::round(residual / 360.0);
+    return static_cast<int64_t>(std::round(residual / quant_step_));
+}
+
+double AttributeChannelCodec::Reconstruct(double prediction, int64_t quantized) const {
+    if (channel_.is_integer) {
+        int64_t reconstructed = std::llround(prediction) + quantized * integer_step_;
+        if (wraps_) reconstructed = ((reconstructed % 360) + 360) % 360;
+        return static_cast<double>(reconstructed);
+    }
+    double reconstructed = prediction + quantized * quant_step_;
+    if (wraps_) reconstructed -= 360.0 * std::floor(reconstructed / 360.0);
+    return reconstructed;
+}
+
+int AttributeChannelCodec::EstimateCost(double value, double prediction) const {
+    if (lossless_float_) {
+        return XorResidualCodec::EstimateBits(Double::DoubleToLongBits(value) ^ Double::DoubleToLongBits(prediction));
+    }
+    return EstimateEliasGammaBits(ZigZagCodec::Encode(Quantize(value, prediction)) + 1);
+}
+
+void AttributeChannelCodec::AddToWindow(Predictor predictor) {
+    if (window_size_ == kSlidingWindowSize) {
+        frequency_[window_[window_head_]]--;
+        window_head_ = (window_head_ + 1) % kSlidingWindowSize;
+        window_size_--;
+    }
+    window_[(window_head_ + window_size_) % kSlidingWindowSize] = static_cast<uint8_t>(predictor);
+    window_size_++;
+    frequency_[predictor]++;
+
+    if (++symbols_seen_ % kRankInterval == 0) Rerank();
+}
+
+void AttributeChannelCodec::Rerank() {
+    Predictor order[kNumPredictors] = {LDR, CP, ZP};
+    // Higher frequency first, ties by predictor index
+    std::stable_sort(order, order + kNumPredictors, [this](Predictor a, Predictor b) {
+        return frequency_[a] > frequency_[b];
+    });
+    for (int rank = 0; rank < kNumPredictors; ++rank) {
+        by_rank_[rank] = order[rank];
+        rank_[order[rank]] = rank;
+    }
+}
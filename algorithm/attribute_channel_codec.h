@@ -0,0 +1,108 @@
+#pragma once
+
+#include "utils/output_bit_stream.h"
+#include "utils/input_bit_stream.h"
+#include <cstdint>
+
+/**
+ * Extra per-point channel carried next to the position (altitude, speed, ...)
+ */
+struct AttributeChannel {
+    enum Kind {
+        ALTITUDE = 0,
+        SPEED = 1,
+        HEADING = 2,  // degrees; lossy channels wrap around 360
+        CUSTOM = 3
+    };
+
+    Kind kind = CUSTOM;
+    bool is_integer = false;  // values are whole numbers (up to 2^53)
+    double epsilon = 0;       // max absolute error, 0 = lossless
+
+    AttributeChannel() {}
+    AttributeChannel(Kind k, double eps, bool integer = false)
+        : kind(k), is_integer(integer), epsilon(eps) {}
+};
+
+/**
+ * Attribute Channel Codec
+ *
+ * One-dimensional counterpart of CoST's position coding for a single channel.
+ * The channel shares the point timestamps, so it only pays for a predictor
+ * flag and a residual:
+ *   - LDR/CP/ZP predictions over the reconstructed channel history
+ *   - cost-based selection (flag bits + residual bits), ties LDR > CP > ZP
+ *   - ranked flag codes (0, 10, 11) adapted over a sliding window
+ *   - residuals: quantized ZigZag + Elias Gamma when lossy or integer,
+ *     XOR of the IEEE bits (XorResidualCodec) when lossless floating point
+ *
+ * The same class runs on both sides; Encode() and Decode() keep identical state.
+ * Lossy channels need finite values.
+ */
+class AttributeChannelCodec {
+public:
+    explicit AttributeChannelCodec(const AttributeChannel& channel);
+
+    const AttributeChannel& channel() const { return channel_; }
+
+    // Back to the state before the first value of a stream
+    void Reset();
+
+    // Channel table entry: kind (2), integer (1), lossless (1), epsilon (64, lossy only)
+    int WriteChannel(OutputBitStream* out) const;
+    static AttributeChannel ReadChannel(InputBitStream* in);
+
+    /**
+     * Encode the channel value of the next point (the first value is stored raw)
+     * @return bits written
+     */
+    int Encode(double value, uint64_t timestamp, OutputBitStream* out);
+
+    /**
+     * Decode the channel value of the next point
+     */
+    double Decode(uint64_t timestamp, InputBitStream* in);
+
+    // Last reconstructed value
+    double value() const { return history_[2]; }
+
+private:
+    enum Predictor { LDR = 0, CP = 1, ZP = 2 };
+    static constexpr int kNumPredictors = 3;
+    static constexpr int kSlidingWindowSize = 1000;
+    static constexpr int kRankInterval = 100;
+
+    const AttributeChannel channel_;
+    const bool lossless_float_;
+    const bool wraps_;                // lossy heading
+    const double quant_step_;         // floating-point channels
+    const int64_t integer_step_;      // integer channels, odd
+
+    double history_[3] = {0, 0, 0};
+    uint64_t timestamps_[3] = {0, 0, 0};
+    int size_ = 0;
+
+    // Predictor flag model
+    int frequency_[kNumPredictors] = {60, 10, 30};
+    int rank_[kNumPredictors] = {0, 2, 1};
+    Predictor by_rank_[kNumPredictors] = {LDR, ZP, CP};
+    uint8_t window_[kSlidingWindowSize];
+    int window_head_ = 0;
+    int window_size_ = 0;
+    int symbols_seen_ = 0;
+
+    void Predict(uint64_t timestamp, double predictions[kNumPredictors]) const;
+    double Difference(double a, double b) const;
+    void Push(double value, uint64_t timestamp);
+
+    int FlagBits(Predictor predictor) const {
+        return rank_[predictor] + (rank_[predictor] < kNumPredictors - 1 ? 1 : 0);
+    }
+    void AddToWindow(Predictor predictor);
+    void Rerank();
+
+    // Quantized residual and reconstruction (lossy or integer channels)
+    int64_t Quantize(double value, double prediction) const;
+    double Reconstruct(double prediction, int64_t quantized) const;
+    int EstimateCost(double value, double prediction) const;
+};
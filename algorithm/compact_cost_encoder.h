@@ -0,0 +1,390 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+/**
+ * Compact CoST encoder state
+ *
+ * CoST encoding with a few hundred bytes of state per stream, for fleets with
+ * millions of concurrent vehicles. Differences from CoSTCompressor:
+ *   - predictor flags use CompactFlagModel (decayed frequencies instead of a
+ *     1000-symbol window); the stream announces this with the compact-profile
+ *     header feature, and CoSTDecompressor follows it
+ *   - mode switching compares LDR-only and multi-predictor costs summed since
+ *     the previous evaluation point instead of two 256-entry ring buffers (for
+ *     count windows this is the same window CoSTCompressor looks at)
+ *   - no statistics, route templates, integer grid, attributes or lossless mode
+ *   - complete bytes are handed to the caller after each point, so the state
+ *     only keeps up to 7 pending bits
+ *
+ * Immutable settings live in CompactCoSTConfig, shared by all streams.
+ * The header has no dependencies beyond <stdint.h> and <math.h>.
+ */
+
+/**
+ * Predictor and mode-window arithmetic shared by CompactCoSTEncoder,
+ * CoSTCompressor (and its lookahead search) and CoSTDecompressor, which must
+ * agree to the last bit
+ */
+struct CoSTArithmetic {
+    static constexpr int kModeSwitchCost = 1;  // bits a mode switch must save (the mode bit)
+
+    // Seconds to predict over: 1 for a repeated or backwards timestamp
+    static double TimeStep(uint64_t timestamp, uint64_t last_timestamp) {
+        int64_t delta_time_signed = static_cast<int64_t>(timestamp) - static_cast<int64_t>(last_timestamp);
+        return delta_time_signed > 0 ? static_cast<double>(delta_time_signed) : 1.0;
+    }
+
+    // Per-axis velocity between two reconstructed points, 0 without elapsed time
+    static double Velocity(double position, double last_position, uint64_t timestamp, uint64_t last_timestamp) {
+        int64_t delta_time_signed = static_cast<int64_t>(timestamp) - static_cast<int64_t>(last_timestamp);
+        return delta_time_signed > 0 ? (position - last_position) / static_cast<double>(delta_time_signed) : 0;
+    }
+
+    // LDR: position + velocity * dt
+    static double Linear(double position, double velocity, double dt) {
+        return position + velocity * dt;
+    }
+
+    // CP: position + velocity * dt + 0.5 * acceleration * dt^2
+    static double Curved(double position, double velocity, double last_velocity, double dt) {
+        double dt_sq_half = dt * dt * 0.5;
+        return position + velocity * dt + (velocity - last_velocity) * dt_sq_half;
+    }
+
+    // Points that carry a mode bit: every evaluation_window-th point, or with
+    // the time window the first point time_window_seconds after the previous
+    // one (none while timestamps go backwards)
+    static bool IsEvaluationPoint(uint32_t point_number, uint64_t timestamp, uint32_t evaluation_window,
+                                  bool use_time_window, uint64_t time_window_seconds,
+                                  uint64_t& last_evaluation_timestamp) {
+        if (!use_time_window) return point_number % evaluation_window == 0;
+        if (last_evaluation_timestamp == 0) last_evaluation_timestamp = timestamp;
+        if (timestamp >= last_evaluation_timestamp && timestamp - last_evaluation_timestamp >= time_window_seconds) {
+            last_evaluation_timestamp = timestamp;
+            return true;
+        }
+        return false;
+    }
+};
+
+/**
+ * Ranked predictor flag codes over decayed predictor frequencies
+ * (shared by the compact encoder and CoSTDecompressor)
+ */
+struct CompactFlagModel {
+    static constexpr int kPredictors = 3;          // LDR, CP, ZP
+    static constexpr int kDecayThreshold = 1024;   // halve the counts when they sum to this
+
+    uint16_t frequency[kPredictors];
+    uint8_t rank[kPredictors];     // predictor -> rank
+    uint8_t by_rank[kPredictors];  // rank -> predictor
+
+    void Reset() { Reset(60, 10, 30); }  // same priors as CoSTCompressor
+
+    // Start from other pseudo-counts (CoSTCompressor::PredictorPrior)
+    void Reset(uint16_t ldr, uint16_t cp, uint16_t zp) {
+        frequency[0] = ldr;
+        frequency[1] = cp;
+        frequency[2] = zp;
+        Rerank();
+    }
+
+    // Rank r: r ones and a terminating zero, except for the last rank (0, 10, 11)
+    int CodeLength(int predictor) const {
+        return rank[predictor] + (rank[predictor] < kPredictors - 1 ? 1 : 0);
+    }
+    uint32_t Code(int predictor) const {
+        uint32_t ones = (1u << rank[predictor]) - 1;
+        return rank[predictor] < kPredictors - 1 ? ones << 1 : ones;
+    }
+
+    void Add(int predictor) {
+        frequency[predictor]++;
+        if (frequency[0] + frequency[1] + frequency[2] >= kDecayThreshold) {
+            for (int i = 0; i < kPredictors; ++i) frequency[i] = (frequency[i] + 1) >> 1;
+        }
+        Rerank();
+    }
+
+    // Higher frequency first, ties by predictor index
+    void Rerank() {
+        uint8_t order[kPredictors] = {0, 1, 2};
+        for (int i = 1; i < kPredictors; ++i) {
+            for (int j = i; j > 0 && frequency[order[j]] > frequency[order[j - 1]]; --j) {
+                uint8_t t = order[j];
+                order[j] = order[j - 1];
+                order[j - 1] = t;
+            }
+        }
+        for (int r = 0; r < kPredictors; ++r) {
+            by_rank[r] = order[r];
+            rank[order[r]] = static_cast<uint8_t>(r);
+        }
+    }
+};
+
+/**
+ * Immutable encoder settings, shared by any number of streams. The evaluation
+ * window is clamped to [1, kMaxEvaluationWindow]: the top bit of its header
+ * field announces the header extensions. The encoder has no lossless mode and
+ * cannot report errors, so an error bound below kMinErrorBound (0, negative
+ * or NaN) is raised to it
+ */
+struct CompactCoSTConfig {
+    static constexpr uint16_t kMaxEvaluationWindow = 0x7FFF;  // CoSTCompressor::kMaxEvaluationWindow
+    static constexpr double kMinErrorBound = 1e-9;            // degrees, about 0.1 mm
+
+    double epsilon;                // stored error bound (epsilon * 0.999)
+    double quant_step;             // 2 * epsilon * 0.999
+    uint16_t block_size;           // header field: points the decoder reads unless WritePointCount lowers it
+    uint16_t evaluation_window;
+    bool use_time_window;
+    uint32_t time_window_seconds;
+
+    CompactCoSTConfig(double error_bound, uint16_t block = 0xFFFF, uint16_t window = 96,
+                      bool time_window = false, uint32_t window_seconds = 60)
+        : epsilon((error_bound >= kMinErrorBound ? error_bound : kMinErrorBound) * 0.999),
+          quant_step(2 * epsilon),
+          block_size(block != 0 ? block : 0xFFFF),  // 0 marks the compact header (stream profiles)
+          evaluation_window(window == 0 ? 1 : (window > kMaxEvaluationWindow ? kMaxEvaluationWindow : window)),
+          use_time_window(time_window),
+          time_window_seconds(window_seconds) {}
+};
+
+/**
+ * Per-stream state (plain data, 128 bytes)
+ */
+struct alignas(64) CompactCoSTState {
+    double longitude;                    // last reconstructed point
+    double latitude;
+    uint64_t timestamp;
+    double velocity[2][2];               // [last, previous][lon, lat]
+    uint64_t last_evaluation_timestamp;
+    uint64_t bit_buffer;                 // pending output bits (low bits_in_buffer bits)
+    int32_t window_cost_multi;
+    int32_t window_cost_ldr_only;
+    uint32_t points;
+    uint32_t window_points;
+    CompactFlagModel flags;
+    uint8_t bits_in_buffer;
+    uint8_t history_size;                // reconstructed points seen, up to 3
+    uint8_t ldr_only;                    // current mode
+
+    void Reset() {
+        points = 0;
+        bits_in_buffer = 0;
+        bit_buffer = 0;
+    }
+};
+
+class CompactCoSTEncoder {
+public:
+    static constexpr uint32_t kHeaderExtensionFlag = 1u << 15;  // CoSTCompressor::kHeaderExtensionFlag
+    static constexpr uint32_t kFeatureCompactProfile = 1u << 3; // CoSTCompressor::FEATURE_COMPACT_PROFILE
+    static constexpr int kMaxBytesPerPoint = 48;                // header + first point, or one point
+
+    /**
+     * Encode the next point of a stream (the first point after Reset() also writes the header)
+     * @param out receives the completed bytes, at least kMaxBytesPerPoint long
+     * @return number of bytes written to out
+     */
+    static int Encode(const CompactCoSTConfig& config, CompactCoSTState& state,
+                      double longitude, double latitude, uint64_t timestamp, uint8_t* out) {
+        Writer writer{state, out, 0};
+        if (state.points++ == 0) {
+            WriteHeader(config, state, writer, longitude, latitude, timestamp);
+            return writer.size;
+        }
+
+        // Predictions from the reconstructed state
+        int64_t delta_time_signed = static_cast<int64_t>(timestamp) - static_cast<int64_t>(state.timestamp);
+        double dt = CoSTArithmetic::TimeStep(timestamp, state.timestamp);
+        double position[2] = {state.longitude, state.latitude};
+        double pred[3][2];
+        for (int axis = 0; axis < 2; ++axis) {
+            pred[2][axis] = position[axis];
+            if (state.history_size < 2) {
+                pred[0][axis] = pred[1][axis] = position[axis];
+                continue;
+            }
+            pred[0][axis] = CoSTArithmetic::Linear(position[axis], state.velocity[0][axis], dt);
+            pred[1][axis] = state.history_size >= 3
+                ? CoSTArithmetic::Curved(position[axis], state.velocity[0][axis], state.velocity[1][axis], dt)
+                : pred[0][axis];
+        }
+
+        // Cost-based selection, ties LDR > CP > ZP
+        int64_t q[3][2];
+        int cost[3];
+        for (int p = 0; p < 3; ++p) {
+            q[p][0] = static_cast<int64_t>(round((longitude - pred[p][0]) / config.quant_step));
+            q[p][1] = static_cast<int64_t>(round((latitude - pred[p][1]) / config.quant_step));
+            cost[p] = GammaBits(ZigZag(q[p][0]) + 1) + GammaBits(ZigZag(q[p][1]) + 1);
+        }
+        int cost_ldr_error = cost[0];
+        int best = 0;
+        int best_cost = state.flags.CodeLength(0) + cost[0];
+        for (int p = 1; p < 3; ++p) {
+            int c = state.flags.CodeLength(p) + cost[p];
+            if (c < best_cost) {
+                best_cost = c;
+                best = p;
+            }
+        }
+        state.window_cost_multi += best_cost;
+        state.window_cost_ldr_only += cost_ldr_error;
+        state.window_points++;
+
+        if (state.ldr_only) {
+            best = 0;
+        } else {
+            writer.Write(state.flags.Code(best), state.flags.CodeLength(best));
+            state.flags.Add(best);
+        }
+        writer.Write64(static_cast<uint64_t>(delta_time_signed), 64);
+        writer.WriteGamma(ZigZag(q[best][0]) + 1);
+        writer.WriteGamma(ZigZag(q[best][1]) + 1);
+
+        double reconstructed_lon = pred[best][0] + q[best][0] * config.quant_step;
+        double reconstructed_lat = pred[best][1] + q[best][1] * config.quant_step;
+        Push(state, reconstructed_lon, reconstructed_lat, timestamp);
+
+        WriteModeBitIfDue(config, state, writer, timestamp);
+        return writer.size;
+    }
+
+    /**
+     * Flush the pending bits (zero padded) at the end of the stream
+     * @return number of bytes written to out (0 or 1)
+     */
+    static int Finish(CompactCoSTState& state, uint8_t* out) {
+        if (state.bits_in_buffer == 0) return 0;
+        out[0] = static_cast<uint8_t>(state.bit_buffer << (8 - state.bits_in_buffer));
+        state.bits_in_buffer = 0;
+        return 1;
+    }
+
+    /**
+     * Record the point count of a stream shorter than the block in its header,
+     * as CoSTCompressor::Close does, so that CoSTDecompressor stops after the
+     * last point. Only for streams the caller still holds after Finish(): a
+     * stream sent point by point keeps block_size, and its reader has to know
+     * the count
+     * @param stream the first two bytes of the stream (the block size field)
+     */
+    static void WritePointCount(const CompactCoSTConfig& config, const CompactCoSTState& state, uint8_t* stream) {
+        if (state.points == 0 || state.points >= config.block_size) return;
+        stream[0] = static_cast<uint8_t>(state.points >> 8);
+        stream[1] = static_cast<uint8_t>(state.points);
+    }
+
+private:
+    struct Writer {
+        CompactCoSTState& state;
+        uint8_t* out;
+        int size;
+
+        // len <= 32
+        void Write(uint64_t value, int len) {
+            state.bit_buffer = (state.bit_buffer << len) | (value & ((1ull << len) - 1));
+            int bits = state.bits_in_buffer + len;
+            while (bits >= 8) {
+                bits -= 8;
+                out[size++] = static_cast<uint8_t>(state.bit_buffer >> bits);
+            }
+            state.bits_in_buffer = static_cast<uint8_t>(bits);
+        }
+
+        void Write64(uint64_t value, int len) {
+            if (len > 32) {
+                Write(value >> 32, len - 32);
+                Write(value & 0xFFFFFFFFull, 32);
+            } else {
+                Write(value, len);
+            }
+        }
+
+        // Elias Gamma: n zeros, then the n + 1 bits of value
+        void WriteGamma(uint64_t value) {
+            int n = 63 - __builtin_clzll(value);
+            for (int zeros = n; zeros > 0; zeros -= 32) Write(0, zeros < 32 ? zeros : 32);
+            Write64(value, n + 1);
+        }
+    };
+
+    static uint64_t ZigZag(int64_t value) {
+        return static_cast<uint64_t>((value << 1) ^ (value >> 63));
+    }
+
+    static int GammaBits(uint64_t value) {
+        return 2 * (63 - __builtin_clzll(value)) + 1;
+    }
+
+    static uint64_t DoubleBits(double value) {
+        uint64_t bits;
+        __builtin_memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    static void WriteHeader(const CompactCoSTConfig& config, CompactCoSTState& state, Writer& writer,
+                            double longitude, double latitude, uint64_t timestamp) {
+        writer.Write(config.block_size, 16);
+        writer.Write64(DoubleBits(config.epsilon), 64);
+        writer.Write(config.evaluation_window | kHeaderExtensionFlag, 16);
+        writer.Write(config.use_time_window, 1);
+        if (config.use_time_window) writer.Write(config.time_window_seconds, 32);
+        writer.Write(kFeatureCompactProfile, 16);
+        writer.Write64(DoubleBits(longitude), 64);
+        writer.Write64(DoubleBits(latitude), 64);
+        writer.Write64(timestamp, 64);
+
+        state.longitude = longitude;
+        state.latitude = latitude;
+        state.timestamp = timestamp;
+        state.velocity[0][0] = state.velocity[0][1] = 0;
+        state.velocity[1][0] = state.velocity[1][1] = 0;
+        state.history_size = 1;
+        state.ldr_only = 0;
+        state.flags.Reset();
+        state.window_cost_multi = 0;
+        state.window_cost_ldr_only = 0;
+        state.window_points = 0;
+        state.last_evaluation_timestamp = config.use_time_window ? timestamp : 0;
+    }
+
+    static void Push(CompactCoSTState& state, double longitude, double latitude, uint64_t timestamp) {
+        state.velocity[1][0] = state.velocity[0][0];
+        state.velocity[1][1] = state.velocity[0][1];
+        state.velocity[0][0] = CoSTArithmetic::Velocity(longitude, state.longitude, timestamp, state.timestamp);
+        state.velocity[0][1] = CoSTArithmetic::Velocity(latitude, state.latitude, timestamp, state.timestamp);
+        state.longitude = longitude;
+        state.latitude = latitude;
+        state.timestamp = timestamp;
+        if (state.history_size < 3) state.history_size++;
+    }
+
+    // Same evaluation points as CoSTCompressor::WriteModeBitIfDue
+    static void WriteModeBitIfDue(const CompactCoSTConfig& config, CompactCoSTState& state, Writer& writer,
+                                  uint64_t timestamp) {
+        if (!CoSTArithmetic::IsEvaluationPoint(state.points, timestamp, config.evaluation_window,
+                                               config.use_time_window, config.time_window_seconds,
+                                               state.last_evaluation_timestamp)) {
+            return;
+        }
+
+        if (state.window_points >= config.evaluation_window) {
+            const int kSwitchCost = CoSTArithmetic::kModeSwitchCost;
+            if (!state.ldr_only && state.window_cost_ldr_only < state.window_cost_multi - kSwitchCost) {
+                state.ldr_only = 1;
+            } else if (state.ldr_only && state.window_cost_multi < state.window_cost_ldr_only - kSwitchCost) {
+                state.ldr_only = 0;
+            }
+        }
+        state.window_cost_multi = 0;
+        state.window_cost_ldr_only = 0;
+        state.window_points = 0;
+        writer.Write(state.ldr_only, 1);
+    }
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "algorithm/compact_cost_encoder.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/**
+ * Slab pool of CompactCoSTState
+ *
+ * States are carved from slabs of kSlabSize cache-line aligned entries and
+ * recycled through a free list, so a fleet of streams costs one allocation
+ * per slab and stays densely packed in memory.
+ */
+class CompactCoSTStatePool {
+public:
+    static constexpr size_t kSlabSize = 4096;
+
+    // A reset state, ready for the first point of a new stream
+    CompactCoSTState* Acquire() {
+        CompactCoSTState* state;
+        if (!free_list_.empty()) {
+            state = free_list_.back();
+            free_list_.pop_back();
+        } else {
+            if (used_in_last_slab_ == kSlabSize) {
+                slabs_.push_back(std::make_unique<CompactCoSTState[]>(kSlabSize));
+                used_in_last_slab_ = 0;
+            }
+            state = &slabs_.back()[used_in_last_slab_++];
+        }
+        state->Reset();
+        live_++;
+        return state;
+    }
+
+    void Release(CompactCoSTState* state) {
+        free_list_.push_back(state);
+        live_--;
+    }
+
+    size_t size() const { return live_; }
+    size_t capacity() const { return slabs_.size() * kSlabSize; }
+
+private:
+    std::vector<std::unique_ptr<CompactCoSTState[]>> slabs_;
+    std::vector<CompactCoSTState*> free_list_;
+    size_t used_in_last_slab_ = kSlabSize;
+    size_t live_ = 0;
+};
@@ -1,143 +1,1209 @@
 #include "algorithm/cost_compressor.h"
+#include "algorithm/route_template_library.h"
+#include "algorithm/stream_profile_table.h"
+#include "algorithm/precision_map.h"
 #include "utils/elias_gamma_codec.h"
 #include "utils/zig_zag_codec.h"
+#include "utils/xor_residual_codec.h"
+#include "utils/post_office_solver.h"
 #include "utils/input_bit_stream.h"
 #include <iostream>
 #include <algorithm>
+#include <climits>
 #include <cmath>
+#include <stdexcept>
+
+static_assert(CompactCoSTEncoder::kHeaderExtensionFlag == CoSTCompressor::kHeaderExtensionFlag,
+              "compact encoder header layout");
+static_assert(CompactCoSTConfig::kMaxEvaluationWindow == CoSTCompressor::kMaxEvaluationWindow,
+              "compact encoder header layout");
+static_assert(CompactCoSTEncoder::kFeatureCompactProfile == CoSTCompressor::FEATURE_COMPACT_PROFILE,
+              "compact encoder header layout");
 
 // ==================== CoST Compressor Implementation ====================
 
+namespace {
+
+CoSTCompressor::Options WindowOptions(int evaluation_window, bool use_time_window, uint64_t time_window_seconds) {
+    CoSTCompressor::Options options;
+    options.evaluation_window = evaluation_window;
+    options.use_time_window = use_time_window;
+    options.time_window_seconds = time_window_seconds;
+    return options;
+}
+
+}  // namespace
+
 CoSTCompressor::CoSTCompressor(
     int block_size, double epsilon, int evaluation_window, 
     bool use_time_window, uint64_t time_window_seconds)
-    : kBlockSize(block_size), 
-      kEpsilon(epsilon * 0.999), 
-      kQuantStep(2 * epsilon * 0.999),
-      kEvaluationWindow(evaluation_window),
-      use_time_window_(use_time_window),
-      kTimeWindowSeconds(time_window_seconds) {
-    output_bit_stream_ = std::make_unique<OutputBitStream>(2 * block_size * 8);
+    : CoSTCompressor(block_size, epsilon, WindowOptions(evaluation_window, use_time_window, time_window_seconds)) {}
+
+CoSTCompressor::CoSTCompressor(int block_size, double epsilon, const Options& options) {
+    Configure(block_size, epsilon, options);
     history_states_.reserve(kMaxHistorySize);
     predictor_window_.reserve(kSlidingWindowSize);
+    ResetStreamState();
+}
+
+void CoSTCompressor::Reset() {
+    output_bit_stream_->Refresh();
+    for (AttributeChannelCodec& codec : attribute_codecs_) codec.Reset();
+    ResetStreamState();
+}
+
+void CoSTCompressor::Reset(int block_size, double epsilon) {
+    Reset(block_size, epsilon, options_);
+}
+
+void CoSTCompressor::Reset(int block_size, double epsilon, const Options& options) {
+    Configure(block_size, epsilon, options);
+    ResetStreamState();
+}
+
+void CoSTCompressor::Configure(int block_size, double epsilon, const Options& options) {
+    // Validate everything first so that a failed Reset leaves the compressor unchanged
+    if (block_size < 1) throw std::invalid_argument("CoST: block size must be >= 1");
+    if (!(epsilon >= 0)) throw std::invalid_argument("CoST: epsilon must be >= 0");
+    if (options.evaluation_window < 1 || options.evaluation_window > kMaxEvaluationWindow) {
+        throw std::invalid_argument("CoST: evaluation window must be in [1, 32767]");
+    }
+    if (epsilon == 0 && options.integer_grid) {
+        throw std::invalid_argument("CoST: the integer grid needs epsilon > 0");
+    }
+    if (options.integer_grid && route_templates_ != nullptr) {
+        throw std::invalid_argument("CoST: the route template predictor is not available on the integer grid");
+    }
+    if (options.attributes.size() > static_cast<size_t>(kMaxAttributes)) {
+        throw std::invalid_argument("CoST: too many attribute channels");
+    }
+    for (const AttributeChannel& channel : options.attributes) {
+        if (!(channel.epsilon >= 0)) throw std::invalid_argument("CoST: attribute epsilon must be >= 0");
+    }
+    if (options.level < kMinLevel || options.level > kMaxLevel) {
+        throw std::invalid_argument("CoST: level must be in [1, 5]");
+    }
+    if (options.lookahead < kLookaheadBlock) throw std::invalid_argument("CoST: invalid lookahead");
+    if (!(options.target_bits_per_point >= 0 && options.target_bytes_per_minute >= 0)) {
+        throw std::invalid_argument("CoST: rate targets must be >= 0");
+    }
+    bool rate_control = options.target_bits_per_point > 0 || options.target_bytes_per_minute > 0;
+    double epsilon_min = options.epsilon_min > 0 ? options.epsilon_min : epsilon;
+    double epsilon_max = options.epsilon_max > 0 ? options.epsilon_max : epsilon_min * kDefaultRateRange;
+    if (rate_control) {
+        if (options.target_bits_per_point > 0 && options.target_bytes_per_minute > 0) {
+            throw std::invalid_argument("CoST: set either target_bits_per_point or target_bytes_per_minute");
+        }
+        if (epsilon == 0 || options.integer_grid) {
+            throw std::invalid_argument("CoST: rate control needs epsilon > 0 and no integer grid");
+        }
+        if (!(epsilon_min <= epsilon && epsilon <= epsilon_max)) {
+            throw std::invalid_argument("CoST: epsilon must lie in [epsilon_min, epsilon_max]");
+        }
+    }
+    if (options.segment_mode) {
+        if (options.integer_grid || epsilon == 0) {
+            throw std::invalid_argument("CoST: segment mode is not available on the integer grid or lossless");
+        }
+        if (options.hex_lattice) {
+            throw std::invalid_argument("CoST: segment mode is not available with the hexagonal lattice");
+        }
+        if (options.level != kDefaultLevel || options.lookahead != 0) {
+            throw std::invalid_argument("CoST: segment mode needs level 3 without lookahead");
+        }
+    }
+    if (options.hex_lattice && (options.integer_grid || epsilon == 0)) {
+        throw std::invalid_argument("CoST: the hexagonal lattice is not available on the integer grid or lossless");
+    }
+    if (options.epsilon_in_meters) {
+        if (options.integer_grid || epsilon == 0 || options.hex_lattice) {
+            throw std::invalid_argument("CoST: the metric bound is not available on the integer grid, lossless "
+                                        "or with the hexagonal lattice");
+        }
+        // Latitude degrees from here on, as CoSTDecompressor::ReadHeader for profiles
+        epsilon = epsilon / kMetersPerDegree;
+        epsilon_min = epsilon_min / kMetersPerDegree;
+        epsilon_max = epsilon_max / kMetersPerDegree;
+    }
+    if (options.adaptive_residuals && (options.integer_grid || epsilon == 0)) {
+        throw std::invalid_argument("CoST: adaptive residuals are not available on the integer grid or lossless");
+    }
+    // The search prices every path against the committed model, whose contexts
+    // a path's own residuals would have moved
+    if (options.adaptive_residuals && (options.lookahead != 0 || options.level > kDefaultLevel)) {
+        throw std::invalid_argument("CoST: adaptive residuals are not available with lookahead or levels 4 and 5");
+    }
+    if (options.block_residual_classes && (options.integer_grid || epsilon == 0 || options.adaptive_residuals)) {
+        throw std::invalid_argument("CoST: block residual classes are not available on the integer grid, lossless "
+                                    "or with adaptive residuals");
+    }
+    if (options.lookahead != 0 && options.level < kDefaultLevel) {
+        throw std::invalid_argument("CoST: lookahead needs level >= 3");
+    }
+    if (options.level < kDefaultLevel && route_templates_ != nullptr) {
+        throw std::invalid_argument("CoST: the route template predictor needs level >= 3");
+    }
+    if (options.lookahead != 0 && options.integer_grid) {
+        throw std::invalid_argument("CoST: lookahead is not available on the integer grid");
+    }
+    if (precision_map_ != nullptr && (options.integer_grid || epsilon == 0 || rate_control || options.segment_mode)) {
+        throw std::invalid_argument("CoST: the precision map is not available on the integer grid, lossless, "
+                                    "with rate control or segment mode");
+    }
+    CheckStreamProfile(stream_profiles_, stream_profile_id_, epsilon * 0.999, options.epsilon_in_meters,
+                       options.evaluation_window, options.use_time_window, options.time_window_seconds,
+                       rate_control);
+    
+    options_ = options;
+    kBlockSize = block_size;
+    kEpsilon = epsilon * 0.999;
+    kQuantStep = 2 * epsilon * 0.999;
+    kEvaluationWindow = options.evaluation_window;
+    use_time_window_ = options.use_time_window;
+    kTimeWindowSeconds = options.time_window_seconds;
+    integer_grid_ = options.integer_grid;
+    lossless_ = (epsilon == 0);
+    kInverseQuantStep = 1.0 / (2 * epsilon * 0.999);
+    level_ = options.level;
+    
+    // Same multiplications as CoSTDecompressor::ReadHeader, so both sides get identical steps
+    rate_control_ = rate_control;
+    rate_target_bits_per_point_ = options.target_bits_per_point;
+    rate_target_bits_per_second_ = options.target_bytes_per_minute * 8 / 60;
+    rate_epsilons_.clear();
+    rate_start_step_ = 0;
+    if (rate_control_) {
+        double step_epsilon = epsilon_min * 0.999;
+        while (rate_epsilons_.size() < static_cast<size_t>(kMaxRateSteps) && step_epsilon <= epsilon_max * 0.999) {
+            if (step_epsilon <= kEpsilon) rate_start_step_ = static_cast<int>(rate_epsilons_.size());
+            rate_epsilons_.push_back(step_epsilon);
+            step_epsilon *= kRateStepRatio;
+        }
+    }
+    
+    stationary_runs_ = options.stationary_runs;
+    segment_mode_ = options.segment_mode;
+    gap_seconds_ = options.gap_seconds;
+    hex_lattice_ = options.hex_lattice;
+    metric_bound_ = options.epsilon_in_meters;
+    BuildPrecisionLevels();
+    if (!options.adaptive_residuals) {
+        residual_model_.reset();
+    } else if (residual_model_ == nullptr) {
+        residual_model_ = std::make_unique<ResidualClassModel>();
+    }
+    block_classes_ = options.block_residual_classes;
+    block_class_bits_ = -1;
+    
+    lookahead_ = options.lookahead;
+    if (lookahead_ == 0 && !integer_grid_) {
+        if (level_ == 4) lookahead_ = kFastSearchLookahead;
+        if (level_ == kMaxLevel) lookahead_ = kEvaluationWindow;
+    }
+    // A mode holds for a whole window, so a shorter horizon cannot price a switch
+    search_modes_ = lookahead_ == kLookaheadBlock || lookahead_ >= kEvaluationWindow;
+    if (lookahead_ != 0) {
+        beam_.reserve(kSearchBeamWidth);
+        next_beam_.reserve(kSearchBeamWidth);
+    }
+    
+    attribute_codecs_.clear();
+    for (const AttributeChannel& channel : options.attributes) {
+        attribute_codecs_.emplace_back(channel);
+    }
+    AllocateOutput();
+}
+
+void CoSTCompressor::AllocateOutput() {
+    // 16 bytes per point for the position (32 for XOR residuals, 8 more for a
+    // precision switch), 16 per attribute channel, plus the header so that
+    // small blocks and packets fit
+    int position_bytes = (lossless_ ? 32 : 16) + (precision_map_ != nullptr ? 8 : 0);
+    uint32_t capacity = kBlockSize * (position_bytes + 16 * attribute_codecs_.size()) + kMaxHeaderBytes;
+    if (output_bit_stream_ == nullptr || capacity > output_capacity_) {
+        output_bit_stream_ = std::make_unique<OutputBitStream>(capacity);
+        output_capacity_ = capacity;
+    } else {
+        output_bit_stream_->Refresh();
+    }
+}
+
+void CoSTCompressor::ResetStreamState() {
+    compressed_size_in_bits_ = 0;
+    packet_start_bits_ = 0;
+    first_point_ = true;
+    current_mode_ = level_ == kMinLevel ? MODE_LDR_ONLY : MODE_MULTI_PREDICTOR;
+    last_used_predictor_ = PREDICTOR_ZP;
+    if (rate_control_) SetRateStep(rate_start_step_);
+    rate_bank_ = 0;
+    if (precision_map_ != nullptr) SetPrecisionLevel(0);
+    precision_switch_pending_ = false;
+    if (residual_model_ != nullptr) residual_model_->Reset();
+    block_points_.clear();
+    block_attributes_.clear();
+    std::fill(block_payload_lengths_, block_payload_lengths_ + kMaxPayloadBits + 2, 0);
+    block_gamma_bits_ = 0;
+    run_points_.clear();
+    run_attributes_.clear();
+    segment_open_ = false;
+    segment_points_.clear();
+    segment_attributes_.clear();
+    segment_ends_.clear();
+    estimate_cone_.count = 0;
+    trip_starts_.clear();
+    current_reconstructed_point_ = GpsPoint();
+    history_states_.clear();
+    
+    route_id_ = requested_route_id_;
+    route_segment_ = -1;
+    route_offset_ = 0;
+    grid_predictor_.Reset();
+    
+    // Keep the capacity of the per-point error log
+    std::vector<double> prediction_errors = std::move(stats_.prediction_errors);
+    prediction_errors.clear();
+    stats_ = CompressionStats();
+    stats_.prediction_errors = std::move(prediction_errors);
+    
+    point_costs_multi_.clear();
+    point_costs_ldr_only_.clear();
+    window_total_cost_multi_ = 0;
+    window_total_cost_ldr_only_ = 0;
+    point_costs_segment_.clear();
+    window_total_cost_segment_ = 0;
+    last_evaluation_timestamp_ = 0;
+    
+    beam_.clear();
+    choices_.clear();
+    choices_head_ = 0;
+    pending_points_.clear();
+    pending_attributes_.clear();
+    pending_head_ = 0;
+    pending_count_ = 0;
     
  // Huffman （）
-    predictor_frequency_[PREDICTOR_LDR] = 60;  // LDR
-    predictor_frequency_[PREDICTOR_CP] = 10;   // CP
-    predictor_frequency_[PREDICTOR_ZP] = 30;   // ZP
+    predictor_window_.clear();
+    predictor_flags_ = 0;
+    num_predictors_ = 3;
+    ApplyPredictorPrior();
+}
+
+void CoSTCompressor::ApplyPredictorPrior() {
+    predictor_frequency_[PREDICTOR_LDR] = prior_.predictor_frequency[PREDICTOR_LDR];
+    predictor_frequency_[PREDICTOR_CP] = prior_.predictor_frequency[PREDICTOR_CP];
+    predictor_frequency_[PREDICTOR_ZP] = prior_.predictor_frequency[PREDICTOR_ZP];
+    predictor_frequency_[PREDICTOR_RT] = 0;  // set with the route template in ProcessFirstPoint
     UpdateHuffmanCodes();
+    compact_flags_.Reset(prior_.predictor_frequency[PREDICTOR_LDR], prior_.predictor_frequency[PREDICTOR_CP],
+                         prior_.predictor_frequency[PREDICTOR_ZP]);
+    
+    // Levels 1 and 2 keep their fixed mode
+    if (level_ >= kDefaultLevel && (prior_.initial_mode != MODE_SEGMENT || segment_mode_)) {
+        current_mode_ = prior_.initial_mode;
+    }
+}
+
+void CoSTCompressor::SetPredictorPrior(const StreamProfileTable* models, int prior_id) {
+    if (!first_point_) throw std::invalid_argument("CoST: the predictor prior must be set before the first point");
+    if (models == nullptr) {
+        prior_id_ = -1;
+        prior_ = PredictorPrior();
+    } else {
+        prior_ = models->GetPrior(prior_id);
+        prior_id_ = prior_id;
+    }
+    ApplyPredictorPrior();
+}
+
+CoSTCompressor::PredictorPrior CoSTCompressor::GetPredictorPrior() const {
+    // Counts over the flag window (level 2: the decayed flag model)
+    int counts[kMaxPredictors] = {0, 0, 0, 0};
+    if (level_ == 2) {
+        for (int i = 0; i < CompactFlagModel::kPredictors; ++i) counts[i] = compact_flags_.frequency[i];
+    } else {
+        for (PredictorType predictor : predictor_window_) counts[predictor]++;
+    }
+    return LearnPrior(counts, num_predictors_, current_mode_, prior_);
+}
+
+CoSTCompressor::PredictorPrior CoSTCompressor::LearnPrior(const int* counts, int num_predictors,
+                                                          CompressionMode mode, const PredictorPrior& base) {
+    PredictorPrior prior = base;
+    prior.initial_mode = mode;
+    long long total = 0;
+    for (int i = 0; i < num_predictors; ++i) total += counts[i];
+    if (total == 0) return prior;
+    for (int i = 0; i < num_predictors; ++i) {
+        prior.predictor_frequency[i] = static_cast<int>((counts[i] * static_cast<long long>(kMaxPriorFrequency) + total / 2) / total);
+    }
+    return prior;
+}
+
+void CoSTCompressor::SetRouteTemplateLibrary(const RouteTemplateLibrary* library, int route_id) {
+    if (integer_grid_) {
+        throw std::invalid_argument("CoST: the route template predictor is not available on the integer grid");
+    }
+    if (level_ < kDefaultLevel) {
+        throw std::invalid_argument("CoST: the route template predictor needs level >= 3");
+    }
+    route_templates_ = library;
+    route_id_ = route_id;
+    requested_route_id_ = route_id;
+}
+
+void CoSTCompressor::SetPrecisionMap(const PrecisionMap* map) {
+    if (!first_point_) throw std::invalid_argument("CoST: the precision map must be set before the first point");
+    if (map != nullptr && (integer_grid_ || lossless_ || rate_control_ || segment_mode_)) {
+        throw std::invalid_argument("CoST: the precision map is not available on the integer grid, lossless, "
+                                    "with rate control or segment mode");
+    }
+    precision_map_ = map;
+    precision_level_ = 0;
+    BuildPrecisionLevels();
+    AllocateOutput();
+}
+
+void CoSTCompressor::SetStreamProfile(const StreamProfileTable* profiles, int profile_id) {
+    CheckStreamProfile(profiles, profile_id, kEpsilon, metric_bound_, kEvaluationWindow, use_time_window_,
+                       kTimeWindowSeconds, rate_control_);
+    stream_profiles_ = profiles;
+    stream_profile_id_ = profile_id;
+}
+
+void CoSTCompressor::CheckStreamProfile(const StreamProfileTable* profiles, int profile_id, double stored_epsilon,
+                                        bool metric_bound, int evaluation_window, bool use_time_window,
+                                        uint64_t time_window_seconds, bool rate_control) {
+    if (profiles == nullptr) return;
+    if (!profiles->HasProfile(profile_id)) throw std::invalid_argument("CoST: unknown stream profile");
+    if (rate_control) throw std::invalid_argument("CoST: the compact header is not available with rate control");
+    const StreamProfile& profile = profiles->GetProfile(profile_id);
+    double profile_epsilon = profile.epsilon_in_meters ? profile.epsilon / kMetersPerDegree : profile.epsilon;
+    if (profile_epsilon * 0.999 != stored_epsilon || profile.epsilon_in_meters != metric_bound ||
+        profile.evaluation_window != evaluation_window ||
+        profile.use_time_window != use_time_window ||
+        (use_time_window && profile.time_window_seconds != time_window_seconds)) {
+        throw std::invalid_argument("CoST: stream profile does not match the compressor parameters");
+    }
 }
 
 void CoSTCompressor::AddGpsPoint(const GpsPoint& point) {
+    AddGpsPoint(point, nullptr);
+}
+
+void CoSTCompressor::AddGpsPoint(const GpsPoint& point, const double* attributes) {
+    if (attributes == nullptr && !attribute_codecs_.empty()) {
+        throw std::invalid_argument("CoST: attribute values are required for this stream");
+    }
+    if (block_classes_ && !block_replay_) {
+        // Encoded in Close(), once the payload lengths of the whole block are known
+        block_points_.push_back(point);
+        if (attributes != nullptr) {
+            block_attributes_.insert(block_attributes_.end(), attributes, attributes + attribute_codecs_.size());
+        }
+        return;
+    }
+    if (lookahead_ == 0 || first_point_) {
+        EncodePoint(point, attributes, nullptr);
+        return;
+    }
+    
+    // Queue the point and extend the search; commit once it is lookahead_ points old
+    if (pending_count_ == 0) {
+        beam_.resize(1);
+        SnapshotSearchState(beam_[0]);
+    }
+    pending_points_.push_back(point);
+    if (attributes != nullptr) {
+        pending_attributes_.insert(pending_attributes_.end(), attributes, attributes + attribute_codecs_.size());
+    }
+    pending_count_++;
+    ExpandSearch(point, stats_.total_points + static_cast<int>(run_points_.size()) + pending_count_);
+    if (lookahead_ != kLookaheadBlock && pending_count_ > lookahead_) {
+        CommitSearchSteps(1);
+    }
+}
+
+void CoSTCompressor::EncodePoint(const GpsPoint& point, const double* attributes, const SearchChoice* choice) {
+    if (precision_map_ != nullptr && !first_point_) {
+        uint64_t previous = run_points_.empty() ? current_reconstructed_point_.timestamp : run_points_.back().timestamp;
+        if (IsPrecisionEscape(point.timestamp - previous)) {
+            throw std::invalid_argument("CoST: timestamp delta collides with the precision escape");
+        }
+        // A run keeps the epsilon it started with; this point carries the switch
+        int level = precision_map_->Lookup(point.longitude, point.latitude);
+        if (level != precision_level_) {
+            if (stationary_runs_) FlushStationaryRun();
+            SetPrecisionLevel(level);
+            precision_switch_pending_ = true;
+            stats_.precision_switches++;
+        }
+    }
+    if (stationary_runs_ && !first_point_) {
+        uint64_t previous = run_points_.empty() ? current_reconstructed_point_.timestamp : run_points_.back().timestamp;
+        int64_t timestamp_delta = static_cast<int64_t>(point.timestamp - previous);
+        if (static_cast<uint64_t>(timestamp_delta) == kRunEscape) {
+            throw std::invalid_argument("CoST: timestamp delta collides with the stationary run escape");
+        }
+        // Segments hold their points at a stale reconstruction, runs start between them
+        // and a gap starts a new trip instead; a run token cannot carry a precision switch
+        if (current_mode_ != MODE_SEGMENT && segment_points_.empty() && !precision_switch_pending_ &&
+            timestamp_delta >= 0 && timestamp_delta <= kMaxRunTimestampDelta &&
+            (gap_seconds_ == 0 || timestamp_delta <= gap_seconds_) && IsStationary(point)) {
+            run_points_.push_back(point);
+            if (attributes != nullptr) {
+                run_attributes_.insert(run_attributes_.end(), attributes, attributes + attribute_codecs_.size());
+            }
+            // A rate step must not change epsilon under the rest of a run
+            int run_end = stats_.total_points + static_cast<int>(run_points_.size());
+            if (run_points_.size() >= static_cast<size_t>(kMaxRunLength) ||
+                (rate_control_ && run_end % kEvaluationWindow == 0)) {
+                FlushStationaryRun();
+            }
+            return;
+        }
+        FlushStationaryRun();
+    }
+    EncodeMovingPoint(point, attributes, choice);
+}
+
+void CoSTCompressor::EncodeMovingPoint(const GpsPoint& point, const double* attributes, const SearchChoice* choice) {
+    if (gap_seconds_ > 0 && !first_point_) {
+        // A gap ends the held segment; a jump is judged from the state after it
+        uint64_t previous = segment_points_.empty() ? current_reconstructed_point_.timestamp
+                                                    : segment_points_.back().timestamp;
+        int64_t gap_delta = static_cast<int64_t>(point.timestamp - previous);
+        bool gap = gap_delta > gap_seconds_ && gap_delta <= kMaxGapTimestampDelta;
+        if (gap) {
+            while (!segment_points_.empty()) FlushSegment();
+        }
+        if (segment_points_.empty()) {
+            uint64_t timestamp_delta = point.timestamp - current_reconstructed_point_.timestamp;
+            if (IsGapEscape(timestamp_delta)) {
+                throw std::invalid_argument("CoST: timestamp delta collides with the gap escape");
+            }
+            int64_t magnitude = static_cast<int64_t>(timestamp_delta);
+            if (gap || (std::max(magnitude, -magnitude) <= kMaxGapTimestampDelta && IsJump(point))) {
+                EncodeGapPoint(point, attributes, choice);
+                return;
+            }
+        }
+    }
+    if (!first_point_ && (current_mode_ == MODE_SEGMENT || !segment_points_.empty())) {
+        AddSegmentPoint(point, attributes);
+        return;
+    }
+    EncodeSinglePoint(point, attributes, choice);
+}
+
+void CoSTCompressor::EncodeSinglePoint(const GpsPoint& point, const double* attributes, const SearchChoice* choice) {
     stats_.total_points++;
     
     if (first_point_) {
         ProcessFirstPoint(point);
+        EncodeAttributes(attributes, point.timestamp);
+        rate_window_start_point_ = stats_.total_points;
+        rate_window_start_bits_ = compressed_size_in_bits_;
+        rate_window_start_timestamp_ = point.timestamp;
         return;
     }
     
- // === 1. （） ===
-    GpsPoint pred_ldr, pred_cp, pred_zp;
-    ParallelPredict(pred_ldr, pred_cp, pred_zp, point.timestamp);
-    
-    // (comment removed)
-    GpsPoint error_ldr = point - pred_ldr;
-    GpsPoint error_cp = point - pred_cp;
-    GpsPoint error_zp = point - pred_zp;
-    
-    int cost_ldr_error = EstimateErrorEncodingCost(error_ldr);
-    int cost_cp_error = EstimateErrorEncodingCost(error_cp);
-    int cost_zp_error = EstimateErrorEncodingCost(error_zp);
-    
- // （：Huffman + ）
-    int cost_ldr_total = GetHuffmanBitCost(PREDICTOR_LDR) + cost_ldr_error;
-    int cost_cp_total = GetHuffmanBitCost(PREDICTOR_CP) + cost_cp_error;
-    int cost_zp_total = GetHuffmanBitCost(PREDICTOR_ZP) + cost_zp_error;
-    
-    PredictorType best_predictor;
-    GpsPoint best_prediction;
-    int best_cost;
+    if (integer_grid_) {
+        EncodeGridPoint(point);
+        EncodeAttributes(attributes, point.timestamp);
+        WriteModeBitIfDue(point.timestamp, nullptr);
+        return;
+    }
     
-    if (cost_ldr_total <= cost_cp_total && cost_ldr_total <= cost_zp_total) {
-        best_predictor = PREDICTOR_LDR;
-        best_prediction = pred_ldr;
-        best_cost = cost_ldr_total;
-    } else if (cost_cp_total <= cost_zp_total) {
-        best_predictor = PREDICTOR_CP;
-        best_prediction = pred_cp;
-        best_cost = cost_cp_total;
-    } else {
-        best_predictor = PREDICTOR_ZP;
-        best_prediction = pred_zp;
-        best_cost = cost_zp_total;
+    // Level 1: every point in LDR-only form, no mode bits
+    if (level_ == kMinLevel) {
+        EncodeLDROnly(point);
+        stats_.ldr_only_mode_points++;
+        EncodeAttributes(attributes, point.timestamp);
+        WriteModeBitIfDue(point.timestamp, nullptr);
+        return;
     }
     
+    // The cost windows only feed the heuristic mode decision (level 2 never switches)
+    if (level_ > 2 && (choice == nullptr || !search_modes_)) {
+ // === 1. （） ===
+        GpsPoint pred_ldr, pred_cp, pred_zp;
+        ParallelPredict(pred_ldr, pred_cp, pred_zp, point.timestamp);
+        GpsPoint pred_rt = PredictRouteTemplate(pred_ldr, point.timestamp);
+        
+        int cost_ldr_error = EstimateResidualCost(point, pred_ldr);
+        
+ // （：Huffman + ）
+        GpsPoint best_prediction;
+        int best_cost;
+        SelectBestPredictorByCost(point, pred_ldr, pred_cp, pred_zp, pred_rt, best_prediction, best_cost);
+        if (segment_mode_) EstimateSegmentCost(point);
+        
  // === 2. （） ===
-    int multi_model_cost = best_cost;                    // ：
-    int ldr_only_model_cost = cost_ldr_error;            // LDR-Only：LDR（）
-    
+        int multi_model_cost = best_cost;                    // ：
+        int ldr_only_model_cost = cost_ldr_error;            // LDR-Only：LDR（）
+        
  // （）
-    UpdateCostWindows(multi_model_cost, ldr_only_model_cost, point.timestamp);
+        UpdateCostWindows(multi_model_cost, ldr_only_model_cost, point.timestamp);
+    }
     
  // === 3. ===
     if (current_mode_ == MODE_LDR_ONLY) {
         EncodeLDROnly(point);
         stats_.ldr_only_mode_points++;
     } else {  // MODE_MULTI_PREDICTOR
-        EncodeMultiPredictor(point);
+        EncodeMultiPredictor(point, choice);
         stats_.multi_predictor_mode_points++;
     }
     
  // === 4. ===
-    bool should_evaluate = false;
+    EncodeAttributes(attributes, point.timestamp);
+    WriteModeBitIfDue(point.timestamp, choice);
+}
+
+bool CoSTCompressor::IsStationary(const GpsPoint& point) const {
+    if (integer_grid_) {
+        GridPoint grid_point = ToGrid(point);
+        return grid_point.x == grid_predictor_.Last().x && grid_point.y == grid_predictor_.Last().y;
+    }
+    if (lossless_) {
+        return Double::DoubleToLongBits(point.longitude) == Double::DoubleToLongBits(current_reconstructed_point_.longitude) &&
+               Double::DoubleToLongBits(point.latitude) == Double::DoubleToLongBits(current_reconstructed_point_.latitude);
+    }
+    // Same quantization as EncodeResidual: a zero ZP residual
+    GpsPoint delta = point - current_reconstructed_point_;
+    if (hex_lattice_) {
+        LatticeIndex index = QuantizeHex(delta, kQuantStep);
+        return index.column == 0 && index.row == 0;
+    }
+    return std::round(delta.latitude / kQuantStep) == 0 &&
+           std::round(delta.longitude / LonQuantStep(current_reconstructed_point_.latitude, 0)) == 0;
+}
+
+void CoSTCompressor::FlushStationaryRun() {
+    if (run_points_.empty()) return;
+    int channels = static_cast<int>(attribute_codecs_.size());
+    
+    // A single point is cheaper in the regular form
+    if (run_points_.size() == 1) {
+        EncodeMovingPoint(run_points_[0], channels > 0 ? run_attributes_.data() : nullptr, nullptr);
+        run_points_.clear();
+        run_attributes_.clear();
+        return;
+    }
     
-    if (use_time_window_) {
-        // (comment removed)
-        if (last_evaluation_timestamp_ == 0) {
- // ：
-            last_evaluation_timestamp_ = point.timestamp;
+    if (current_mode_ == MODE_MULTI_PREDICTOR) {
+        int bits_before_flag = compressed_size_in_bits_;
+        EncodeWithHuffman(PREDICTOR_ZP);
+        stats_.predictor_flag_bits += (compressed_size_in_bits_ - bits_before_flag);
+        last_used_predictor_ = PREDICTOR_ZP;
+    }
+    int bits_before_timestamps = compressed_size_in_bits_;
+    compressed_size_in_bits_ += output_bit_stream_->WriteLong(kRunEscape, 64);
+    compressed_size_in_bits_ += EliasGammaCodec::Encode(run_points_.size() - 1, output_bit_stream_.get());
+    
+    // Regular sampling makes the second differences zero (one bit per point)
+    uint64_t previous = current_reconstructed_point_.timestamp;
+    int64_t previous_delta = 0;
+    for (const GpsPoint& point : run_points_) {
+        int64_t delta = static_cast<int64_t>(point.timestamp - previous);
+        compressed_size_in_bits_ += EliasGammaCodec::Encode(
+            ZigZagCodec::Encode(delta - previous_delta) + 1, output_bit_stream_.get());
+        previous = point.timestamp;
+        previous_delta = delta;
+    }
+    stats_.timestamp_bits += (compressed_size_in_bits_ - bits_before_timestamps);
+    
+    // Then the points in order, each with its attributes and mode bit
+    for (size_t i = 0; i < run_points_.size(); ++i) {
+        const GpsPoint& point = run_points_[i];
+        stats_.total_points++;
+        stats_.stationary_points++;
+        if (integer_grid_) {
+            GridPoint last = grid_predictor_.Last();
+            grid_predictor_.Push(GridPoint(last.x, last.y, point.timestamp));
+            current_reconstructed_point_ = FromGrid(grid_predictor_.Last());
+        } else {
+            UpdateReconstructedState(GpsPoint(current_reconstructed_point_.longitude,
+                                              current_reconstructed_point_.latitude, point.timestamp));
         }
+        double error = CalculateDistance(point, current_reconstructed_point_);
+        stats_.total_prediction_error += error;
+        stats_.max_prediction_error = std::max(stats_.max_prediction_error, error);
+        stats_.prediction_errors.push_back(error);
         
-        uint64_t time_since_last_eval = point.timestamp - last_evaluation_timestamp_;
+        EncodeAttributes(channels > 0 ? &run_attributes_[i * channels] : nullptr, point.timestamp);
+        WriteModeBitIfDue(point.timestamp, nullptr);
+    }
+    run_points_.clear();
+    run_attributes_.clear();
+}
+
+CoSTCompressor::GpsPoint CoSTCompressor::InterpolateSegment(const GpsPoint& start, const GpsPoint& end,
+                                                            uint64_t timestamp) {
+    double fraction = static_cast<double>(timestamp - start.timestamp) /
+                      static_cast<double>(end.timestamp - start.timestamp);
+    return GpsPoint(start.longitude + (end.longitude - start.longitude) * fraction,
+                    start.latitude + (end.latitude - start.latitude) * fraction, timestamp);
+}
+
+CoSTCompressor::LatticeIndex CoSTCompressor::QuantizeHex(const GpsPoint& delta, double quant_step) {
+    // The nearest lattice point lies in one of the two rows around the point
+    double step = quant_step * kHexStepRatio;
+    double row_step = step * kHexStepRatio;
+    double row_below = std::floor(delta.latitude / row_step);
+    LatticeIndex best = {0, 0};
+    double best_distance = 0;
+    for (int i = 0; i < 2; ++i) {
+        LatticeIndex index;
+        index.row = static_cast<int64_t>(row_below) + i;
+        index.column = static_cast<int64_t>(std::round(delta.longitude / step - 0.5 * (index.row & 1)));
+        GpsPoint lattice_point = HexLatticePoint(index, quant_step);
+        double dx = delta.longitude - lattice_point.longitude;
+        double dy = delta.latitude - lattice_point.latitude;
+        double distance = dx * dx + dy * dy;
+        if (i == 0 || distance < best_distance) {
+            best = index;
+            best_distance = distance;
+        }
+    }
+    return best;
+}
+
+CoSTCompressor::GpsPoint CoSTCompressor::HexLatticePoint(const LatticeIndex& index, double quant_step) {
+    double step = quant_step * kHexStepRatio;
+    return GpsPoint((index.column + 0.5 * (index.row & 1)) * step, index.row * (step * kHexStepRatio), 0);
+}
+
+namespace {
+
+// Entry b holds 1 / cos(b / kMetricBandsPerDegree degrees), rounded down, so it
+// never exceeds the scale at a latitude inside band b
+constexpr int kMetricBands = 90 * CoSTCompressor::kMetricBandsPerDegree;
+const std::vector<double> kMetricLonScales = [] {
+    std::vector<double> table(kMetricBands);
+    double radians_per_band = std::acos(-1.0) / 180 / CoSTCompressor::kMetricBandsPerDegree;
+    for (int band = 0; band < kMetricBands; ++band) {
+        double scale = std::ldexp(1 / std::cos(band * radians_per_band), CoSTCompressor::kMetricScaleFractionBits);
+        table[band] = std::ldexp(std::floor(scale), -CoSTCompressor::kMetricScaleFractionBits);
+    }
+    return table;
+}();
+
+}  // namespace
+
+double CoSTCompressor::MetricLonScale(double latitude, double quant_step) {
+    // A reconstructed latitude is within half a step of the input point
+    double band_latitude = std::fabs(latitude) - 0.5 * quant_step;
+    int band = band_latitude > 0 ? static_cast<int>(std::min(band_latitude, 90.0) * kMetricBandsPerDegree) : 0;
+    return kMetricLonScales[std::min(band, kMetricBands - 1)];
+}
+
+void CoSTCompressor::SegmentCone::Reset(const GpsPoint& start) {
+    anchor = start;
+    last_timestamp = start.timestamp;
+    count = 0;
+}
+
+bool CoSTCompressor::SegmentCone::Add(const GpsPoint& point, double lon_epsilon, double lat_epsilon) {
+    // Interpolation needs strictly increasing timestamps
+    if (point.timestamp <= last_timestamp) return false;
+    double dt = static_cast<double>(point.timestamp - anchor.timestamp);
+    double offset[2] = {point.longitude - anchor.longitude, point.latitude - anchor.latitude};
+    double epsilon[2] = {lon_epsilon, lat_epsilon};
+    double low[2], high[2];
+    for (int axis = 0; axis < 2; ++axis) {
+        low[axis] = (offset[axis] - epsilon[axis]) / dt;
+        high[axis] = (offset[axis] + epsilon[axis]) / dt;
+        if (count > 0) {
+            low[axis] = std::max(low[axis], slope_min[axis]);
+            high[axis] = std::min(high[axis], slope_max[axis]);
+        }
+        if (low[axis] > high[axis]) return false;
+    }
+    for (int axis = 0; axis < 2; ++axis) {
+        slope_min[axis] = low[axis];
+        slope_max[axis] = high[axis];
+    }
+    last_timestamp = point.timestamp;
+    count++;
+    return true;
+}
+
+void CoSTCompressor::AddSegmentPoint(const GpsPoint& point, const double* attributes) {
+    uint64_t previous = segment_points_.empty() ? current_reconstructed_point_.timestamp : segment_points_.back().timestamp;
+    int64_t timestamp_delta = static_cast<int64_t>(point.timestamp - previous);
+    if (std::max(timestamp_delta, -timestamp_delta) > kMaxSegmentTimestampDelta) {
+        throw std::invalid_argument("CoST: timestamp delta too large for segment mode");
+    }
+    if (!segment_points_.empty() && !(segment_open_ && segment_cone_.Add(point, LonEpsilon(point.latitude), kEpsilon))) {
+        // The cone closed: code what it covers, the rest comes back through here
+        segment_open_ = false;
+        FlushSegment();
+        EncodeMovingPoint(point, attributes, nullptr);
+        return;
+    }
+    if (segment_points_.empty()) {
+        segment_cone_.Reset(current_reconstructed_point_);
+        segment_open_ = segment_cone_.Add(point, LonEpsilon(point.latitude), kEpsilon);
+    }
+    segment_points_.push_back(point);
+    if (attributes != nullptr) {
+        segment_attributes_.insert(segment_attributes_.end(), attributes, attributes + attribute_codecs_.size());
+    }
+    
+    // The state stays at the anchor while points are held, so the LDR prediction
+    // of each possible end is the one the token will be coded against
+    GpsPoint pred_ldr, pred_cp, pred_zp;
+    ParallelPredict(pred_ldr, pred_cp, pred_zp, point.timestamp);
+    double prediction[2] = {pred_ldr.longitude, pred_ldr.latitude};
+    double target[2] = {point.longitude, point.latitude};
+    double anchor[2] = {segment_cone_.anchor.longitude, segment_cone_.anchor.latitude};
+    double dt = static_cast<double>(point.timestamp - segment_cone_.anchor.timestamp);
+    SegmentEnd end;
+    end.valid = true;
+    // Latitude first: with the metric bound it sets the longitude step
+    for (int axis = 1; axis >= 0; --axis) {
+        double step = axis == 0 ? LonQuantStep(prediction[1], end.k[1]) : kQuantStep;
+        if (segment_points_.size() == 1) {
+            // Same rounding as EncodeResidual, always within epsilon
+            end.k[axis] = static_cast<int64_t>(std::round((target[axis] - prediction[axis]) / step));
+            continue;
+        }
+        // Cheapest residual whose end point keeps the slope inside the cone
+        double k_min = std::ceil((anchor[axis] + segment_cone_.slope_min[axis] * dt - prediction[axis]) / step);
+        double k_max = std::floor((anchor[axis] + segment_cone_.slope_max[axis] * dt - prediction[axis]) / step);
+        end.valid &= k_min <= k_max;
+        end.k[axis] = static_cast<int64_t>(std::max(k_min, std::min(0.0, k_max)));
+    }
+    segment_ends_.push_back(end);
+    
+    // A rate step must not change epsilon under the rest of a segment
+    int segment_end = stats_.total_points + static_cast<int>(segment_points_.size());
+    if (!segment_open_ || segment_points_.size() >= static_cast<size_t>(kMaxSegmentLength) ||
+        (rate_control_ && segment_end % kEvaluationWindow == 0)) {
+        segment_open_ = false;
+        FlushSegment();
+    }
+}
+
+CoSTCompressor::GpsPoint CoSTCompressor::SegmentEndPoint(int index) {
+    const GpsPoint& point = segment_points_[index];
+    GpsPoint pred_ldr, pred_cp, pred_zp;
+    ParallelPredict(pred_ldr, pred_cp, pred_zp, point.timestamp);
+    const int64_t* k = segment_ends_[index].k;
+    GpsPoint end = pred_ldr + GpsPoint(k[0] * LonQuantStep(pred_ldr.latitude, k[1]), k[1] * kQuantStep, 0);
+    end.timestamp = point.timestamp;
+    return end;
+}
+
+bool CoSTCompressor::CheckSegment(int count, const GpsPoint& end) const {
+    // The cone bounds the exact line; check the points as the decoder rounds them
+    for (int i = 0; i < count; ++i) {
+        const GpsPoint& point = segment_points_[i];
+        GpsPoint reconstructed = i == count - 1 ? end : InterpolateSegment(current_reconstructed_point_, end, point.timestamp);
+        if (std::fabs(reconstructed.longitude - point.longitude) > LonEpsilon(point.latitude) ||
+            std::fabs(reconstructed.latitude - point.latitude) > kEpsilon) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CoSTCompressor::FlushSegment() {
+    if (segment_points_.empty()) return;
+    
+    // Longest segment with a valid end; a single point always fits
+    int count = static_cast<int>(segment_points_.size());
+    GpsPoint end;
+    for (; count > 1; --count) {
+        if (!segment_ends_[count - 1].valid) continue;
+        end = SegmentEndPoint(count - 1);
+        if (CheckSegment(count, end)) break;
+    }
+    if (count == 1) end = SegmentEndPoint(0);
+    EmitSegment(count, end);
+    
+    // The points after the end start over
+    int channels = static_cast<int>(attribute_codecs_.size());
+    std::vector<GpsPoint> rest(segment_points_.begin() + count, segment_points_.end());
+    std::vector<double> rest_attributes(segment_attributes_.begin() + count * channels, segment_attributes_.end());
+    segment_points_.clear();
+    segment_attributes_.clear();
+    segment_ends_.clear();
+    segment_open_ = false;
+    for (size_t i = 0; i < rest.size(); ++i) {
+        EncodeMovingPoint(rest[i], channels > 0 ? &rest_attributes[i * channels] : nullptr, nullptr);
+    }
+}
+
+void CoSTCompressor::EmitSegment(int count, const GpsPoint& end) {
+    int channels = static_cast<int>(attribute_codecs_.size());
+    int bits_before_token = compressed_size_in_bits_;
+    compressed_size_in_bits_ += EliasGammaCodec::Encode(count, output_bit_stream_.get());
+    
+    // Second differences as in a run token: one bit per point under regular sampling
+    int bits_before_timestamps = compressed_size_in_bits_;
+    uint64_t previous = current_reconstructed_point_.timestamp;
+    int64_t previous_delta = 0;
+    for (int i = 0; i < count; ++i) {
+        int64_t delta = static_cast<int64_t>(segment_points_[i].timestamp - previous);
+        compressed_size_in_bits_ += EliasGammaCodec::Encode(
+            ZigZagCodec::Encode(delta - previous_delta) + 1, output_bit_stream_.get());
+        previous = segment_points_[i].timestamp;
+        previous_delta = delta;
+    }
+    stats_.timestamp_bits += compressed_size_in_bits_ - bits_before_timestamps;
+    
+    int bits_before_data = compressed_size_in_bits_;
+    const SegmentEnd& residual = segment_ends_[count - 1];
+    compressed_size_in_bits_ += WriteResidualCodes(ZigZagCodec::Encode(residual.k[0]) + 1,
+                                                   ZigZagCodec::Encode(residual.k[1]) + 1);
+    stats_.quantized_data_bits += (compressed_size_in_bits_ - bits_before_data);
+    
+    // The cost windows leave out the 64-bit timestamp word of the other modes,
+    // so each point is charged its share of the token less one word
+    int token_cost = compressed_size_in_bits_ - bits_before_token;
+    GpsPoint start = current_reconstructed_point_;
+    for (int i = 0; i < count; ++i) {
+        const GpsPoint& point = segment_points_[i];
+        GpsPoint pred_ldr, pred_cp, pred_zp;
+        ParallelPredict(pred_ldr, pred_cp, pred_zp, point.timestamp);
+        GpsPoint pred_rt = PredictRouteTemplate(pred_ldr, point.timestamp);
+        GpsPoint best_prediction;
+        int best_cost;
+        SelectBestPredictorByCost(point, pred_ldr, pred_cp, pred_zp, pred_rt, best_prediction, best_cost);
+        UpdateCostWindows(best_cost, EstimateResidualCost(point, pred_ldr), point.timestamp);
+        PushSegmentCost(token_cost / count + (i < token_cost % count ? 1 : 0) - kTimestampWordBits, point.timestamp);
+        
+        stats_.total_points++;
+        stats_.segment_points++;
+        UpdateReconstructedState(i == count - 1 ? end : InterpolateSegment(start, end, point.timestamp));
+        double error = CalculateDistance(point, current_reconstructed_point_);
+        stats_.total_prediction_error += error;
+        stats_.max_prediction_error = std::max(stats_.max_prediction_error, error);
+        stats_.prediction_errors.push_back(error);
         
- // （），
-        if (point.timestamp >= last_evaluation_timestamp_ && 
-            time_since_last_eval >= kTimeWindowSeconds) {
-            should_evaluate = true;
-            last_evaluation_timestamp_ = point.timestamp;
+        EncodeAttributes(channels > 0 ? &segment_attributes_[i * channels] : nullptr, point.timestamp);
+        WriteModeBitIfDue(point.timestamp, nullptr);
+    }
+    stats_.segment_count++;
+}
+
+void CoSTCompressor::EstimateSegmentCost(const GpsPoint& point) {
+    // Shadow segment over the points the other modes code: once it closes, its
+    // token cost less the timestamp words goes to the segment window
+    if (estimate_cone_.count > 0) {
+        int64_t delta = static_cast<int64_t>(point.timestamp - estimate_cone_.last_timestamp);
+        if (estimate_cone_.count < kMaxSegmentLength && estimate_cone_.Add(point, LonEpsilon(point.latitude), kEpsilon)) {
+            estimate_timestamp_bits_ += EstimateEliasGammaBits(ZigZagCodec::Encode(delta - estimate_timestamp_delta_) + 1);
+            estimate_timestamp_delta_ = delta;
+        } else {
+            int count = estimate_cone_.count;
+            int cost = EstimateEliasGammaBits(count) + estimate_timestamp_bits_ + estimate_end_cost_;
+            for (int i = 0; i < count; ++i) {
+                PushSegmentCost(cost / count + (i < cost % count ? 1 : 0) - kTimestampWordBits,
+                                estimate_cone_.last_timestamp);
+            }
+            estimate_cone_.count = 0;
         }
-    } else {
- // （）
-        if (stats_.total_points % kEvaluationWindow == 0) {
-            should_evaluate = true;
+    }
+    if (estimate_cone_.count == 0) {
+        estimate_cone_.Reset(current_reconstructed_point_);
+        estimate_velocity_ = history_states_.size() >= 2 ? history_states_.back().velocity : GpsPoint(0, 0, 0);
+        int64_t delta = static_cast<int64_t>(point.timestamp - current_reconstructed_point_.timestamp);
+        estimate_timestamp_bits_ = EstimateEliasGammaBits(ZigZagCodec::Encode(delta) + 1);
+        estimate_timestamp_delta_ = delta;
+        if (!estimate_cone_.Add(point, LonEpsilon(point.latitude), kEpsilon)) {
+            PushSegmentCost(1 + estimate_timestamp_bits_ + EstimateResidualCost(point, current_reconstructed_point_) -
+                            kTimestampWordBits, point.timestamp);
+            return;
         }
     }
+    // The end point is coded against the LDR prediction from the anchor
+    const GpsPoint& anchor = estimate_cone_.anchor;
+    double dt = static_cast<double>(point.timestamp - anchor.timestamp);
+    GpsPoint prediction(anchor.longitude + estimate_velocity_.longitude * dt,
+                        anchor.latitude + estimate_velocity_.latitude * dt, point.timestamp);
+    estimate_end_cost_ = EstimateErrorEncodingCost(point - prediction, prediction.latitude);
+}
+
+bool CoSTCompressor::IsJump(const GpsPoint& point) {
+    // The LDR prediction misses by more than the escape costs over a ZP residual
+    if (integer_grid_) {
+        GridPoint grid_point = ToGrid(point);
+        GridPoint pred_ldr, pred_cp, pred_zp;
+        grid_predictor_.Predict(point.timestamp, pred_ldr, pred_cp, pred_zp);
+        return EstimateGridResidualCost(grid_point, pred_ldr) >
+               kJumpBits + EstimateGridResidualCost(grid_point, pred_zp);
+    }
+    GpsPoint pred_ldr, pred_cp, pred_zp;
+    ParallelPredict(pred_ldr, pred_cp, pred_zp, point.timestamp);
+    return EstimateResidualCost(point, pred_ldr) > kJumpBits + EstimateResidualCost(point, pred_zp);
+}
+
+void CoSTCompressor::EncodeGapPoint(const GpsPoint& point, const double* attributes, const SearchChoice* choice) {
+    stats_.total_points++;
+    stats_.gap_escapes++;
+    trip_starts_.push_back(stats_.total_points - 1);
     
-    if (should_evaluate) {
+    if (current_mode_ == MODE_MULTI_PREDICTOR) {
+        int bits_before_flag = compressed_size_in_bits_;
+        EncodeWithHuffman(PREDICTOR_ZP);
+        stats_.predictor_flag_bits += (compressed_size_in_bits_ - bits_before_flag);
+        last_used_predictor_ = PREDICTOR_ZP;
+    }
+    int bits_before_timestamp = compressed_size_in_bits_;
+    uint64_t timestamp_code = ZigZagCodec::Encode(static_cast<int64_t>(point.timestamp - current_reconstructed_point_.timestamp)) + 1;
+    if (current_mode_ == MODE_SEGMENT) {
+        compressed_size_in_bits_ += EliasGammaCodec::Encode(kGapSegmentCount, output_bit_stream_.get());
+        compressed_size_in_bits_ += EliasGammaCodec::Encode(timestamp_code, output_bit_stream_.get());
+    } else {
+        compressed_size_in_bits_ += WriteTimestampWord(kRunEscape | timestamp_code);
+    }
+    stats_.timestamp_bits += (compressed_size_in_bits_ - bits_before_timestamp);
+    
+    // Position against the previous one, then the history restarts there
+    if (integer_grid_) {
+        GridPoint grid_point = ToGrid(point);
+        const GridPoint& last = grid_predictor_.Last();
+        int bits_before_data = compressed_size_in_bits_;
+        compressed_size_in_bits_ += EliasGammaCodec::Encode(
+            ZigZagCodec::Encode(grid_point.x - last.x) + 1, output_bit_stream_.get());
+        compressed_size_in_bits_ += EliasGammaCodec::Encode(
+            ZigZagCodec::Encode(grid_point.y - last.y) + 1, output_bit_stream_.get());
+        stats_.quantized_data_bits += (compressed_size_in_bits_ - bits_before_data);
+        grid_predictor_.Reset();
+        grid_predictor_.Push(grid_point);
+        current_reconstructed_point_ = FromGrid(grid_point);
+    } else {
+        GpsPoint reconstructed_point = EncodeResidual(point, current_reconstructed_point_);
+        reconstructed_point.timestamp = point.timestamp;
+        history_states_.clear();
+        UpdateReconstructedState(reconstructed_point);
+    }
+    estimate_cone_.count = 0;
+    double error = CalculateDistance(point, current_reconstructed_point_);
+    stats_.total_prediction_error += error;
+    stats_.max_prediction_error = std::max(stats_.max_prediction_error, error);
+    stats_.prediction_errors.push_back(error);
+    
+    EncodeAttributes(attributes, point.timestamp);
+    WriteModeBitIfDue(point.timestamp, choice);
+}
+
+void CoSTCompressor::EncodeAttributes(const double* attributes, uint64_t timestamp) {
+    for (size_t i = 0; i < attribute_codecs_.size(); ++i) {
+        int bits = attribute_codecs_[i].Encode(attributes[i], timestamp, output_bit_stream_.get());
+        compressed_size_in_bits_ += bits;
+        stats_.attribute_bits += bits;
+    }
+}
+
+void CoSTCompressor::WriteModeBitIfDue(uint64_t timestamp, const SearchChoice* choice) {
+    // Rate steps follow the point count even with the time window, whose
+    // evaluation points stop when timestamps go backwards
+    if (rate_control_ && stats_.total_points % kEvaluationWindow == 0) WriteRateStep(timestamp);
+    
+    // Level 1 streams have no mode bits
+    if (level_ == kMinLevel) return;
+    if (!IsEvaluationPoint(stats_.total_points, timestamp, last_evaluation_timestamp_)) return;
+    
+    if (choice != nullptr && search_modes_) {
+        // Mode chosen by the lookahead search
+        if (choice->mode != current_mode_) {
+            current_mode_ = choice->mode;
+            stats_.mode_switch_count++;
+        }
+    } else {
  // cost window，；
         size_t min_window_size = use_time_window_ ? 5 : kEvaluationWindow;  // 5
         if (point_costs_multi_.size() >= min_window_size) {
             EvaluateAndSwitchModeBasedOnCost();
         }
-        
+    }
+    
  // ，1（）
-        // 0 = Multi-Predictor, 1 = LDR-Only
-        bool mode_bit = (current_mode_ == MODE_LDR_ONLY);
-        output_bit_stream_->WriteBit(mode_bit);
+    // 0 = Multi-Predictor, 1 = LDR-Only (segment mode: 10 = LDR-Only, 11 = Segment)
+    bool mode_bit = (current_mode_ != MODE_MULTI_PREDICTOR);
+    output_bit_stream_->WriteBit(mode_bit);
+    compressed_size_in_bits_ += 1;
+    if (segment_mode_ && mode_bit) {
+        output_bit_stream_->WriteBit(current_mode_ == MODE_SEGMENT);
         compressed_size_in_bits_ += 1;
     }
 }
 
-void CoSTCompressor::EncodeMultiPredictor(const GpsPoint& point) {
+void CoSTCompressor::WriteRateStep(uint64_t timestamp) {
+    // Budget of the points since the previous rate step (the header and the first
+    // point are not budgeted)
+    int points = stats_.total_points - rate_window_start_point_;
+    double seconds = timestamp > rate_window_start_timestamp_
+                         ? static_cast<double>(timestamp - rate_window_start_timestamp_) : 0;
+    double budget = rate_target_bits_per_point_ > 0 ? rate_target_bits_per_point_ * points
+                                                    : rate_target_bits_per_second_ * seconds;
+    double spent = compressed_size_in_bits_ - rate_window_start_bits_;
+    
+    // The bank only remembers about one window, so a quiet period cannot pay
+    // for a long burst at fine epsilon
+    rate_bank_ = std::max(-budget, std::min(budget, rate_bank_ + budget - spent));
+    
+    // Coarser once the budget is overspent, finer once the savings cover the
+    // extra bit per point of a finer step; the window itself must agree, so a
+    // run of short windows cannot walk the whole ladder on an old balance
+    int step = rate_step_;
+    if (rate_bank_ < 0 && spent > budget && step + 1 < static_cast<int>(rate_epsilons_.size())) {
+        step++;
+    } else if (rate_bank_ > points && spent + points <= budget && step > 0) {
+        step--;
+    }
+    
+    if (step == rate_step_) {
+        compressed_size_in_bits_ += output_bit_stream_->WriteBit(false);
+    } else {
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(step > rate_step_ ? 3 : 2, 2);
+        SetRateStep(step);
+        stats_.epsilon_change_count++;
+    }
+    
+    rate_window_start_point_ = stats_.total_points;
+    rate_window_start_bits_ = compressed_size_in_bits_;
+    // Stream time only moves forward, interleaved vehicles must not count a span twice
+    rate_window_start_timestamp_ = std::max(rate_window_start_timestamp_, timestamp);
+}
+
+void CoSTCompressor::SetRateStep(int step) {
+    rate_step_ = step;
+    kEpsilon = rate_epsilons_[step];
+    kQuantStep = 2 * kEpsilon;
+}
+
+void CoSTCompressor::BuildPrecisionLevels() {
+    // Map epsilons in the unit of the constructor epsilon, scaled as in Configure
+    precision_epsilons_.assign(1, kEpsilon);
+    if (precision_map_ == nullptr) return;
+    for (double epsilon : precision_map_->GetEpsilons()) {
+        precision_epsilons_.push_back((metric_bound_ ? epsilon / kMetersPerDegree : epsilon) * 0.999);
+    }
+}
+
+void CoSTCompressor::SetPrecisionLevel(int level) {
+    precision_level_ = level;
+    kEpsilon = precision_epsilons_[level];
+    kQuantStep = 2 * kEpsilon;
+}
+
+int CoSTCompressor::WriteTimestampWord(uint64_t word) {
+    if (!precision_switch_pending_) return output_bit_stream_->WriteLong(word, 64);
+    precision_switch_pending_ = false;
+    uint64_t switch_word = kPrecisionEscape | (static_cast<uint64_t>(precision_level_) << kPrecisionLevelShift);
+    uint64_t timestamp_code = ZigZagCodec::Encode(static_cast<int64_t>(word));
+    if (timestamp_code < (1ull << kPrecisionLevelShift) - 1) {
+        return output_bit_stream_->WriteLong(switch_word | (timestamp_code + 1), 64);
+    }
+    // A gap escape or a delta that does not fit follows in full
+    int bits = output_bit_stream_->WriteLong(switch_word, 64);
+    return bits + output_bit_stream_->WriteLong(word, 64);
+}
+
+bool CoSTCompressor::IsEvaluationPoint(int point_number, uint64_t timestamp,
+                                       uint64_t& last_evaluation_timestamp) const {
+    return CoSTArithmetic::IsEvaluationPoint(point_number, timestamp, kEvaluationWindow, use_time_window_,
+                                             kTimeWindowSeconds, last_evaluation_timestamp);
+}
+
+// ========== Integer grid ==========
+
+GridPoint CoSTCompressor::ToGrid(const GpsPoint& point) const {
+    return GridPoint(std::llround(point.longitude * kInverseQuantStep),
+                     std::llround(point.latitude * kInverseQuantStep), point.timestamp);
+}
+
+CoSTCompressor::GpsPoint CoSTCompressor::FromGrid(const GridPoint& point) const {
+    return GpsPoint(point.x * kQuantStep, point.y * kQuantStep, point.timestamp);
+}
+
+int CoSTCompressor::EstimateGridResidualCost(const GridPoint& point, const GridPoint& prediction) const {
+    return EstimateEliasGammaBits(ZigZagCodec::Encode(point.x - prediction.x) + 1) +
+           EstimateEliasGammaBits(ZigZagCodec::Encode(point.y - prediction.y) + 1);
+}
+
+void CoSTCompressor::EncodeGridPoint(const GpsPoint& point) {
+    GridPoint grid_point = ToGrid(point);
+    GridPoint pred[3];
+    grid_predictor_.Predict(point.timestamp, pred[PREDICTOR_LDR], pred[PREDICTOR_CP], pred[PREDICTOR_ZP]);
+    
+    // Same selection rule as SelectBestPredictorByCost, ties resolved LDR > CP > ZP
+    PredictorType best_predictor = PREDICTOR_LDR;
+    if (level_ != kMinLevel) {
+        int cost_ldr_error = EstimateGridResidualCost(grid_point, pred[PREDICTOR_LDR]);
+        int best_cost = GetHuffmanBitCost(PREDICTOR_LDR) + cost_ldr_error;
+        for (PredictorType predictor : {PREDICTOR_CP, PREDICTOR_ZP}) {
+            int cost = GetHuffmanBitCost(predictor) + EstimateGridResidualCost(grid_point, pred[predictor]);
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_predictor = predictor;
+            }
+        }
+        if (level_ > 2) UpdateCostWindows(best_cost, cost_ldr_error, point.timestamp);
+    }
+    
+    if (current_mode_ == MODE_LDR_ONLY) {
+        best_predictor = PREDICTOR_LDR;
+        stats_.ldr_only_mode_points++;
+    } else {
+        int bits_before_flag = compressed_size_in_bits_;
+        EncodeWithHuffman(best_predictor);
+        stats_.predictor_flag_bits += (compressed_size_in_bits_ - bits_before_flag);
+        last_used_predictor_ = best_predictor;
+        stats_.multi_predictor_mode_points++;
+    }
+    
+    int64_t timestamp_delta_signed = static_cast<int64_t>(point.timestamp) - static_cast<int64_t>(current_reconstructed_point_.timestamp);
+    int ts_bits = output_bit_stream_->WriteLong(static_cast<uint64_t>(timestamp_delta_signed), 64);
+    compressed_size_in_bits_ += ts_bits;
+    stats_.timestamp_bits += ts_bits;
+    
+    // Residuals are exact integers: the reconstruction is the grid point itself
+    const GridPoint& prediction = pred[best_predictor];
+    int bits_before_data = compressed_size_in_bits_;
+    compressed_size_in_bits_ += EliasGammaCodec::Encode(
+        ZigZagCodec::Encode(grid_point.x - prediction.x) + 1, output_bit_stream_.get());
+    compressed_size_in_bits_ += EliasGammaCodec::Encode(
+        ZigZagCodec::Encode(grid_point.y - prediction.y) + 1, output_bit_stream_.get());
+    stats_.quantized_data_bits += (compressed_size_in_bits_ - bits_before_data);
+    
+    grid_predictor_.Push(grid_point);
+    current_reconstructed_point_ = FromGrid(grid_point);
+    
+    switch (best_predictor) {
+        case PREDICTOR_LDR: stats_.ldr_count++; break;
+        case PREDICTOR_CP: stats_.cp_count++; break;
+        default: stats_.zp_count++; break;
+    }
+    double error = CalculateDistance(point, current_reconstructed_point_);
+    stats_.total_prediction_error += error;
+    stats_.max_prediction_error = std::max(stats_.max_prediction_error, error);
+    stats_.prediction_errors.push_back(error);
+}
+
+void CoSTCompressor::EncodeMultiPredictor(const GpsPoint& point, const SearchChoice* choice) {
  // （timestamp）
     GpsPoint pred_ldr, pred_cp, pred_zp;
     ParallelPredict(pred_ldr, pred_cp, pred_zp, point.timestamp);
+    GpsPoint pred_rt = PredictRouteTemplate(pred_ldr, point.timestamp);
     
  // （）
     GpsPoint best_prediction;
     int best_cost;
-    PredictorType best_predictor = SelectBestPredictorByCost(
-        point, pred_ldr, pred_cp, pred_zp, best_prediction, best_cost);
+    PredictorType best_predictor;
+    if (choice != nullptr) {
+        const GpsPoint predictions[kMaxPredictors] = {pred_ldr, pred_cp, pred_zp, pred_rt};
+        best_predictor = choice->predictor;
+        best_prediction = predictions[best_predictor];
+    } else {
+        best_predictor = SelectBestPredictorByCost(
+            point, pred_ldr, pred_cp, pred_zp, pred_rt, best_prediction, best_cost);
+    }
     
  // 、timestamp
     EncodePrediction(best_predictor, point, best_prediction);
@@ -150,6 +1216,7 @@ void CoSTCompressor::EncodeMultiPredictor(const GpsPoint& point) {
         case PREDICTOR_LDR: stats_.ldr_count++; break;
         case PREDICTOR_CP: stats_.cp_count++; break;
         case PREDICTOR_ZP: stats_.zp_count++; break;
+        case PREDICTOR_RT: stats_.rt_count++; break;
     }
 }
 
@@ -163,32 +1230,12 @@ void CoSTCompressor::EncodeLDROnly(const GpsPoint& point) {
  // ：timestamp（），int64_tdelta
     int64_t timestamp_delta_signed = static_cast<int64_t>(point.timestamp) - static_cast<int64_t>(current_reconstructed_point_.timestamp);
     uint64_t timestamp_delta = static_cast<uint64_t>(timestamp_delta_signed);
-    int ts_bits = output_bit_stream_->WriteLong(timestamp_delta, 64);
+    int ts_bits = WriteTimestampWord(timestamp_delta);
     compressed_size_in_bits_ += ts_bits;
     stats_.timestamp_bits += ts_bits;
     
  // 2. LDR
-    GpsPoint delta = point - pred_ldr;
-    
-    // (comment removed)
-    int64_t quantized_delta_lon = static_cast<int64_t>(std::round(delta.longitude / kQuantStep));
-    int64_t quantized_delta_lat = static_cast<int64_t>(std::round(delta.latitude / kQuantStep));
-    
- // （ZigZag + Elias Gamma）
-    int bits_before = compressed_size_in_bits_;
-    compressed_size_in_bits_ += EliasGammaCodec::Encode(
-        ZigZagCodec::Encode(quantized_delta_lon) + 1, output_bit_stream_.get());
-    compressed_size_in_bits_ += EliasGammaCodec::Encode(
-        ZigZagCodec::Encode(quantized_delta_lat) + 1, output_bit_stream_.get());
-    stats_.quantized_data_bits += (compressed_size_in_bits_ - bits_before);
-    
- // （）
-    GpsPoint reconstructed_delta(
-        quantized_delta_lon * kQuantStep,
-        quantized_delta_lat * kQuantStep,
-        0
-    );
-    GpsPoint reconstructed_point = pred_ldr + reconstructed_delta;
+    GpsPoint reconstructed_point = EncodeResidual(point, pred_ldr);
     reconstructed_point.timestamp = point.timestamp;  // 
     
     // (comment removed)
@@ -211,33 +1258,51 @@ CoSTCompressor::PredictorType CoSTCompressor::SelectBestPredictorByCost(
     const GpsPoint& pred_ldr,
     const GpsPoint& pred_cp,
     const GpsPoint& pred_zp,
+    const GpsPoint& pred_rt,
     GpsPoint& best_prediction,
     int& best_cost) {
     
-    // (comment removed)
-    GpsPoint error_ldr = current_point - pred_ldr;
-    GpsPoint error_cp = current_point - pred_cp;
-    GpsPoint error_zp = current_point - pred_zp;
-    
  // （Huffman + ）
-    int cost_ldr = GetHuffmanBitCost(PREDICTOR_LDR) + EstimateErrorEncodingCost(error_ldr);
-    int cost_cp = GetHuffmanBitCost(PREDICTOR_CP) + EstimateErrorEncodingCost(error_cp);
-    int cost_zp = GetHuffmanBitCost(PREDICTOR_ZP) + EstimateErrorEncodingCost(error_zp);
+    int cost_ldr = GetHuffmanBitCost(PREDICTOR_LDR) + EstimateResidualCost(current_point, pred_ldr);
+    int cost_cp = GetHuffmanBitCost(PREDICTOR_CP) + EstimateResidualCost(current_point, pred_cp);
+    int cost_zp = GetHuffmanBitCost(PREDICTOR_ZP) + EstimateResidualCost(current_point, pred_zp);
     
     // (comment removed)
+    PredictorType best_predictor;
     if (cost_ldr <= cost_cp && cost_ldr <= cost_zp) {
         best_prediction = pred_ldr;
         best_cost = cost_ldr;
-        return PREDICTOR_LDR;
+        best_predictor = PREDICTOR_LDR;
     } else if (cost_cp <= cost_zp) {
         best_prediction = pred_cp;
         best_cost = cost_cp;
-        return PREDICTOR_CP;
+        best_predictor = PREDICTOR_CP;
     } else {
         best_prediction = pred_zp;
         best_cost = cost_zp;
-        return PREDICTOR_ZP;
+        best_predictor = PREDICTOR_ZP;
+    }
+    
+    // RT only wins on a strictly lower cost, so ties keep the classic predictors
+    if (num_predictors_ > PREDICTOR_RT) {
+        int cost_rt = GetHuffmanBitCost(PREDICTOR_RT) + EstimateResidualCost(current_point, pred_rt);
+        if (cost_rt < best_cost) {
+            best_prediction = pred_rt;
+            best_cost = cost_rt;
+            best_predictor = PREDICTOR_RT;
+        }
     }
+    return best_predictor;
+}
+
+CoSTCompressor::GpsPoint CoSTCompressor::PredictRouteTemplate(const GpsPoint& pred_ldr,
+                                                              uint64_t current_timestamp) const {
+    if (num_predictors_ <= PREDICTOR_RT || route_segment_ < 0) return pred_ldr;
+    
+    double dt = CoSTArithmetic::TimeStep(current_timestamp, current_reconstructed_point_.timestamp);
+    GpsPoint prediction = route_templates_->Advance(route_id_, route_segment_, route_offset_, dt);
+    prediction.timestamp = current_timestamp;
+    return prediction;
 }
 
 int CoSTCompressor::EstimateEliasGammaBits(int64_t value) const {
@@ -250,20 +1315,37 @@ int CoSTCompressor::EstimateEliasGammaBits(int64_t value) const {
     return 2 * log2_val + 1;
 }
 
-int CoSTCompressor::EstimateErrorEncodingCost(const GpsPoint& error) const {
+int CoSTCompressor::EstimateResidualCost(const GpsPoint& point, const GpsPoint& prediction) const {
+    if (lossless_) {
+        return XorResidualCodec::EstimateBits(Double::DoubleToLongBits(point.longitude) ^
+                                              Double::DoubleToLongBits(prediction.longitude)) +
+               XorResidualCodec::EstimateBits(Double::DoubleToLongBits(point.latitude) ^
+                                              Double::DoubleToLongBits(prediction.latitude));
+    }
+    return EstimateErrorEncodingCost(point - prediction, prediction.latitude);
+}
+
+int CoSTCompressor::EstimateErrorEncodingCost(const GpsPoint& error, double prediction_latitude) const {
+    if (hex_lattice_) {
+        LatticeIndex index = QuantizeHex(error, kQuantStep);
+        return EstimateResidualCodeBits(ZigZagCodec::Encode(index.column) + 1, ZigZagCodec::Encode(index.row) + 1);
+    }
+    
     // (comment removed)
-    int64_t quantized_lon = static_cast<int64_t>(std::round(error.longitude / kQuantStep));
     int64_t quantized_lat = static_cast<int64_t>(std::round(error.latitude / kQuantStep));
+    int64_t quantized_lon = static_cast<int64_t>(std::round(error.longitude / LonQuantStep(prediction_latitude, quantized_lat)));
     
  // ZigZag
     uint64_t zigzag_lon = ZigZagCodec::Encode(quantized_lon);
     uint64_t zigzag_lat = ZigZagCodec::Encode(quantized_lat);
     
+    return EstimateResidualCodeBits(zigzag_lon + 1, zigzag_lat + 1);
+}
+
+int CoSTCompressor::EstimateResidualCodeBits(uint64_t lon_code, uint64_t lat_code) const {
+    if (residual_model_ != nullptr) return residual_model_->Cost(lon_code, lat_code);
  // Elias Gamma
-    int bits_lon = EstimateEliasGammaBits(zigzag_lon + 1);
-    int bits_lat = EstimateEliasGammaBits(zigzag_lat + 1);
-    
-    return bits_lon + bits_lat;
+    return EstimateEliasGammaBits(lon_code) + EstimateEliasGammaBits(lat_code);
 }
 
 // ========== ==========
@@ -311,22 +1393,44 @@ void CoSTCompressor::EvaluateAndSwitchModeBasedOnCost() {
     if (point_costs_multi_.size() < static_cast<size_t>(kEvaluationWindow)) return;
     
  // 1（）
-    const int kActualSwitchCost = 1;
+    const int kActualSwitchCost = CoSTArithmetic::kModeSwitchCost;
+    
+    // Segment costs arrive when a segment closes; compare them per point, once
+    // half a window of them is known
+    long long window_cost[3] = {window_total_cost_multi_, window_total_cost_ldr_only_, LLONG_MAX};
+    if (segment_mode_ && point_costs_segment_.size() * 2 >= point_costs_multi_.size()) {
+        window_cost[MODE_SEGMENT] = window_total_cost_segment_ * static_cast<long long>(point_costs_multi_.size()) /
+                                    static_cast<long long>(point_costs_segment_.size());
+    }
     
-    if (current_mode_ == MODE_MULTI_PREDICTOR) {
- // ：（1）
-        if (window_total_cost_ldr_only_ < window_total_cost_multi_ - kActualSwitchCost) {
-            current_mode_ = MODE_LDR_ONLY;
-            stats_.mode_switch_count++;
- // kClearWindowAfterSwitch false，
+ // （1）
+    CompressionMode best_mode = current_mode_;
+    for (CompressionMode mode : {MODE_MULTI_PREDICTOR, MODE_LDR_ONLY, MODE_SEGMENT}) {
+        if (mode != current_mode_ && window_cost[mode] < window_cost[current_mode_] - kActualSwitchCost &&
+            (best_mode == current_mode_ || window_cost[mode] < window_cost[best_mode])) {
+            best_mode = mode;
         }
-    } else {  // current_mode_ == MODE_LDR_ONLY
- // ：（1）
-        if (window_total_cost_multi_ < window_total_cost_ldr_only_ - kActualSwitchCost) {
-            current_mode_ = MODE_MULTI_PREDICTOR;
-            stats_.mode_switch_count++;
+    }
+    if (best_mode != current_mode_) {
+        current_mode_ = best_mode;
+        stats_.mode_switch_count++;
+        estimate_cone_.count = 0;  // the estimate restarts from the next point
  // kClearWindowAfterSwitch false，
+    }
+}
+
+void CoSTCompressor::PushSegmentCost(int cost, uint64_t timestamp) {
+    point_costs_segment_.push_back(CostRecord(cost, timestamp));
+    window_total_cost_segment_ += cost;
+    if (use_time_window_) {
+        uint64_t window_start_time = timestamp > kTimeWindowSeconds ? timestamp - kTimeWindowSeconds : 0;
+        while (!point_costs_segment_.empty() && point_costs_segment_.front().timestamp < window_start_time) {
+            window_total_cost_segment_ -= point_costs_segment_.front().cost;
+            point_costs_segment_.pop_front();
         }
+    } else if (point_costs_segment_.size() > static_cast<size_t>(kEvaluationWindow)) {
+        window_total_cost_segment_ -= point_costs_segment_.front().cost;
+        point_costs_segment_.pop_front();
     }
 }
 
@@ -335,6 +1439,8 @@ void CoSTCompressor::EvaluateAndSwitchModeBasedOnCost() {
 // ========== Huffman ==========
 
 int CoSTCompressor::GetHuffmanBitCost(PredictorType predictor) const {
+    // Level 2 has no RT (rejected in Configure)
+    if (level_ == 2 && predictor < CompactFlagModel::kPredictors) return compact_flags_.CodeLength(predictor);
     return huffman_codes_[predictor].length;
 }
 
@@ -345,11 +1451,10 @@ void CoSTCompressor::UpdateHuffmanCodes() {
         int frequency;
     };
     
-    std::vector<PredictorFreq> freq_list = {
-        {PREDICTOR_LDR, predictor_frequency_[PREDICTOR_LDR]},
-        {PREDICTOR_CP, predictor_frequency_[PREDICTOR_CP]},
-        {PREDICTOR_ZP, predictor_frequency_[PREDICTOR_ZP]}
-    };
+    std::vector<PredictorFreq> freq_list;
+    for (int i = 0; i < num_predictors_; ++i) {
+        freq_list.push_back({static_cast<PredictorType>(i), predictor_frequency_[i]});
+    }
     
  // ：
     std::sort(freq_list.begin(), freq_list.end(), 
@@ -364,12 +1469,22 @@ void CoSTCompressor::UpdateHuffmanCodes() {
     
  // Huffman：0 (1 bit)，10 (2 bits)，11 (2 bits)
  // ，
-    huffman_codes_[freq_list[0].type] = HuffmanCode({false});                      // 0 (1 bit)
-    huffman_codes_[freq_list[1].type] = HuffmanCode({true, false});                // 10 (2 bits)
-    huffman_codes_[freq_list[2].type] = HuffmanCode({true, true});                 // 11 (2 bits)
+    // Rank r gets r ones followed by a zero; the last rank drops the zero (0, 10, 110, 111)
+    for (int rank = 0; rank < num_predictors_; ++rank) {
+        std::vector<bool> bits(rank, true);
+        if (rank < num_predictors_ - 1) bits.push_back(false);
+        huffman_codes_[freq_list[rank].type] = HuffmanCode(bits);
+    }
 }
 
 void CoSTCompressor::EncodeWithHuffman(PredictorType predictor) {
+    if (level_ == 2) {
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(compact_flags_.Code(predictor),
+                                                                 compact_flags_.CodeLength(predictor));
+        compact_flags_.Add(predictor);
+        return;
+    }
+    
     const HuffmanCode& code = huffman_codes_[predictor];
     for (bool bit : code.bits) {
         output_bit_stream_->WriteBit(bit);
@@ -382,6 +1497,7 @@ void CoSTCompressor::EncodeWithHuffman(PredictorType predictor) {
 
 void CoSTCompressor::AddPredictorToWindow(PredictorType predictor) {
     predictor_window_.push_back(predictor);
+    predictor_flags_++;
     predictor_frequency_[predictor]++;
     
     if (predictor_window_.size() > kSlidingWindowSize) {
@@ -397,41 +1513,221 @@ void CoSTCompressor::AddPredictorToWindow(PredictorType predictor) {
 }
 
 void CoSTCompressor::Close() {
+    if (!block_points_.empty()) EncodeBlock();
+    FlushPendingPoints();
     output_bit_stream_->Flush();
+    WritePointCount();
     stats_.total_bits = compressed_size_in_bits_;
 }
 
+void CoSTCompressor::WritePointCount() {
+    // Packets have left already, and a full block keeps the field it has
+    int points = stats_.total_points;
+    if (first_point_ || packet_start_bits_ != 0 || points >= kBlockSize) return;
+    if (stream_profiles_ == nullptr) {
+        output_bit_stream_->WriteAt(0, std::min(static_cast<uint32_t>(points), kUncountedBlock), 16);
+    } else {
+        // The Elias-gamma field keeps its length: the shorter code of the count
+        // is padded with leading ones, which CoSTDecompressor::ReadHeader skips
+        int field_bits = EstimateEliasGammaBits(static_cast<int64_t>(kBlockSize) + 1);
+        int count_bits = EstimateEliasGammaBits(static_cast<int64_t>(points) + 1);
+        uint64_t padding = ((1ull << (field_bits - count_bits)) - 1) << count_bits;
+        output_bit_stream_->WriteAt(16 + 8, padding | (static_cast<uint64_t>(points) + 1), field_bits);
+    }
+}
+
+void CoSTCompressor::FlushPendingPoints() {
+    if (pending_count_ > 0) CommitSearchSteps(pending_count_);
+    FlushStationaryRun();
+    while (!segment_points_.empty()) FlushSegment();
+}
+
+void CoSTCompressor::EncodeBlock() {
+    // First pass in Elias-gamma for the payload lengths, then, if classes fitted
+    // to them are smaller, the block again from a fresh stream with the classes.
+    // The search prices residuals in Elias-gamma either way, so both passes code
+    // the same residuals (rate control aside, which follows the bits)
+    std::vector<GpsPoint> points = std::move(block_points_);
+    std::vector<double> attributes = std::move(block_attributes_);
+    size_t channels = attribute_codecs_.size();
+    block_replay_ = true;
+    block_class_bits_ = -1;
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass == 1) {
+            if (!BuildBlockClasses()) break;  // keep the first pass
+            Reset();
+        }
+        for (size_t i = 0; i < points.size(); ++i) {
+            AddGpsPoint(points[i], channels > 0 ? &attributes[i * channels] : nullptr);
+        }
+        if (pass == 0) FlushPendingPoints();
+    }
+    block_replay_ = false;
+}
+
+bool CoSTCompressor::BuildBlockClasses() {
+    if (block_payload_lengths_[kMaxPayloadBits + 1] > 0) return false;
+    
+    // The solver rounds a position down to the nearest office; positions count
+    // down from the widest payload, so that rounds a length up to a class that holds it
+    Array<int> distribution(kMaxPayloadBits + 1);
+    Array<int> representation(kMaxPayloadBits + 1);
+    Array<int> round(kMaxPayloadBits + 1);
+    for (int length = 0; length <= kMaxPayloadBits; ++length) {
+        distribution[kMaxPayloadBits - length] = block_payload_lengths_[length];
+    }
+    Array<int> positions = PostOfficeSolver::InitRoundAndRepresentation(distribution, representation, round);
+    int class_bits = 31 - __builtin_clz(positions.length());  // 2^z classes, the first of width kMaxPayloadBits
+    
+    int64_t bits = 3 + static_cast<int64_t>(positions.length()) * kBlockClassWidthBits;  // header table
+    for (int length = 0; length <= kMaxPayloadBits; ++length) {
+        bits += static_cast<int64_t>(block_payload_lengths_[length]) *
+                (class_bits + kMaxPayloadBits - round[kMaxPayloadBits - length]);
+    }
+    if (bits >= block_gamma_bits_) return false;
+    
+    block_class_bits_ = class_bits;
+    for (int i = 0; i < positions.length(); ++i) {
+        block_class_widths_[i] = static_cast<uint8_t>(kMaxPayloadBits - positions[i]);
+    }
+    for (int length = 0; length <= kMaxPayloadBits; ++length) {
+        block_class_of_length_[length] = static_cast<uint8_t>(representation[kMaxPayloadBits - length]);
+    }
+    return true;
+}
+
 Array<uint8_t> CoSTCompressor::GetCompressedData() {
     int byte_length = (compressed_size_in_bits_ + 7) / 8;
     return output_bit_stream_->GetBuffer(byte_length);
 }
 
+ArrayView<const uint8_t> CoSTCompressor::GetCompressedView() const {
+    return output_bit_stream_->GetView((compressed_size_in_bits_ + 7) / 8);
+}
+
+int CoSTCompressor::GetCompressedData(uint8_t* out, int capacity) const {
+    int byte_length = (compressed_size_in_bits_ + 7) / 8;
+    if (capacity < byte_length) throw std::invalid_argument("CoST: output buffer too small");
+    output_bit_stream_->CopyBuffer(out, byte_length);
+    return byte_length;
+}
+
+Array<uint8_t> CoSTCompressor::TakePacket() {
+    if (block_classes_) throw std::invalid_argument("CoST: packets are not available with block residual classes");
+    // A packet carries every point added so far
+    FlushPendingPoints();
+    int byte_length = (compressed_size_in_bits_ - packet_start_bits_ + 7) / 8;
+    output_bit_stream_->Flush();
+    Array<uint8_t> packet = output_bit_stream_->GetBuffer(byte_length);
+    output_bit_stream_->Refresh();
+    packet_start_bits_ = compressed_size_in_bits_;
+    return packet;
+}
+
 void CoSTCompressor::ProcessFirstPoint(const GpsPoint& point) {
     first_point_ = false;
+    trip_starts_.push_back(0);
     
     // (comment removed)
-    compressed_size_in_bits_ += output_bit_stream_->WriteInt(kBlockSize, 16);
-    compressed_size_in_bits_ += output_bit_stream_->WriteLong(Double::DoubleToLongBits(kEpsilon), 64);
-    compressed_size_in_bits_ += output_bit_stream_->WriteInt(kEvaluationWindow, 16);  // （）
+    // Resolve the route template before the header so the choice can be recorded
+    uint32_t features = integer_grid_ ? FEATURE_INTEGER_GRID : 0;
+    if (!attribute_codecs_.empty()) features |= FEATURE_ATTRIBUTES;
+    if (level_ != kDefaultLevel) features |= FEATURE_LEVEL;
+    if (level_ == 2) features |= FEATURE_COMPACT_PROFILE;
+    if (rate_control_) features |= FEATURE_RATE_CONTROL;
+    if (stationary_runs_) features |= FEATURE_STATIONARY_RUNS;
+    if (segment_mode_) features |= FEATURE_SEGMENTS;
+    if (gap_seconds_ > 0) features |= FEATURE_GAP_ESCAPES;
+    if (hex_lattice_) features |= FEATURE_HEX_LATTICE;
+    if (metric_bound_) features |= FEATURE_METRIC_BOUND;
+    if (precision_map_ != nullptr) features |= FEATURE_PRECISION_MAP;
+    if (residual_model_ != nullptr) features |= FEATURE_ADAPTIVE_RESIDUALS;
+    if (block_class_bits_ >= 0) features |= FEATURE_BLOCK_CLASSES;  // not in the discarded first pass
+    if (prior_id_ >= 0) features |= FEATURE_PREDICTOR_PRIOR;
+    if (route_templates_ != nullptr) {
+        if (route_id_ == kAutoSelectRoute) route_id_ = route_templates_->FindBestTemplate(point);
+        if (route_id_ >= 0 && route_templates_->HasTemplate(route_id_)) {
+            features |= FEATURE_ROUTE_TEMPLATE;
+        }
+    }
     
+    if (stream_profiles_ != nullptr) {
+        // Compact header: the profile stands for epsilon and the window settings
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(kCompactHeaderMarker, 16);
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(stream_profile_id_, 8);
+        compressed_size_in_bits_ += EliasGammaCodec::Encode(static_cast<uint64_t>(kBlockSize) + 1,
+                                                            output_bit_stream_.get());
+        compressed_size_in_bits_ += output_bit_stream_->WriteBit(features != 0);
+    } else {
+        // The block size field never takes the compact header marker (block_size >= 1)
+        uint32_t block_field = std::min(static_cast<uint32_t>(kBlockSize), kUncountedBlock);
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(block_field, 16);
+        double header_epsilon = rate_control_ ? rate_epsilons_[0] : kEpsilon;  // rate control: bottom of the ladder
+        compressed_size_in_bits_ += output_bit_stream_->WriteLong(Double::DoubleToLongBits(header_epsilon), 64);
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(
+            kEvaluationWindow | (features != 0 ? kHeaderExtensionFlag : 0), 16);  // （）
+        
  // （）
-    compressed_size_in_bits_ += output_bit_stream_->WriteBit(use_time_window_);  // 1：
-    if (use_time_window_) {
-        compressed_size_in_bits_ += output_bit_stream_->WriteInt(kTimeWindowSeconds, 32);  // 32：（）
+        compressed_size_in_bits_ += output_bit_stream_->WriteBit(use_time_window_);  // 1：
+        if (use_time_window_) {
+            compressed_size_in_bits_ += output_bit_stream_->WriteInt(kTimeWindowSeconds, 32);  // 32：（）
+        }
     }
     
-    // (comment removed)
-    compressed_size_in_bits_ += output_bit_stream_->WriteLong(Double::DoubleToLongBits(point.longitude), 64);
-    compressed_size_in_bits_ += output_bit_stream_->WriteLong(Double::DoubleToLongBits(point.latitude), 64);
+    if (features != 0) {
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(features, 16);
+    }
+    if (features & FEATURE_ROUTE_TEMPLATE) {
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(route_id_, 16);
+        // RT starts as the most likely predictor on a matched route
+        num_predictors_ = kMaxPredictors;
+        predictor_frequency_[PREDICTOR_RT] = prior_.predictor_frequency[PREDICTOR_RT];
+        UpdateHuffmanCodes();
+    }
+    if (features & FEATURE_LEVEL) {
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(level_, 4);
+    }
+    if (features & FEATURE_RATE_CONTROL) {
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(rate_epsilons_.size() - 1, 6);
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(rate_step_, 6);
+    }
+    if (features & FEATURE_ATTRIBUTES) {
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(attribute_codecs_.size(), 4);
+        for (const AttributeChannelCodec& codec : attribute_codecs_) {
+            compressed_size_in_bits_ += codec.WriteChannel(output_bit_stream_.get());
+        }
+    }
+    if (features & FEATURE_PREDICTOR_PRIOR) {
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(prior_id_, 16);
+    }
+    if (features & FEATURE_PRECISION_MAP) {
+        // The header epsilon above is level 0; the stream starts at the level of the first point
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(precision_epsilons_.size() - 1, 4);
+        for (size_t level = 1; level < precision_epsilons_.size(); ++level) {
+            compressed_size_in_bits_ += output_bit_stream_->WriteLong(Double::DoubleToLongBits(precision_epsilons_[level]), 64);
+        }
+        SetPrecisionLevel(precision_map_->Lookup(point.longitude, point.latitude));
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(precision_level_, 4);
+    }
+    if (features & FEATURE_BLOCK_CLASSES) {
+        compressed_size_in_bits_ += output_bit_stream_->WriteInt(block_class_bits_, 3);
+        for (int i = 0; i < 1 << block_class_bits_; ++i) {
+            compressed_size_in_bits_ += output_bit_stream_->WriteInt(block_class_widths_[i], kBlockClassWidthBits);
+        }
+    }
     
- // timestamp（64）
-    int ts_bits = output_bit_stream_->WriteLong(point.timestamp, 64);
-    compressed_size_in_bits_ += ts_bits;
-    stats_.timestamp_bits += ts_bits;
+    GpsPoint start = EncodeFirstPoint(point);
     
     // (comment removed)
-    current_reconstructed_point_ = point;
-    history_states_.emplace_back(point, GpsPoint(0, 0, 0));  // 0
+    current_reconstructed_point_ = start;
+    history_states_.emplace_back(start, GpsPoint(0, 0, 0));  // 0
+    if (integer_grid_) {
+        grid_predictor_.Push(ToGrid(point));
+        current_reconstructed_point_ = FromGrid(grid_predictor_.Last());
+    }
+    if (num_predictors_ > PREDICTOR_RT) {
+        route_templates_->Locate(route_id_, start, route_segment_, route_offset_);
+    }
     
  // （）
     if (use_time_window_) {
@@ -439,6 +1735,49 @@ void CoSTCompressor::ProcessFirstPoint(const GpsPoint& point) {
     }
 }
 
+CoSTCompressor::GpsPoint CoSTCompressor::EncodeFirstPoint(const GpsPoint& point) {
+    if (stream_profiles_ == nullptr) {
+        // (comment removed)
+        if (integer_grid_) {
+            GridPoint grid_point = ToGrid(point);
+            compressed_size_in_bits_ += output_bit_stream_->WriteLong(static_cast<uint64_t>(grid_point.x), 64);
+            compressed_size_in_bits_ += output_bit_stream_->WriteLong(static_cast<uint64_t>(grid_point.y), 64);
+        } else {
+            compressed_size_in_bits_ += output_bit_stream_->WriteLong(Double::DoubleToLongBits(point.longitude), 64);
+            compressed_size_in_bits_ += output_bit_stream_->WriteLong(Double::DoubleToLongBits(point.latitude), 64);
+        }
+        
+ // timestamp（64）
+        int ts_bits = output_bit_stream_->WriteLong(point.timestamp, 64);
+        compressed_size_in_bits_ += ts_bits;
+        stats_.timestamp_bits += ts_bits;
+        return point;
+    }
+    
+    // Compact header: position on the quantization grid against the profile
+    // origin, timestamp against the time origin (both ZigZag + Elias-gamma)
+    const GpsPoint& origin = stream_profiles_->GetProfile(stream_profile_id_).origin;
+    GpsPoint start = point;
+    if (integer_grid_) {
+        GridPoint grid_point = ToGrid(point);
+        GridPoint grid_origin = ToGrid(origin);
+        int bits_before_data = compressed_size_in_bits_;
+        compressed_size_in_bits_ += EliasGammaCodec::Encode(
+            ZigZagCodec::Encode(grid_point.x - grid_origin.x) + 1, output_bit_stream_.get());
+        compressed_size_in_bits_ += EliasGammaCodec::Encode(
+            ZigZagCodec::Encode(grid_point.y - grid_origin.y) + 1, output_bit_stream_.get());
+        stats_.quantized_data_bits += (compressed_size_in_bits_ - bits_before_data);
+    } else {
+        start = EncodeResidual(point, origin);
+        start.timestamp = point.timestamp;
+    }
+    int ts_bits = EliasGammaCodec::Encode(
+        ZigZagCodec::Encode(static_cast<int64_t>(point.timestamp - origin.timestamp)) + 1, output_bit_stream_.get());
+    compressed_size_in_bits_ += ts_bits;
+    stats_.timestamp_bits += ts_bits;
+    return start;
+}
+
 void CoSTCompressor::ParallelPredict(GpsPoint& pred_ldr, GpsPoint& pred_cp, GpsPoint& pred_zp, uint64_t current_timestamp) {
  // （ZP）
     pred_zp = current_reconstructed_point_;
@@ -449,32 +1788,21 @@ void CoSTCompressor::ParallelPredict(GpsPoint& pred_ldr, GpsPoint& pred_cp, GpsP
         return;
     }
     
- // ，int64_ttimestampunderflow
-    int64_t delta_time_signed = static_cast<int64_t>(current_timestamp) - static_cast<int64_t>(current_reconstructed_point_.timestamp);
-    double dt = (delta_time_signed > 0) ? static_cast<double>(delta_time_signed) : 1.0;  // 1fallback
+    // Shared with CompactCoSTEncoder and CoSTDecompressor (1 s for non-positive deltas)
+    double dt = CoSTArithmetic::TimeStep(current_timestamp, current_reconstructed_point_.timestamp);
+    const GpsPoint& last = current_reconstructed_point_;
     
  // （LDR）：（/）
-    GpsPoint velocity = history_states_[history_states_.size() - 1].velocity;
-    pred_ldr = GpsPoint(
-        current_reconstructed_point_.longitude + velocity.longitude * dt,
-        current_reconstructed_point_.latitude + velocity.latitude * dt,
-        current_timestamp
-    );
+    const GpsPoint& velocity = history_states_[history_states_.size() - 1].velocity;
+    pred_ldr = GpsPoint(CoSTArithmetic::Linear(last.longitude, velocity.longitude, dt),
+                        CoSTArithmetic::Linear(last.latitude, velocity.latitude, dt), current_timestamp);
     
  // （CP）：（）
-    if (history_states_.size() >= 3 && dt > 0) {
- // （）
-        GpsPoint velocity = history_states_[history_states_.size() - 1].velocity;
-        GpsPoint prev_velocity = history_states_[history_states_.size() - 2].velocity;
-        GpsPoint acceleration = velocity - prev_velocity;
-        
- // ：position + velocity*dt + 0.5*acceleration*dt^2
-        double dt_sq_half = dt * dt * 0.5;
-        pred_cp = GpsPoint(
-            current_reconstructed_point_.longitude + velocity.longitude * dt + acceleration.longitude * dt_sq_half,
-            current_reconstructed_point_.latitude + velocity.latitude * dt + acceleration.latitude * dt_sq_half,
-            current_timestamp
-        );
+    if (history_states_.size() >= 3) {
+        const GpsPoint& prev_velocity = history_states_[history_states_.size() - 2].velocity;
+        pred_cp = GpsPoint(CoSTArithmetic::Curved(last.longitude, velocity.longitude, prev_velocity.longitude, dt),
+                           CoSTArithmetic::Curved(last.latitude, velocity.latitude, prev_velocity.latitude, dt),
+                           current_timestamp);
     } else {
         pred_cp = pred_ldr;
     }
@@ -492,42 +1820,87 @@ void CoSTCompressor::EncodePrediction(PredictorType predictor,
  // ：timestamp（），int64_tdelta，uint64_t
     int64_t timestamp_delta_signed = static_cast<int64_t>(current_point.timestamp) - static_cast<int64_t>(current_reconstructed_point_.timestamp);
     uint64_t timestamp_delta = static_cast<uint64_t>(timestamp_delta_signed);  // bit pattern
-    int ts_bits = output_bit_stream_->WriteLong(timestamp_delta, 64);
+    int ts_bits = WriteTimestampWord(timestamp_delta);
     compressed_size_in_bits_ += ts_bits;
     stats_.timestamp_bits += ts_bits;
     
  // 3. 
-    GpsPoint delta = current_point - predicted_point;
+    GpsPoint reconstructed_point = EncodeResidual(current_point, predicted_point);
+    reconstructed_point.timestamp = current_point.timestamp;  // 
     
     // (comment removed)
-    int64_t quantized_delta_lon = static_cast<int64_t>(std::round(delta.longitude / kQuantStep));
-    int64_t quantized_delta_lat = static_cast<int64_t>(std::round(delta.latitude / kQuantStep));
+    UpdateReconstructedState(reconstructed_point);
     
     // (comment removed)
+    double error = CalculateDistance(current_point, reconstructed_point);
+    stats_.total_prediction_error += error;
+    stats_.max_prediction_error = std::max(stats_.max_prediction_error, error);
+    stats_.prediction_errors.push_back(error);
+}
+
+CoSTCompressor::GpsPoint CoSTCompressor::EncodeResidual(const GpsPoint& point, const GpsPoint& prediction) {
     int bits_before_data = compressed_size_in_bits_;
-    compressed_size_in_bits_ += EliasGammaCodec::Encode(
-        ZigZagCodec::Encode(quantized_delta_lon) + 1, output_bit_stream_.get());
-    compressed_size_in_bits_ += EliasGammaCodec::Encode(
-        ZigZagCodec::Encode(quantized_delta_lat) + 1, output_bit_stream_.get());
+    
+    if (lossless_) {
+        // XOR of the IEEE bits: the reconstruction is the point itself
+        compressed_size_in_bits_ += XorResidualCodec::Encode(
+            Double::DoubleToLongBits(point.longitude) ^ Double::DoubleToLongBits(prediction.longitude),
+            output_bit_stream_.get());
+        compressed_size_in_bits_ += XorResidualCodec::Encode(
+            Double::DoubleToLongBits(point.latitude) ^ Double::DoubleToLongBits(prediction.latitude),
+            output_bit_stream_.get());
+        stats_.quantized_data_bits += (compressed_size_in_bits_ - bits_before_data);
+        return point;
+    }
+    
+    GpsPoint delta = point - prediction;
+    if (hex_lattice_) {
+        LatticeIndex index = QuantizeHex(delta, kQuantStep);
+        compressed_size_in_bits_ += WriteResidualCodes(ZigZagCodec::Encode(index.column) + 1,
+                                                       ZigZagCodec::Encode(index.row) + 1);
+        stats_.quantized_data_bits += (compressed_size_in_bits_ - bits_before_data);
+        return prediction + HexLatticePoint(index, kQuantStep);
+    }
+    
+    // (comment removed)
+    int64_t quantized_delta_lat = static_cast<int64_t>(std::round(delta.latitude / kQuantStep));
+    double lon_quant_step = LonQuantStep(prediction.latitude, quantized_delta_lat);
+    int64_t quantized_delta_lon = static_cast<int64_t>(std::round(delta.longitude / lon_quant_step));
+    
+ // （ZigZag + Elias Gamma）
+    compressed_size_in_bits_ += WriteResidualCodes(ZigZagCodec::Encode(quantized_delta_lon) + 1,
+                                                   ZigZagCodec::Encode(quantized_delta_lat) + 1);
     stats_.quantized_data_bits += (compressed_size_in_bits_ - bits_before_data);
     
  // （）
     GpsPoint reconstructed_delta(
-        quantized_delta_lon * kQuantStep,
+        quantized_delta_lon * lon_quant_step,
         quantized_delta_lat * kQuantStep,
         0
     );
-    GpsPoint reconstructed_point = predicted_point + reconstructed_delta;
-    reconstructed_point.timestamp = current_point.timestamp;  // 
-    
-    // (comment removed)
-    UpdateReconstructedState(reconstructed_point);
-    
-    // (comment removed)
-    double error = CalculateDistance(current_point, reconstructed_point);
-    stats_.total_prediction_error += error;
-    stats_.max_prediction_error = std::max(stats_.max_prediction_error, error);
-    stats_.prediction_errors.push_back(error);
+    return prediction + reconstructed_delta;
+}
+
+int CoSTCompressor::WriteResidualCodes(uint64_t lon_code, uint64_t lat_code) {
+    if (residual_model_ != nullptr) return residual_model_->Encode(lon_code, lat_code, output_bit_stream_.get());
+    if (block_class_bits_ >= 0) return WriteBlockClassCode(lon_code - 1) + WriteBlockClassCode(lat_code - 1);
+    int bits = EliasGammaCodec::Encode(lon_code, output_bit_stream_.get()) +
+               EliasGammaCodec::Encode(lat_code, output_bit_stream_.get());
+    if (block_classes_) {
+        // First pass: payload lengths for the classes, and what Elias-gamma spends on them
+        block_payload_lengths_[PayloadBits(lon_code - 1)]++;
+        block_payload_lengths_[PayloadBits(lat_code - 1)]++;
+        block_gamma_bits_ += bits;
+    }
+    return bits;
+}
+
+int CoSTCompressor::WriteBlockClassCode(uint64_t payload) {
+    int length = PayloadBits(payload);
+    if (length > kMaxPayloadBits) throw std::invalid_argument("CoST: residual too large for the block residual classes");
+    int index = block_class_of_length_[length];
+    return output_bit_stream_->WriteLong(index, block_class_bits_) +
+           output_bit_stream_->WriteLong(payload, block_class_widths_[index]);
 }
 
 void CoSTCompressor::UpdateHistory(const GpsPoint& reconstructed_point) {
@@ -535,17 +1908,14 @@ void CoSTCompressor::UpdateHistory(const GpsPoint& reconstructed_point) {
     
     if (!history_states_.empty()) {
         const GpsPoint& prev_point = history_states_.back().reconstructed_point;
-        int64_t delta_time_signed = static_cast<int64_t>(reconstructed_point.timestamp) - static_cast<int64_t>(prev_point.timestamp);
-        
-        if (delta_time_signed > 0) {
  // （/）
-            double dt = static_cast<double>(delta_time_signed);
-            velocity = GpsPoint(
-                (reconstructed_point.longitude - prev_point.longitude) / dt,
-                (reconstructed_point.latitude - prev_point.latitude) / dt,
-                0
-            );
-        }
+        velocity = GpsPoint(
+            CoSTArithmetic::Velocity(reconstructed_point.longitude, prev_point.longitude,
+                                     reconstructed_point.timestamp, prev_point.timestamp),
+            CoSTArithmetic::Velocity(reconstructed_point.latitude, prev_point.latitude,
+                                     reconstructed_point.timestamp, prev_point.timestamp),
+            0
+        );
     }
     
     history_states_.emplace_back(reconstructed_point, velocity);
@@ -558,6 +1928,278 @@ void CoSTCompressor::UpdateHistory(const GpsPoint& reconstructed_point) {
 void CoSTCompressor::UpdateReconstructedState(const GpsPoint& reconstructed_point) {
     UpdateHistory(reconstructed_point);
     current_reconstructed_point_ = reconstructed_point;
+    if (num_predictors_ > PREDICTOR_RT) {
+        route_templates_->Locate(route_id_, reconstructed_point, route_segment_, route_offset_);
+    }
+}
+
+// ==================== Lookahead Search ====================
+//
+// Delayed-decision beam search over the predictor of each point and the mode
+// after each evaluation point. Every path carries a copy of the encoder state
+// that shapes later costs (reconstructed history, route position, predictor
+// flag model), so a choice is judged by its own bits plus the bits it causes
+// on the following points. The oldest pending point is encoded with the
+// choice of the cheapest path once it is lookahead_ points old, and paths
+// that disagree with it are dropped.
+
+void CoSTCompressor::SnapshotSearchState(SearchState& state) const {
+    state.reconstructed = current_reconstructed_point_;
+    state.history_size = static_cast<int>(history_states_.size());
+    for (int i = 0; i < state.history_size; ++i) state.history[i] = history_states_[i];
+    state.route_segment = route_segment_;
+    state.route_offset = route_offset_;
+    state.mode = current_mode_;
+    state.last_evaluation_timestamp = last_evaluation_timestamp_;
+    state.cost = 0;
+    for (int i = 0; i < kMaxPredictors; ++i) {
+        state.predictor_frequency[i] = predictor_frequency_[i];
+        state.code_length[i] = static_cast<uint8_t>(huffman_codes_[i].length);
+    }
+    state.pending_flags = 0;
+}
+
+// Same arithmetic as ParallelPredict and PredictRouteTemplate
+void CoSTCompressor::PredictSearchState(const SearchState& state, uint64_t timestamp,
+                                        GpsPoint predictions[kMaxPredictors]) const {
+    const GpsPoint& last = state.reconstructed;
+    double dt = CoSTArithmetic::TimeStep(timestamp, last.timestamp);
+    
+    predictions[PREDICTOR_ZP] = last;
+    if (state.history_size < 2) {
+        predictions[PREDICTOR_LDR] = last;
+        predictions[PREDICTOR_CP] = last;
+    } else {
+        const GpsPoint& velocity = state.history[state.history_size - 1].velocity;
+        predictions[PREDICTOR_LDR] = GpsPoint(CoSTArithmetic::Linear(last.longitude, velocity.longitude, dt),
+                                              CoSTArithmetic::Linear(last.latitude, velocity.latitude, dt), timestamp);
+        if (state.history_size >= 3) {
+            const GpsPoint& prev_velocity = state.history[state.history_size - 2].velocity;
+            predictions[PREDICTOR_CP] = GpsPoint(
+                CoSTArithmetic::Curved(last.longitude, velocity.longitude, prev_velocity.longitude, dt),
+                CoSTArithmetic::Curved(last.latitude, velocity.latitude, prev_velocity.latitude, dt), timestamp);
+        } else {
+            predictions[PREDICTOR_CP] = predictions[PREDICTOR_LDR];
+        }
+    }
+    
+    predictions[PREDICTOR_RT] = predictions[PREDICTOR_LDR];
+    if (num_predictors_ > PREDICTOR_RT && state.route_segment >= 0) {
+        predictions[PREDICTOR_RT] = route_templates_->Advance(route_id_, state.route_segment, state.route_offset, dt);
+        predictions[PREDICTOR_RT].timestamp = timestamp;
+    }
+}
+
+// Same state transitions as EncodeResidual, UpdateReconstructedState and AddPredictorToWindow
+void CoSTCompressor::ApplySearchStep(SearchState& state, const GpsPoint& point,
+                                     const SearchCandidate& candidate) const {
+    GpsPoint reconstructed = point;
+    if (hex_lattice_) {
+        reconstructed = candidate.prediction + HexLatticePoint(QuantizeHex(point - candidate.prediction, kQuantStep), kQuantStep);
+        reconstructed.timestamp = point.timestamp;
+    } else if (!lossless_) {
+        GpsPoint delta = point - candidate.prediction;
+        int64_t quantized_delta_lat = static_cast<int64_t>(std::round(delta.latitude / kQuantStep));
+        double lon_quant_step = LonQuantStep(candidate.prediction.latitude, quantized_delta_lat);
+        int64_t quantized_delta_lon = static_cast<int64_t>(std::round(delta.longitude / lon_quant_step));
+        reconstructed = candidate.prediction +
+                        GpsPoint(quantized_delta_lon * lon_quant_step, quantized_delta_lat * kQuantStep, 0);
+        reconstructed.timestamp = point.timestamp;
+    }
+    
+    GpsPoint velocity(0, 0, 0);
+    if (state.history_size > 0) {
+        const GpsPoint& prev_point = state.history[state.history_size - 1].reconstructed_point;
+        int64_t delta_time_signed = static_cast<int64_t>(reconstructed.timestamp) - static_cast<int64_t>(prev_point.timestamp);
+        if (delta_time_signed > 0) {
+            double dt = static_cast<double>(delta_time_signed);
+            velocity = GpsPoint((reconstructed.longitude - prev_point.longitude) / dt,
+                                (reconstructed.latitude - prev_point.latitude) / dt, 0);
+        }
+    }
+    if (state.history_size == kMaxHistorySize) {
+        for (int i = 1; i < kMaxHistorySize; ++i) state.history[i - 1] = state.history[i];
+        state.history_size--;
+    }
+    state.history[state.history_size++] = HistoryState(reconstructed, velocity);
+    state.reconstructed = reconstructed;
+    if (num_predictors_ > PREDICTOR_RT) {
+        route_templates_->Locate(route_id_, reconstructed, state.route_segment, state.route_offset);
+    }
+    
+    if (state.mode == MODE_MULTI_PREDICTOR) {
+        // The window is predictor_window_ followed by the path's own flags; a full one drops
+        // its oldest entry, which stays in predictor_window_ unless the path alone has added
+        // a whole window of flags (block searches), where the counts keep growing instead
+        int committed_flags = static_cast<int>(predictor_window_.size());
+        int window_size = std::min(committed_flags + state.pending_flags, kSlidingWindowSize);
+        int oldest = committed_flags + state.pending_flags - kSlidingWindowSize;
+        if (window_size == kSlidingWindowSize && oldest < committed_flags) {
+            state.predictor_frequency[predictor_window_[oldest]]--;
+            window_size--;
+        }
+        state.pending_flags++;
+        window_size++;
+        state.predictor_frequency[candidate.predictor]++;
+        
+        if (window_size % 100 == 0) {
+            // Ranks as in UpdateHuffmanCodes: higher frequency first, ties by predictor index
+            int order[kMaxPredictors];
+            for (int i = 0; i < num_predictors_; ++i) {
+                int j = i;
+                for (; j > 0 && state.predictor_frequency[i] > state.predictor_frequency[order[j - 1]]; --j) {
+                    order[j] = order[j - 1];
+                }
+                order[j] = i;
+            }
+            for (int rank = 0; rank < num_predictors_; ++rank) {
+                state.code_length[order[rank]] = static_cast<uint8_t>(rank + (rank < num_predictors_ - 1 ? 1 : 0));
+            }
+        }
+    }
+    
+    state.mode = candidate.mode;
+    state.last_evaluation_timestamp = candidate.last_evaluation_timestamp;
+    state.cost = candidate.cost;
+}
+
+void CoSTCompressor::ExpandSearch(const GpsPoint& point, int point_number) {
+    candidates_.clear();
+    for (int parent = 0; parent < static_cast<int>(beam_.size()); ++parent) {
+        const SearchState& state = beam_[parent];
+        GpsPoint predictions[kMaxPredictors];
+        PredictSearchState(state, point.timestamp, predictions);
+        uint64_t last_evaluation_timestamp = state.last_evaluation_timestamp;
+        bool evaluation = IsEvaluationPoint(point_number, point.timestamp, last_evaluation_timestamp);
+        
+        int predictors = state.mode == MODE_LDR_ONLY ? 1 : num_predictors_;
+        for (int p = 0; p < predictors; ++p) {
+            PredictorType predictor = static_cast<PredictorType>(p);
+            // A predictor that repeats an earlier prediction with no shorter flag adds nothing
+            bool repeated = false;
+            for (int q = 0; q < p && !repeated; ++q) {
+                repeated = predictions[q].longitude == predictions[p].longitude &&
+                           predictions[q].latitude == predictions[p].latitude &&
+                           state.code_length[q] <= state.code_length[p];
+            }
+            if (repeated) continue;
+            
+            int flag_bits = state.mode == MODE_LDR_ONLY ? 0 : state.code_length[p];
+            long long cost = state.cost + flag_bits + EstimateResidualCost(point, predictions[p]);
+            // Keeping the mode first makes it win ties
+            CompressionMode other = state.mode == MODE_LDR_ONLY ? MODE_MULTI_PREDICTOR : MODE_LDR_ONLY;
+            int order = static_cast<int>(candidates_.size());
+            candidates_.push_back({cost, order, parent, predictor, state.mode, last_evaluation_timestamp, predictions[p]});
+            if (evaluation && search_modes_) {
+                candidates_.push_back({cost, order + 1, parent, predictor, other, last_evaluation_timestamp,
+                                       predictions[p]});
+            }
+        }
+    }
+    
+    // Cheapest kSearchBeamWidth paths, ties in generation order
+    size_t width = std::min(candidates_.size(), static_cast<size_t>(kSearchBeamWidth));
+    std::partial_sort(candidates_.begin(), candidates_.begin() + width, candidates_.end(),
+                      [](const SearchCandidate& a, const SearchCandidate& b) {
+                          return a.cost != b.cost ? a.cost < b.cost : a.order < b.order;
+                      });
+    
+    next_beam_.resize(width);
+    for (size_t i = 0; i < width; ++i) {
+        const SearchCandidate& candidate = candidates_[i];
+        next_beam_[i] = beam_[candidate.parent];
+        ApplySearchStep(next_beam_[i], point, candidate);
+        choices_.push_back({candidate.parent, candidate.predictor, candidate.mode});
+    }
+    choices_.resize(choices_.size() + kSearchBeamWidth - width);
+    beam_.swap(next_beam_);
+}
+
+void CoSTCompressor::CommitSearchSteps(int count) {
+    // Trace the cheapest path back to the oldest pending point
+    int best = 0;
+    for (int i = 1; i < static_cast<int>(beam_.size()); ++i) {
+        if (beam_[i].cost < beam_[best].cost) best = i;
+    }
+    best_path_.resize(pending_count_);
+    int entry = best;
+    int committed_entry = best;
+    for (int step = pending_count_ - 1; step >= 0; --step) {
+        committed_entry = entry;
+        best_path_[step] = choices_[choices_head_ + step * kSearchBeamWidth + entry];
+        entry = best_path_[step].parent;
+    }
+    
+    // Keep the paths through the committed choice (all of them are when everything is committed)
+    if (count < pending_count_) {
+        size_t newest = choices_head_ + (pending_count_ - 1) * kSearchBeamWidth;
+        int kept = 0;
+        for (int i = 0; i < static_cast<int>(beam_.size()); ++i) {
+            int ancestor = i;
+            for (int step = pending_count_ - 1; step >= count; --step) {
+                ancestor = choices_[choices_head_ + step * kSearchBeamWidth + ancestor].parent;
+            }
+            if (ancestor != committed_entry) continue;
+            beam_[kept] = beam_[i];
+            choices_[newest + kept] = choices_[newest + i];
+            kept++;
+        }
+        beam_.resize(kept);
+    }
+    
+    CompressionMode mode = current_mode_;
+    int rate_step = rate_step_;
+    int precision_level = precision_level_;
+    int gap_escapes = stats_.gap_escapes;
+    long long predictor_flags = predictor_flags_;
+    int channels = static_cast<int>(attribute_codecs_.size());
+    for (int i = 0; i < count; ++i) {
+        const double* attributes = channels > 0 ? &pending_attributes_[(pending_head_ + i) * channels] : nullptr;
+        EncodePoint(pending_points_[pending_head_ + i], attributes, &best_path_[i]);
+    }
+    pending_head_ += count;
+    pending_count_ -= count;
+    choices_head_ += static_cast<size_t>(count) * kSearchBeamWidth;
+    
+    // The heuristic switched modes, rate control or the precision map moved epsilon, or a gap
+    // escape reset the history, under paths that assumed the old values
+    if (pending_count_ > 0 && ((current_mode_ != mode && !search_modes_) || rate_step_ != rate_step ||
+                               precision_level_ != precision_level || stats_.gap_escapes != gap_escapes)) {
+        RestartSearch();
+        return;
+    }
+    
+    // The committed flags moved from the paths into predictor_window_ (fewer than
+    // the paths assumed when stationary runs took some of the points)
+    int committed_flags = static_cast<int>(predictor_flags_ - predictor_flags);
+    for (SearchState& state : beam_) state.pending_flags = std::max(state.pending_flags - committed_flags, 0);
+    
+    if (pending_count_ == 0) {
+        beam_.clear();
+        choices_.clear();
+        choices_head_ = 0;
+        pending_points_.clear();
+        pending_attributes_.clear();
+        pending_head_ = 0;
+    } else if (pending_head_ > 1024 && pending_head_ > static_cast<size_t>(pending_count_)) {
+        // Drop the committed prefix from time to time
+        pending_points_.erase(pending_points_.begin(), pending_points_.begin() + pending_head_);
+        pending_attributes_.erase(pending_attributes_.begin(), pending_attributes_.begin() + pending_head_ * channels);
+        pending_head_ = 0;
+        choices_.erase(choices_.begin(), choices_.begin() + choices_head_);
+        choices_head_ = 0;
+    }
+}
+
+void CoSTCompressor::RestartSearch() {
+    // Search the pending points again from the encoder state
+    choices_.clear();
+    choices_head_ = 0;
+    beam_.resize(1);
+    SnapshotSearchState(beam_[0]);
+    for (int i = 0; i < pending_count_; ++i) {
+        ExpandSearch(pending_points_[pending_head_ + i], stats_.total_points + i + 1);
+    }
 }
 
 double CoSTCompressor::CalculateDistance(const GpsPoint& p1, const GpsPoint& p2) const {
@@ -570,7 +2212,7 @@ double CoSTCompressor::CalculateDistance(const GpsPoint& p1, const GpsPoint& p2)
 void CoSTCompressor::CompressionStats::PrintStats() const {
     std::cout << "\n=== TrajCompress-SP-Adaptive  ===" << std::endl;
     std::cout << ": " << total_points << std::endl;
-    std::cout << ": LDR=" << ldr_count << ", CP=" << cp_count << ", ZP=" << zp_count << std::endl;
+    std::cout << ": LDR=" << ldr_count << ", CP=" << cp_count << ", ZP=" << zp_count << ", RT=" << rt_count << std::endl;
     std::cout << ": " << mode_switch_count << std::endl;
     std::cout << "LDR-Only: " << ldr_only_mode_points << " (" 
               << (100.0 * ldr_only_mode_points / total_points) << "%)" << std::endl;
@@ -580,6 +2222,9 @@ void CoSTCompressor::CompressionStats::PrintStats() const {
     std::cout << "  : " << predictor_flag_bits << " bits" << std::endl;
     std::cout << "  : " << mode_switch_bits << " bits" << std::endl;
     std::cout << "  : " << quantized_data_bits << " bits" << std::endl;
+    if (attribute_bits > 0) {
+        std::cout << "  attributes: " << attribute_bits << " bits" << std::endl;
+    }
 }
 
 void CoSTCompressor::CompressionStats::PrintDetailedStats() const {
@@ -604,70 +2249,290 @@ void CoSTCompressor::CompressionStats::PrintDetailedStats() const {
 
 // ==================== ====================
 
-CoSTDecompressor::CoSTDecompressor(uint8_t* compressed_data, int data_size) {
-    input_bit_stream_ = std::make_unique<InputBitStream>(compressed_data, data_size);
+CoSTDecompressor::CoSTDecompressor(const uint8_t* compressed_data, int data_size,
+                                   const RouteTemplateLibrary* route_templates,
+                                   const StreamProfileTable* stream_profiles)
+    : route_templates_(route_templates), stream_profiles_(stream_profiles) {
+    input_bit_stream_ = std::make_unique<InputBitStream>(ArrayView<const uint8_t>(compressed_data, data_size));
     predictor_window_.reserve(kSlidingWindowSize);
     ReadHeader();
 }
 
 void CoSTDecompressor::ReadHeader() {
+    uint32_t features = 0;
     block_size_ = input_bit_stream_->ReadInt(16);
-    epsilon_ = Double::LongBitsToDouble(input_bit_stream_->ReadLong(64));
-    evaluation_window_ = input_bit_stream_->ReadInt(16);  // （）
-    
- // （）
-    use_time_window_ = input_bit_stream_->ReadBit();  // 1：
-    if (use_time_window_) {
-        time_window_seconds_ = input_bit_stream_->ReadInt(32);  // 32：（）
+    if (block_size_ == static_cast<int>(CoSTCompressor::kCompactHeaderMarker)) {
+        // Compact header: epsilon and the window settings come from the profile
+        int profile_id = input_bit_stream_->ReadInt(8);
+        if (stream_profiles_ == nullptr || !stream_profiles_->HasProfile(profile_id)) {
+            stream_valid_ = false;
+            return;
+        }
+        const StreamProfile& profile = stream_profiles_->GetProfile(profile_id);
+        compact_header_ = true;
+        profile_origin_ = profile.origin;
+        // Elias-gamma block size + 1, after any leading ones that pad a shorter
+        // point count (CoSTCompressor::WritePointCount); the 0 ending the padding
+        // is the first zero of the code
+        while (input_bit_stream_->ReadBit()) {}
+        int zeros = 1;
+        while (!input_bit_stream_->ReadBit()) {
+            if (++zeros > 31) {  // block_size is an int
+                block_size_ = 0;
+                stream_valid_ = false;
+                return;
+            }
+        }
+        block_size_ = static_cast<int>(((1ll << zeros) | input_bit_stream_->ReadLong(zeros)) - 1);
+        point_count_ = block_size_;
+        // As CoSTCompressor::Configure
+        epsilon_ = (profile.epsilon_in_meters ? profile.epsilon / CoSTCompressor::kMetersPerDegree : profile.epsilon) * 0.999;
+        evaluation_window_ = profile.evaluation_window;
+        use_time_window_ = profile.use_time_window;
+        time_window_seconds_ = use_time_window_ ? profile.time_window_seconds : 0;
+        if (input_bit_stream_->ReadBit()) {
+            features = input_bit_stream_->ReadInt(16);
+        }
     } else {
-        time_window_seconds_ = 0;
+        if (block_size_ != static_cast<int>(CoSTCompressor::kUncountedBlock)) point_count_ = block_size_;
+        epsilon_ = Double::LongBitsToDouble(input_bit_stream_->ReadLong(64));
+        uint32_t window_field = input_bit_stream_->ReadInt(16);  // （）
+        evaluation_window_ = window_field & ~CoSTCompressor::kHeaderExtensionFlag;
+        
+ // （）
+        use_time_window_ = input_bit_stream_->ReadBit();  // 1：
+        if (use_time_window_) {
+            time_window_seconds_ = input_bit_stream_->ReadInt(32);  // 32：（）
+        } else {
+            time_window_seconds_ = 0;
+        }
+        
+        if (window_field & CoSTCompressor::kHeaderExtensionFlag) {
+            features = input_bit_stream_->ReadInt(16);
+        }
     }
+    integer_grid_ = (features & CoSTCompressor::FEATURE_INTEGER_GRID) != 0;
+    compact_profile_ = (features & CoSTCompressor::FEATURE_COMPACT_PROFILE) != 0;
     
     quant_step_ = 2 * epsilon_;  // epsilon  0.999 
+    lossless_ = (epsilon_ == 0);
+    
+    if (features & CoSTCompressor::FEATURE_ROUTE_TEMPLATE) {
+        route_id_ = input_bit_stream_->ReadInt(16);
+        if (route_templates_ == nullptr || !route_templates_->HasTemplate(route_id_)) {
+            stream_valid_ = false;
+        }
+        num_predictors_ = CoSTCompressor::kMaxPredictors;
+    }
+    if (features & CoSTCompressor::FEATURE_LEVEL) {
+        level_ = input_bit_stream_->ReadInt(4);
+        // Level 1 streams stay in LDR-only form and carry no mode bits
+        if (level_ == CoSTCompressor::kMinLevel) current_mode_ = CompressionMode::MODE_LDR_ONLY;
+    }
+    if (features & CoSTCompressor::FEATURE_RATE_CONTROL) {
+        // The header epsilon is the bottom of the ladder
+        int steps = input_bit_stream_->ReadInt(6) + 1;
+        rate_control_ = true;
+        rate_epsilons_.clear();
+        double step_epsilon = epsilon_;
+        for (int i = 0; i < steps; ++i) {
+            rate_epsilons_.push_back(step_epsilon);
+            step_epsilon *= CoSTCompressor::kRateStepRatio;
+        }
+        rate_step_ = std::min(static_cast<int>(input_bit_stream_->ReadInt(6)), steps - 1);
+        quant_step_ = 2 * rate_epsilons_[rate_step_];
+    }
+    stationary_runs_ = (features & CoSTCompressor::FEATURE_STATIONARY_RUNS) != 0;
+    segment_mode_ = (features & CoSTCompressor::FEATURE_SEGMENTS) != 0;
+    gap_escapes_ = (features & CoSTCompressor::FEATURE_GAP_ESCAPES) != 0;
+    hex_lattice_ = (features & CoSTCompressor::FEATURE_HEX_LATTICE) != 0;
+    metric_bound_ = (features & CoSTCompressor::FEATURE_METRIC_BOUND) != 0;
+    if (features & CoSTCompressor::FEATURE_ADAPTIVE_RESIDUALS) {
+        residual_model_ = std::make_unique<ResidualClassModel>();
+    }
+    if (features & CoSTCompressor::FEATURE_ATTRIBUTES) {
+        int count = input_bit_stream_->ReadInt(4);
+        for (int i = 0; i < count; ++i) {
+            attribute_channels_.push_back(AttributeChannelCodec::ReadChannel(input_bit_stream_.get()));
+            attribute_codecs_.emplace_back(attribute_channels_.back());
+        }
+        attribute_scratch_.resize(count);
+    }
+    if (features & CoSTCompressor::FEATURE_PREDICTOR_PRIOR) {
+        int prior_id = input_bit_stream_->ReadInt(16);
+        if (stream_profiles_ == nullptr || !stream_profiles_->HasPrior(prior_id)) {
+            stream_valid_ = false;
+        } else {
+            prior_ = stream_profiles_->GetPrior(prior_id);
+        }
+    }
+    if (features & CoSTCompressor::FEATURE_PRECISION_MAP) {
+        precision_map_ = true;
+        precision_epsilons_.assign(1, epsilon_);
+        int count = input_bit_stream_->ReadInt(4);
+        for (int i = 0; i < count; ++i) {
+            precision_epsilons_.push_back(Double::LongBitsToDouble(input_bit_stream_->ReadLong(64)));
+        }
+        size_t level = input_bit_stream_->ReadInt(4);
+        if (level < precision_epsilons_.size()) {
+            quant_step_ = 2 * precision_epsilons_[level];
+        } else {
+            stream_valid_ = false;
+        }
+    }
+    if (features & CoSTCompressor::FEATURE_BLOCK_CLASSES) {
+        block_class_bits_ = input_bit_stream_->ReadInt(3);
+        if (block_class_bits_ > CoSTCompressor::kMaxBlockClassBits) {
+            block_class_bits_ = 0;
+            stream_valid_ = false;
+        }
+        for (int i = 0; i < 1 << block_class_bits_; ++i) {
+            block_class_widths_[i] = static_cast<uint8_t>(input_bit_stream_->ReadInt(CoSTCompressor::kBlockClassWidthBits));
+        }
+    }
     
  // Huffman
-    predictor_frequency_[PredictorType::PREDICTOR_LDR] = 60;
-    predictor_frequency_[PredictorType::PREDICTOR_CP] = 10;
-    predictor_frequency_[PredictorType::PREDICTOR_ZP] = 30;
+    for (int i = 0; i < num_predictors_; ++i) predictor_frequency_[i] = prior_.predictor_frequency[i];
+    if (compact_profile_) {
+        compact_flags_.Reset(prior_.predictor_frequency[PredictorType::PREDICTOR_LDR],
+                             prior_.predictor_frequency[PredictorType::PREDICTOR_CP],
+                             prior_.predictor_frequency[PredictorType::PREDICTOR_ZP]);
+    }
+    // As CoSTCompressor::ApplyPredictorPrior
+    if (level_ >= CoSTCompressor::kDefaultLevel &&
+        (prior_.initial_mode != CompressionMode::MODE_SEGMENT || segment_mode_)) {
+        current_mode_ = prior_.initial_mode;
+    }
     UpdateHuffmanDecoder();
 }
 
+CoSTCompressor::PredictorPrior CoSTDecompressor::GetPredictorPrior() const {
+    int counts[CoSTCompressor::kMaxPredictors] = {0, 0, 0, 0};
+    if (compact_profile_) {
+        for (int i = 0; i < CompactFlagModel::kPredictors; ++i) counts[i] = compact_flags_.frequency[i];
+    } else {
+        for (PredictorType predictor : predictor_window_) counts[predictor]++;
+    }
+    return CoSTCompressor::LearnPrior(counts, num_predictors_, current_mode_, prior_);
+}
+
 bool CoSTDecompressor::ReadNextPoint(GpsPoint& point) {
-    if (first_point_) {
-        first_point_ = false;
-        points_read_ = 1;  // 
-        
+    return ReadNextPoint(point, attribute_scratch_.data());
+}
+
+bool CoSTDecompressor::ReadFirstPoint(GpsPoint& point) {
+    if (!compact_header_) {
         // (comment removed)
-        double lon = Double::LongBitsToDouble(input_bit_stream_->ReadLong(64));
-        double lat = Double::LongBitsToDouble(input_bit_stream_->ReadLong(64));
+        uint64_t lon_bits = input_bit_stream_->ReadLong(64);
+        uint64_t lat_bits = input_bit_stream_->ReadLong(64);
         
  // timestamp
         uint64_t timestamp = input_bit_stream_->ReadLong(64);
         
-        point = GpsPoint(lon, lat, timestamp);
+        if (integer_grid_) {
+            GridPoint grid_point(static_cast<int64_t>(lon_bits), static_cast<int64_t>(lat_bits), timestamp);
+            grid_predictor_.Push(grid_point);
+            point = GpsPoint(grid_point.x * quant_step_, grid_point.y * quant_step_, timestamp);
+        } else {
+            point = GpsPoint(Double::LongBitsToDouble(lon_bits), Double::LongBitsToDouble(lat_bits), timestamp);
+        }
+        return true;
+    }
+    
+    // Against the profile origin, as CoSTCompressor::EncodeFirstPoint
+    try {
+        if (integer_grid_) {
+            double inverse_quant_step = 1.0 / quant_step_;
+            GridPoint grid_origin(std::llround(profile_origin_.longitude * inverse_quant_step),
+                                  std::llround(profile_origin_.latitude * inverse_quant_step), 0);
+            int64_t residual_x = ZigZagCodec::Decode(EliasGammaCodec::Decode(input_bit_stream_.get()) - 1);
+            int64_t residual_y = ZigZagCodec::Decode(EliasGammaCodec::Decode(input_bit_stream_.get()) - 1);
+            uint64_t timestamp = profile_origin_.timestamp +
+                ZigZagCodec::Decode(EliasGammaCodec::Decode(input_bit_stream_.get()) - 1);
+            GridPoint grid_point(grid_origin.x + residual_x, grid_origin.y + residual_y, timestamp);
+            grid_predictor_.Push(grid_point);
+            point = GpsPoint(grid_point.x * quant_step_, grid_point.y * quant_step_, timestamp);
+        } else {
+            point = DecodeResidual(profile_origin_);
+            point.timestamp = profile_origin_.timestamp +
+                ZigZagCodec::Decode(EliasGammaCodec::Decode(input_bit_stream_.get()) - 1);
+        }
+    } catch (...) {
+        return false;
+    }
+    return true;
+}
+
+bool CoSTDecompressor::ReadNextPoint(GpsPoint& point, double* attributes) {
+    if (!stream_valid_ || points_read_ >= point_count_) return false;
+    if (attributes == nullptr) attributes = attribute_scratch_.data();
+    
+    if (first_point_) {
+        first_point_ = false;
+        points_read_ = 1;  // 
+        
+        if (!ReadFirstPoint(point)) return false;
+        uint64_t timestamp = point.timestamp;
         
         current_reconstructed_point_ = point;
         history_states_.emplace_back(point, GpsPoint(0, 0, 0));
+        trip_starts_.push_back(0);
+        if (num_predictors_ > PredictorType::PREDICTOR_RT) {
+            route_templates_->Locate(route_id_, point, route_segment_, route_offset_);
+        }
         
  // （）
         if (use_time_window_) {
             last_evaluation_timestamp_ = timestamp;
         }
         
+        DecodeAttributes(attributes, timestamp);
         return true;
     }
     
  // （TrajSP）
+    if (run_next_ < run_timestamps_.size()) return NextRunPoint(point, attributes);
+    if (segment_next_ < segment_timestamps_.size()) return NextSegmentPoint(point, attributes);
+    if (current_mode_ == CompressionMode::MODE_SEGMENT) {
+        size_t count;
+        try {
+            count = static_cast<size_t>(EliasGammaCodec::Decode(input_bit_stream_.get()));
+        } catch (...) {
+            return false;
+        }
+        if (gap_escapes_ && count == static_cast<size_t>(CoSTCompressor::kGapSegmentCount)) {
+            try {
+                return ReadGapPoint(point, attributes, EliasGammaCodec::Decode(input_bit_stream_.get()));
+            } catch (...) {
+                return false;
+            }
+        }
+        if (!ReadSegmentToken(count)) return false;
+        return NextSegmentPoint(point, attributes);
+    }
     GpsPoint predicted_point;
     uint64_t current_timestamp;
     
     if (current_mode_ == CompressionMode::MODE_LDR_ONLY) {
  // LDR-Only：，timestamp
  // 1. timestamp delta (uint64_t，int64_t)
-        uint64_t timestamp_delta_bits = input_bit_stream_->ReadLong(64);
+        uint64_t timestamp_delta_bits;
+        if (!ReadTimestampWord(timestamp_delta_bits)) return false;
+        if (stationary_runs_ && timestamp_delta_bits == CoSTCompressor::kRunEscape) {
+            if (!ReadRunToken()) return false;
+            return NextRunPoint(point, attributes);
+        }
+        if (gap_escapes_ && CoSTCompressor::IsGapEscape(timestamp_delta_bits)) {
+            return ReadGapPoint(point, attributes, timestamp_delta_bits & ~CoSTCompressor::kEscapePrefixMask);
+        }
         int64_t timestamp_delta = static_cast<int64_t>(timestamp_delta_bits);
         current_timestamp = current_reconstructed_point_.timestamp + timestamp_delta;
         
+        if (integer_grid_) {
+            point = ReconstructGridPoint(PredictorType::PREDICTOR_LDR, current_timestamp);
+            return FinishPoint(current_timestamp, attributes);
+        }
+        
  // 2. timestampLDR
         GpsPoint pred_ldr, pred_cp, pred_zp;
         ParallelPredict(pred_ldr, pred_cp, pred_zp, current_timestamp);
@@ -677,12 +2542,26 @@ bool CoSTDecompressor::ReadNextPoint(GpsPoint& point) {
  // Multi-Predictor：Huffman，timestamp，（TrajSP）
  // 1. 
         PredictorType predictor = DecodeWithHuffman();
+        last_used_predictor_ = predictor;
         
  // 2. timestamp delta（Huffman，）(uint64_t，int64_t)
-        uint64_t timestamp_delta_bits = input_bit_stream_->ReadLong(64);
+        uint64_t timestamp_delta_bits;
+        if (!ReadTimestampWord(timestamp_delta_bits)) return false;
+        if (stationary_runs_ && timestamp_delta_bits == CoSTCompressor::kRunEscape) {
+            if (!ReadRunToken()) return false;
+            return NextRunPoint(point, attributes);
+        }
+        if (gap_escapes_ && CoSTCompressor::IsGapEscape(timestamp_delta_bits)) {
+            return ReadGapPoint(point, attributes, timestamp_delta_bits & ~CoSTCompressor::kEscapePrefixMask);
+        }
         int64_t timestamp_delta = static_cast<int64_t>(timestamp_delta_bits);
         current_timestamp = current_reconstructed_point_.timestamp + timestamp_delta;
         
+        if (integer_grid_) {
+            point = ReconstructGridPoint(predictor, current_timestamp);
+            return FinishPoint(current_timestamp, attributes);
+        }
+        
  // 3. timestamp
         GpsPoint pred_ldr, pred_cp, pred_zp;
         ParallelPredict(pred_ldr, pred_cp, pred_zp, current_timestamp);
@@ -691,64 +2570,249 @@ bool CoSTDecompressor::ReadNextPoint(GpsPoint& point) {
             case PredictorType::PREDICTOR_LDR: predicted_point = pred_ldr; break;
             case PredictorType::PREDICTOR_CP: predicted_point = pred_cp; break;
             case PredictorType::PREDICTOR_ZP: predicted_point = pred_zp; break;
+            case PredictorType::PREDICTOR_RT:
+                predicted_point = PredictRouteTemplate(pred_ldr, current_timestamp);
+                break;
         }
-        last_used_predictor_ = predictor;
     }
     
     // (comment removed)
     try {
-        uint64_t encoded_lon = EliasGammaCodec::Decode(input_bit_stream_.get());
-        uint64_t encoded_lat = EliasGammaCodec::Decode(input_bit_stream_.get());
-        
-        int64_t quantized_delta_lon = ZigZagCodec::Decode(encoded_lon - 1);
-        int64_t quantized_delta_lat = ZigZagCodec::Decode(encoded_lat - 1);
-    
-        // (comment removed)
-        GpsPoint reconstructed_delta(
-            quantized_delta_lon * quant_step_,
-            quantized_delta_lat * quant_step_
-        );
-        GpsPoint reconstructed_point = predicted_point + reconstructed_delta;
+        GpsPoint reconstructed_point = DecodeResidual(predicted_point);
         reconstructed_point.timestamp = current_timestamp;  // timestamp
         
         // (comment removed)
         UpdateHistory(reconstructed_point);
         current_reconstructed_point_ = reconstructed_point;
+        if (num_predictors_ > PredictorType::PREDICTOR_RT) {
+            route_templates_->Locate(route_id_, reconstructed_point, route_segment_, route_offset_);
+        }
         
         point = reconstructed_point;
-        points_read_++;  // 
         
     } catch (...) {
         // (comment removed)
         return false;
     }
     
- // ：
-    bool should_evaluate = false;
+    return FinishPoint(current_timestamp, attributes);
+}
+
+bool CoSTDecompressor::ReadTimestampWord(uint64_t& word) {
+    word = input_bit_stream_->ReadLong(64);
+    if (!precision_map_ || !CoSTCompressor::IsPrecisionEscape(word)) return true;
+    size_t level = (word & ~CoSTCompressor::kPrecisionEscapeMask) >> CoSTCompressor::kPrecisionLevelShift;
+    if (level >= precision_epsilons_.size()) return false;
+    quant_step_ = 2 * precision_epsilons_[level];
+    uint64_t timestamp_code = word & ((1ull << CoSTCompressor::kPrecisionLevelShift) - 1);
+    word = timestamp_code != 0 ? static_cast<uint64_t>(ZigZagCodec::Decode(timestamp_code - 1))
+                               : input_bit_stream_->ReadLong(64);
+    return true;
+}
+
+CoSTDecompressor::GpsPoint CoSTDecompressor::DecodeResidual(const GpsPoint& prediction) {
+    if (lossless_) {
+        uint64_t xor_lon = XorResidualCodec::Decode(input_bit_stream_.get());
+        uint64_t xor_lat = XorResidualCodec::Decode(input_bit_stream_.get());
+        return GpsPoint(Double::LongBitsToDouble(Double::DoubleToLongBits(prediction.longitude) ^ xor_lon),
+                        Double::LongBitsToDouble(Double::DoubleToLongBits(prediction.latitude) ^ xor_lat));
+    }
     
-    if (use_time_window_) {
-        // (comment removed)
-        uint64_t time_since_last_eval = current_timestamp - last_evaluation_timestamp_;
-        
- // （），
-        if (current_timestamp >= last_evaluation_timestamp_ && 
-            time_since_last_eval >= time_window_seconds_) {
-            should_evaluate = true;
-            last_evaluation_timestamp_ = current_timestamp;
-        }
+    uint64_t encoded_lon, encoded_lat;
+    if (residual_model_ != nullptr) {
+        residual_model_->Decode(input_bit_stream_.get(), encoded_lon, encoded_lat);
+    } else if (block_class_bits_ >= 0) {
+        encoded_lon = ReadBlockClassCode();
+        encoded_lat = ReadBlockClassCode();
     } else {
- // （）
-        if (points_read_ % evaluation_window_ == 0) {
-            should_evaluate = true;
+        encoded_lon = EliasGammaCodec::Decode(input_bit_stream_.get());
+        encoded_lat = EliasGammaCodec::Decode(input_bit_stream_.get());
+    }
+    if (hex_lattice_) {
+        CoSTCompressor::LatticeIndex index = {ZigZagCodec::Decode(encoded_lon - 1), ZigZagCodec::Decode(encoded_lat - 1)};
+        return prediction + CoSTCompressor::HexLatticePoint(index, quant_step_);
+    }
+    
+    int64_t quantized_delta_lon = ZigZagCodec::Decode(encoded_lon - 1);
+    int64_t quantized_delta_lat = ZigZagCodec::Decode(encoded_lat - 1);
+    double lon_quant_step = quant_step_;
+    if (metric_bound_) {
+        // As CoSTCompressor::LonQuantStep
+        lon_quant_step = quant_step_ * CoSTCompressor::MetricLonScale(
+            prediction.latitude + quantized_delta_lat * quant_step_, quant_step_);
+    }
+    
+    // (comment removed)
+    GpsPoint reconstructed_delta(
+        quantized_delta_lon * lon_quant_step,
+        quantized_delta_lat * quant_step_
+    );
+    return prediction + reconstructed_delta;
+}
+
+uint64_t CoSTDecompressor::ReadBlockClassCode() {
+    int index = block_class_bits_ > 0 ? input_bit_stream_->ReadInt(block_class_bits_) : 0;
+    int width = block_class_widths_[index];
+    return (width > 0 ? input_bit_stream_->ReadLong(width) : 0) + 1;
+}
+
+CoSTDecompressor::GpsPoint CoSTDecompressor::ReconstructGridPoint(PredictorType predictor,
+                                                                  uint64_t current_timestamp) {
+    GridPoint pred[3];
+    grid_predictor_.Predict(current_timestamp, pred[PredictorType::PREDICTOR_LDR],
+                            pred[PredictorType::PREDICTOR_CP], pred[PredictorType::PREDICTOR_ZP]);
+    const GridPoint& prediction = pred[predictor];
+    
+    int64_t residual_x = ZigZagCodec::Decode(EliasGammaCodec::Decode(input_bit_stream_.get()) - 1);
+    int64_t residual_y = ZigZagCodec::Decode(EliasGammaCodec::Decode(input_bit_stream_.get()) - 1);
+    GridPoint grid_point(prediction.x + residual_x, prediction.y + residual_y, current_timestamp);
+    grid_predictor_.Push(grid_point);
+    
+    current_reconstructed_point_ = GpsPoint(grid_point.x * quant_step_, grid_point.y * quant_step_,
+                                            current_timestamp);
+    return current_reconstructed_point_;
+}
+
+bool CoSTDecompressor::ReadRunToken() {
+    size_t count = static_cast<size_t>(EliasGammaCodec::Decode(input_bit_stream_.get())) + 1;
+    if (count > static_cast<size_t>(CoSTCompressor::kMaxRunLength)) return false;  // corrupt stream
+    run_timestamps_.resize(count);
+    run_next_ = 0;
+    uint64_t timestamp = current_reconstructed_point_.timestamp;
+    int64_t delta = 0;
+    for (size_t i = 0; i < count; ++i) {
+        delta += ZigZagCodec::Decode(EliasGammaCodec::Decode(input_bit_stream_.get()) - 1);
+        timestamp += delta;
+        run_timestamps_[i] = timestamp;
+    }
+    return true;
+}
+
+bool CoSTDecompressor::NextRunPoint(GpsPoint& point, double* attributes) {
+    uint64_t current_timestamp = run_timestamps_[run_next_++];
+    if (integer_grid_) {
+        GridPoint last = grid_predictor_.Last();
+        grid_predictor_.Push(GridPoint(last.x, last.y, current_timestamp));
+        current_reconstructed_point_ = GpsPoint(last.x * quant_step_, last.y * quant_step_, current_timestamp);
+    } else {
+        GpsPoint reconstructed_point(current_reconstructed_point_.longitude,
+                                     current_reconstructed_point_.latitude, current_timestamp);
+        UpdateHistory(reconstructed_point);
+        current_reconstructed_point_ = reconstructed_point;
+        if (num_predictors_ > PredictorType::PREDICTOR_RT) {
+            route_templates_->Locate(route_id_, reconstructed_point, route_segment_, route_offset_);
+        }
+    }
+    point = current_reconstructed_point_;
+    return FinishPoint(current_timestamp, attributes);
+}
+
+bool CoSTDecompressor::ReadSegmentToken(size_t count) {
+    try {
+        if (count == 0 || count > static_cast<size_t>(CoSTCompressor::kMaxSegmentLength)) return false;  // corrupt stream
+        segment_timestamps_.resize(count);
+        segment_next_ = 0;
+        uint64_t timestamp = current_reconstructed_point_.timestamp;
+        int64_t delta = 0;
+        for (size_t i = 0; i < count; ++i) {
+            delta += ZigZagCodec::Decode(EliasGammaCodec::Decode(input_bit_stream_.get()) - 1);
+            timestamp += delta;
+            segment_timestamps_[i] = timestamp;
+        }
+        GpsPoint pred_ldr, pred_cp, pred_zp;
+        ParallelPredict(pred_ldr, pred_cp, pred_zp, timestamp);
+        segment_start_ = current_reconstructed_point_;
+        segment_end_ = DecodeResidual(pred_ldr);
+        segment_end_.timestamp = timestamp;
+    } catch (...) {
+        segment_timestamps_.clear();
+        return false;
+    }
+    return true;
+}
+
+bool CoSTDecompressor::ReadGapPoint(GpsPoint& point, double* attributes, uint64_t timestamp_code) {
+    uint64_t current_timestamp;
+    try {
+        int64_t timestamp_delta = ZigZagCodec::Decode(timestamp_code - 1);
+        current_timestamp = current_reconstructed_point_.timestamp + timestamp_delta;
+        if (integer_grid_) {
+            GridPoint last = grid_predictor_.Last();
+            int64_t residual_x = ZigZagCodec::Decode(EliasGammaCodec::Decode(input_bit_stream_.get()) - 1);
+            int64_t residual_y = ZigZagCodec::Decode(EliasGammaCodec::Decode(input_bit_stream_.get()) - 1);
+            GridPoint grid_point(last.x + residual_x, last.y + residual_y, current_timestamp);
+            grid_predictor_.Reset();
+            grid_predictor_.Push(grid_point);
+            current_reconstructed_point_ = GpsPoint(grid_point.x * quant_step_, grid_point.y * quant_step_,
+                                                    current_timestamp);
+        } else {
+            GpsPoint reconstructed_point = DecodeResidual(current_reconstructed_point_);
+            reconstructed_point.timestamp = current_timestamp;
+            history_states_.clear();
+            UpdateHistory(reconstructed_point);
+            current_reconstructed_point_ = reconstructed_point;
+            if (num_predictors_ > PredictorType::PREDICTOR_RT) {
+                route_templates_->Locate(route_id_, reconstructed_point, route_segment_, route_offset_);
+            }
+        }
+    } catch (...) {
+        return false;
+    }
+    trip_starts_.push_back(points_read_);
+    point = current_reconstructed_point_;
+    return FinishPoint(current_timestamp, attributes);
+}
+
+bool CoSTDecompressor::NextSegmentPoint(GpsPoint& point, double* attributes) {
+    uint64_t current_timestamp = segment_timestamps_[segment_next_++];
+    GpsPoint reconstructed_point = segment_next_ == segment_timestamps_.size()
+        ? segment_end_
+        : CoSTCompressor::InterpolateSegment(segment_start_, segment_end_, current_timestamp);
+    UpdateHistory(reconstructed_point);
+    current_reconstructed_point_ = reconstructed_point;
+    if (num_predictors_ > PredictorType::PREDICTOR_RT) {
+        route_templates_->Locate(route_id_, reconstructed_point, route_segment_, route_offset_);
+    }
+    point = reconstructed_point;
+    return FinishPoint(current_timestamp, attributes);
+}
+
+void CoSTDecompressor::DecodeAttributes(double* attributes, uint64_t current_timestamp) {
+    for (size_t i = 0; i < attribute_codecs_.size(); ++i) {
+        attributes[i] = attribute_codecs_[i].Decode(current_timestamp, input_bit_stream_.get());
+    }
+}
+
+bool CoSTDecompressor::FinishPoint(uint64_t current_timestamp, double* attributes) {
+    DecodeAttributes(attributes, current_timestamp);
+    points_read_++;  // 
+    
+    // 0 = keep, 10 = finer, 11 = coarser
+    if (rate_control_ && points_read_ % evaluation_window_ == 0) {
+        try {
+            if (input_bit_stream_->ReadBit()) {
+                int step = rate_step_ + (input_bit_stream_->ReadBit() ? 1 : -1);
+                rate_step_ = std::max(0, std::min(step, static_cast<int>(rate_epsilons_.size()) - 1));
+                quant_step_ = 2 * rate_epsilons_[rate_step_];
+            }
+        } catch (...) {
+            return true;
         }
     }
+    if (level_ == CoSTCompressor::kMinLevel) return true;
+    
+ // ：
+    bool should_evaluate = CoSTArithmetic::IsEvaluationPoint(points_read_, current_timestamp, evaluation_window_,
+                                                             use_time_window_, time_window_seconds_,
+                                                             last_evaluation_timestamp_);
     
  // ，1
     if (should_evaluate) {
         try {
             bool mode_bit = input_bit_stream_->ReadBit();
-            // 0 = Multi-Predictor, 1 = LDR-Only
+            // 0 = Multi-Predictor, 1 = LDR-Only (segment mode: 10 = LDR-Only, 11 = Segment)
             current_mode_ = mode_bit ? CompressionMode::MODE_LDR_ONLY : CompressionMode::MODE_MULTI_PREDICTOR;
+            if (segment_mode_ && mode_bit && input_bit_stream_->ReadBit()) current_mode_ = CompressionMode::MODE_SEGMENT;
         } catch (...) {
  // （），（）
         }
@@ -758,17 +2822,18 @@ bool CoSTDecompressor::ReadNextPoint(GpsPoint& point) {
 }
 
 
+void CoSTDecompressor::SetPacket(ArrayView<const uint8_t> packet) {
+    input_bit_stream_->SetBuffer(packet);
+    point_count_ = INT_MAX;  // the header counted the first packet only
+}
+
 std::vector<CoSTDecompressor::GpsPoint> 
 CoSTDecompressor::ReadAllPoints() {
     std::vector<GpsPoint> points;
     GpsPoint point;
     
-    for (int i = 0; i < block_size_; ++i) {
-        if (ReadNextPoint(point)) {
-            points.push_back(point);
-        } else {
-            break;
-        }
+    while (ReadNextPoint(point)) {
+        points.push_back(point);
     }
     
     return points;
@@ -783,52 +2848,47 @@ void CoSTDecompressor::ParallelPredict(GpsPoint& pred_ldr, GpsPoint& pred_cp, Gp
         return;
     }
     
- // ，int64_ttimestampunderflow
-    int64_t delta_time_signed = static_cast<int64_t>(current_timestamp) - static_cast<int64_t>(current_reconstructed_point_.timestamp);
-    double dt = (delta_time_signed > 0) ? static_cast<double>(delta_time_signed) : 1.0;  // 1fallback
+    // As CoSTCompressor::ParallelPredict
+    double dt = CoSTArithmetic::TimeStep(current_timestamp, current_reconstructed_point_.timestamp);
+    const GpsPoint& last = current_reconstructed_point_;
     
- // ：（/）
-    GpsPoint velocity = history_states_[history_states_.size() - 1].velocity;
-    pred_ldr = GpsPoint(
-        current_reconstructed_point_.longitude + velocity.longitude * dt,
-        current_reconstructed_point_.latitude + velocity.latitude * dt,
-        current_timestamp
-    );
+    const GpsPoint& velocity = history_states_[history_states_.size() - 1].velocity;
+    pred_ldr = GpsPoint(CoSTArithmetic::Linear(last.longitude, velocity.longitude, dt),
+                        CoSTArithmetic::Linear(last.latitude, velocity.latitude, dt), current_timestamp);
     
- // ：（）
-    if (history_states_.size() >= 3 && dt > 0) {
-        GpsPoint velocity = history_states_[history_states_.size() - 1].velocity;
-        GpsPoint prev_velocity = history_states_[history_states_.size() - 2].velocity;
-        GpsPoint acceleration = velocity - prev_velocity;
-        
- // ：position + velocity*dt + 0.5*acceleration*dt^2
-        double dt_sq_half = dt * dt * 0.5;
-        pred_cp = GpsPoint(
-            current_reconstructed_point_.longitude + velocity.longitude * dt + acceleration.longitude * dt_sq_half,
-            current_reconstructed_point_.latitude + velocity.latitude * dt + acceleration.latitude * dt_sq_half,
-            current_timestamp
-        );
+    if (history_states_.size() >= 3) {
+        const GpsPoint& prev_velocity = history_states_[history_states_.size() - 2].velocity;
+        pred_cp = GpsPoint(CoSTArithmetic::Curved(last.longitude, velocity.longitude, prev_velocity.longitude, dt),
+                           CoSTArithmetic::Curved(last.latitude, velocity.latitude, prev_velocity.latitude, dt),
+                           current_timestamp);
     } else {
         pred_cp = pred_ldr;
     }
 }
 
+CoSTDecompressor::GpsPoint CoSTDecompressor::PredictRouteTemplate(const GpsPoint& pred_ldr,
+                                                                  uint64_t current_timestamp) const {
+    if (route_segment_ < 0) return pred_ldr;
+    
+    double dt = CoSTArithmetic::TimeStep(current_timestamp, current_reconstructed_point_.timestamp);
+    GpsPoint prediction = route_templates_->Advance(route_id_, route_segment_, route_offset_, dt);
+    prediction.timestamp = current_timestamp;
+    return prediction;
+}
+
 void CoSTDecompressor::UpdateHistory(const GpsPoint& reconstructed_point) {
     GpsPoint velocity(0, 0, 0);
     
     if (!history_states_.empty()) {
         const GpsPoint& prev_point = history_states_.back().reconstructed_point;
-        int64_t delta_time_signed = static_cast<int64_t>(reconstructed_point.timestamp) - static_cast<int64_t>(prev_point.timestamp);
-        
-        if (delta_time_signed > 0) {
  // （/）
-            double dt = static_cast<double>(delta_time_signed);
-            velocity = GpsPoint(
-                (reconstructed_point.longitude - prev_point.longitude) / dt,
-                (reconstructed_point.latitude - prev_point.latitude) / dt,
-                0
-            );
-        }
+        velocity = GpsPoint(
+            CoSTArithmetic::Velocity(reconstructed_point.longitude, prev_point.longitude,
+                                     reconstructed_point.timestamp, prev_point.timestamp),
+            CoSTArithmetic::Velocity(reconstructed_point.latitude, prev_point.latitude,
+                                     reconstructed_point.timestamp, prev_point.timestamp),
+            0
+        );
     }
     
     history_states_.emplace_back(reconstructed_point, velocity);
@@ -844,11 +2904,10 @@ void CoSTDecompressor::UpdateHuffmanDecoder() {
         int frequency;
     };
     
-    std::vector<PredictorFreq> freq_list = {
-        {PredictorType::PREDICTOR_LDR, predictor_frequency_[PredictorType::PREDICTOR_LDR]},
-        {PredictorType::PREDICTOR_CP, predictor_frequency_[PredictorType::PREDICTOR_CP]},
-        {PredictorType::PREDICTOR_ZP, predictor_frequency_[PredictorType::PREDICTOR_ZP]}
-    };
+    std::vector<PredictorFreq> freq_list;
+    for (int i = 0; i < num_predictors_; ++i) {
+        freq_list.push_back({static_cast<PredictorType>(i), predictor_frequency_[i]});
+    }
     
  // ：（）
     std::sort(freq_list.begin(), freq_list.end(), 
@@ -861,33 +2920,30 @@ void CoSTDecompressor::UpdateHuffmanDecoder() {
               });
     
     
-    huffman_decoder_map_[0] = freq_list[0].type;  // 0 -> 
-    huffman_decoder_map_[1] = freq_list[1].type;  // 10 -> 
-    huffman_decoder_map_[2] = freq_list[2].type;  // 11 -> 
+    for (int rank = 0; rank < num_predictors_; ++rank) {
+        huffman_decoder_map_[rank] = freq_list[rank].type;  // 0, 10, 110, ... -> rank
+    }
 }
 
-// Huffman（：0, 10, 11）
+// Huffman（：0, 10, 11; 0, 10, 110, 111 with RT）
 CoSTDecompressor::PredictorType 
 CoSTDecompressor::DecodeWithHuffman() {
-    bool first_bit = input_bit_stream_->ReadBit();
-    
-    PredictorType decoded_predictor;
-    
-    if (!first_bit) {
- // 0 -> (1 bit)
-        decoded_predictor = huffman_decoder_map_[0];
-    } else {
- // 1，
-        bool second_bit = input_bit_stream_->ReadBit();
-        
-        if (!second_bit) {
- // 10 -> (2 bits)
-            decoded_predictor = huffman_decoder_map_[1];
-        } else {
- // 11 -> (2 bits)
-            decoded_predictor = huffman_decoder_map_[2];
+    if (compact_profile_) {
+        int rank = 0;
+        while (rank < CompactFlagModel::kPredictors - 1 && input_bit_stream_->ReadBit()) {
+            rank++;
         }
+        int predictor = compact_flags_.by_rank[rank];
+        compact_flags_.Add(predictor);
+        return static_cast<PredictorType>(predictor);
+    }
+    
+    // Count leading ones; the last rank has no terminating zero
+    int rank = 0;
+    while (rank < num_predictors_ - 1 && input_bit_stream_->ReadBit()) {
+        rank++;
     }
+    PredictorType decoded_predictor = huffman_decoder_map_[rank];
     
  // （）
     AddPredictorToWindow(decoded_predictor);
@@ -3,17 +3,30 @@
 #include "utils/output_bit_stream.h"
 #include "utils/input_bit_stream.h"
 #include "utils/array.h"
+#include "algorithm/grid_predictor.h"
+#include "algorithm/attribute_channel_codec.h"
+#include "algorithm/compact_cost_encoder.h"
+#include "algorithm/residual_class_model.h"
+#include <climits>
 #include <vector>
 #include <memory>
 
+class RouteTemplateLibrary;
+class StreamProfileTable;
+class PrecisionMap;
+
 /**
  * CoST Compressor: Cost-aware Trajectory Compression
  * 
  * Key features:
- * 1. Cost-based predictor selection (LDR/CP/ZP)
+ * 1. Cost-based predictor selection (LDR/CP/ZP, plus RT with a route template library)
  * 2. Intelligent mode switching (Multi-Predictor / LDR-Only)
  * 3. Adaptive Huffman coding for predictor flags
  * 4. Error-bounded compression with user-specified threshold
+ * 5. Optional integer-grid core for bit-exact encoder/decoder agreement
+ * 6. Optional per-point attribute channels sharing the timestamp stream
+ * 7. Lossless mode for epsilon = 0 (XOR of the IEEE bits against the prediction;
+ *    encoder and decoder must be built with the same floating-point flags)
  */
 class CoSTCompressor {
 public:
@@ -44,13 +57,226 @@ public:
     enum PredictorType {
         PREDICTOR_LDR = 0,    // Linear Dead Reckoning - 
         PREDICTOR_CP = 1,     // Curve Predictor - （）
-        PREDICTOR_ZP = 2      // Zero Predictor - （Serf-QT）
+        PREDICTOR_ZP = 2,     // Zero Predictor - （Serf-QT）
+        PREDICTOR_RT = 3      // Route Template - advance along a prior trip of the same route
+    };
+    static constexpr int kMaxPredictors = 4;
+    static constexpr int kInitialRouteTemplateFrequency = 70;
+    
+    // Header extensions: the top bit of the 16-bit evaluation window field
+    // announces a 16-bit feature mask followed by per-feature fields
+    static constexpr uint32_t kHeaderExtensionFlag = 1u << 15;
+    static constexpr int kMaxEvaluationWindow = kHeaderExtensionFlag - 1;  // windows must fit below the flag
+    enum HeaderFeature {
+        FEATURE_ROUTE_TEMPLATE = 1 << 0,  // 16-bit route id
+        FEATURE_INTEGER_GRID = 1 << 1,    // first point as two int64 grid coordinates
+        FEATURE_ATTRIBUTES = 1 << 2,      // 4-bit channel count + channel table
+        FEATURE_COMPACT_PROFILE = 1 << 3, // CompactFlagModel predictor flags (CompactCoSTEncoder)
+        FEATURE_LEVEL = 1 << 4,           // 4-bit compression level (absent = kDefaultLevel)
+        FEATURE_RATE_CONTROL = 1 << 5,    // 6-bit epsilon ladder size - 1 + 6-bit starting step
+        FEATURE_STATIONARY_RUNS = 1 << 6, // run tokens (no header field)
+        FEATURE_SEGMENTS = 1 << 7,        // segment mode, mode codes 0 / 10 / 11 (no header field)
+        FEATURE_GAP_ESCAPES = 1 << 8,     // gap escapes (no header field)
+        FEATURE_PREDICTOR_PRIOR = 1 << 9, // 16-bit predictor prior id
+        FEATURE_HEX_LATTICE = 1 << 10,    // position residuals on the hexagonal lattice (no header field)
+        FEATURE_METRIC_BOUND = 1 << 11,   // longitude steps from the latitude (no header field)
+        FEATURE_PRECISION_MAP = 1 << 12,  // 4-bit epsilon count + the epsilons (× 0.999) + 4-bit starting level
+        FEATURE_ADAPTIVE_RESIDUALS = 1 << 13, // residual classes in ResidualClassModel codes (no header field)
+        FEATURE_BLOCK_CLASSES = 1 << 14       // 3-bit class index width z + 2^z 6-bit payload widths
+    };
+    static constexpr int kMaxAttributes = 15;
+    // A block size field of 0 starts the compact header (SetStreamProfile): 8-bit
+    // profile id, Elias-gamma block size + 1 (a shorter point count from Close()
+    // after leading ones), a bit announcing the feature mask, the feature fields,
+    // then the first point against the profile origin
+    static constexpr uint32_t kCompactHeaderMarker = 0;
+    // Close() overwrites the block size field of a stream shorter than its block
+    // with the point count, so the decoder stops after the last point. The 16-bit
+    // field saturates here: a full header with this value does not bound the count
+    static constexpr uint32_t kUncountedBlock = 0xFFFF;
+    static constexpr int kMaxHeaderBytes = 416;  // header with full attribute, precision and class tables and extensions
+    
+    // Options::level presets, from fastest to smallest output
+    static constexpr int kMinLevel = 1;
+    static constexpr int kDefaultLevel = 3;
+    static constexpr int kMaxLevel = 5;
+    static constexpr int kFastSearchLookahead = 16;  // lookahead of level 4
+    
+    // Rate control: epsilon ladder from the header epsilon in steps of √2 (about
+    // one bit per point each); every kEvaluationWindow points, ahead of any mode
+    // bit, the stream carries 0 (keep), 10 (finer) or 11 (coarser)
+    static constexpr double kRateStepRatio = 1.4142135623730951;
+    static constexpr int kMaxRateSteps = 64;
+    static constexpr double kDefaultRateRange = 16;  // epsilon_max / epsilon_min when unset
+    
+    // Stationary runs: a 64-bit timestamp delta of kRunEscape (after the ZP flag in
+    // multi-predictor mode) starts a token for K >= 2 points at the previous
+    // position: Elias-gamma K - 1, then the second differences of the timestamps
+    // (ZigZag + Elias-gamma). Attributes and mode bits of the K points follow as usual
+    static constexpr uint64_t kRunEscape = 1ull << 63;
+    static constexpr int kMaxRunLength = 4096;             // points buffered before a token is forced
+    static constexpr int64_t kMaxRunTimestampDelta = 1ll << 30;
+    
+    // Segment mode: a token for K points on one line in space-time from the
+    // previous reconstruction: Elias-gamma K, the second differences of the K
+    // timestamps (ZigZag + Elias-gamma, as in a run token), then the end point as
+    // a residual against its LDR prediction. The points in between are
+    // interpolated in time (InterpolateSegment) and stay within epsilon
+    static constexpr int kMaxSegmentLength = 256;
+    static constexpr int64_t kMaxSegmentTimestampDelta = 1ll << 30;
+    static constexpr int kTimestampWordBits = 64;  // timestamp delta of a point in the other modes
+    
+    // Gap escapes: a 64-bit timestamp word with the top bits 10 and nonzero low
+    // bits (a delta below -2^62, never a real one) starts a new trip. Its low 62
+    // bits hold ZigZag(timestamp delta) + 1; the position follows as a residual
+    // against the previous one, and the predictor history restarts there. In
+    // segment mode the escape is a segment count of kGapSegmentCount followed by
+    // the timestamp delta in ZigZag + Elias-gamma
+    static constexpr uint64_t kEscapePrefixMask = 3ull << 62;
+    static constexpr int64_t kMaxGapTimestampDelta = (1ll << 60) - 1;
+    static constexpr int kGapSegmentCount = kMaxSegmentLength + 1;
+    static constexpr int kJumpBits = 64;  // LDR residual bits over a ZP residual that make a jump
+    static bool IsGapEscape(uint64_t word) { return (word & kEscapePrefixMask) == kRunEscape && word != kRunEscape; }
+    
+    // Precision switches (SetPrecisionMap): the timestamp word of a point with the
+    // top bits 101 (a gap escape code above kMaxGapTimestampDelta, never a real
+    // one), the level in the next 4 bits and ZigZag(timestamp delta) + 1 in the low
+    // 57, or 0 and the timestamp word after it. Epsilon moves to that entry of the
+    // header table (0 = the header epsilon) from this point on
+    static constexpr uint64_t kPrecisionEscape = kRunEscape | (1ull << 61);
+    static constexpr uint64_t kPrecisionEscapeMask = 7ull << 61;
+    static constexpr int kPrecisionLevelShift = 57;
+    static bool IsPrecisionEscape(uint64_t word) { return (word & kPrecisionEscapeMask) == kPrecisionEscape; }
+    
+    // Hexagonal (A2) lattice for position residuals (Options::hex_lattice): rows
+    // 1.5ε apart, points √3ε apart along a row, odd rows shifted by half a step,
+    // so every point is within ε (Euclidean) of a lattice point. A residual is
+    // the column and the row of the nearest lattice point, each in ZigZag + Elias-gamma
+    static constexpr double kHexStepRatio = 0.8660254037844386;  // √3/2: lattice step per quantization step 2ε
+    struct LatticeIndex {
+        int64_t column;
+        int64_t row;
+    };
+    static LatticeIndex QuantizeHex(const GpsPoint& delta, double quant_step);
+    static GpsPoint HexLatticePoint(const LatticeIndex& index, double quant_step);  // shared with CoSTDecompressor
+    
+    // Metric bound (Options::epsilon_in_meters): epsilon in meters is a latitude
+    // epsilon of epsilon / kMetersPerDegree, and each longitude residual gets
+    // that step divided by the cosine of its latitude (local equirectangular
+    // projection). The latitude residual is reconstructed first; the scale comes
+    // from a table of 1/kMetricBandsPerDegree degree bands, taken at the band edge
+    // nearest the equator and rounded down to kMetricScaleFractionBits
+    static constexpr double kMetersPerDegree = 111693.98;  // WGS84 upper bound (meridian degree at the poles)
+    static constexpr int kMetricBandsPerDegree = 16;
+    static constexpr int kMetricScaleFractionBits = 16;
+    static double MetricLonScale(double latitude, double quant_step);  // shared with CoSTDecompressor
+    
+    // Block residual classes (Options::block_residual_classes): the header holds
+    // 2^z payload widths that PostOfficeSolver picks for the payload lengths of
+    // the block. A residual is the z-bit index of the narrowest class that holds
+    // ZigZag(residual), then ZigZag(residual) in the width of that class. Blocks
+    // that the classes would not make smaller stay in Elias-gamma
+    static constexpr int kMaxBlockClassBits = 5;
+    static constexpr int kBlockClassWidthBits = 6;
+    static constexpr int kMaxPayloadBits = 63;  // ZigZag residuals below 2^63
+    static int PayloadBits(uint64_t payload) { return payload == 0 ? 0 : 64 - __builtin_clzll(payload); }
+    
+    // Options::lookahead value that defers every decision to Close()
+    static constexpr int kLookaheadBlock = -1;
+    static constexpr int kSearchBeamWidth = 8;
+    
+    /**
+     * Encoder options (the decoder reads everything it needs from the header)
+     */
+    struct Options {
+        int evaluation_window = 96;
+        bool use_time_window = false;
+        uint64_t time_window_seconds = 60;
+        // Map coordinates once to an int64 grid of step 2ε and run prediction,
+        // residuals and reconstruction in integers (not combinable with RT)
+        bool integer_grid = false;
+        // Extra per-point channels, coded after the position of each point
+        std::vector<AttributeChannel> attributes;
+        // Predictor and mode search (the decoder is the same for all settings):
+        //   0               greedy choice per point
+        //   N > 0           beam search, each point is encoded N points later
+        //   kLookaheadBlock beam search over the whole block, encoded in Close()
+        // The search picks the mode too once it sees a whole evaluation window
+        // (N >= evaluation_window or block); shorter lookaheads keep the
+        // cost-window heuristic. The beam keeps kSearchBeamWidth paths, so even
+        // the block search is a heuristic, not the minimum over all choices.
+        // Not available on the integer grid or with adaptive_residuals
+        int lookahead = 0;
+        // Speed/ratio preset, recorded in the header (a nonzero lookahead overrides
+        // the one of the level):
+        //   1  LDR only: no predictor flags, mode bits or cost windows
+        //   2  greedy predictor choice with decayed-frequency flags (compact
+        //      profile, no 1000-symbol window), no mode switching or cost windows
+        //   3  greedy predictor choice, cost-window mode switching (default)
+        //   4  lookahead kFastSearchLookahead
+        //   5  lookahead evaluation_window (searched mode bits)
+        // Levels 1 and 2 take no route templates or lookahead; levels 4 and 5
+        // fall back to level 3 on the integer grid
+        int level = kDefaultLevel;
+        // Rate control (off while both targets are 0): epsilon starts at the
+        // constructor value and moves along the ladder within
+        // [epsilon_min, epsilon_max] to keep the stream at the target size.
+        // Not available on the integer grid or in lossless mode
+        double target_bits_per_point = 0;
+        double target_bytes_per_minute = 0;
+        double epsilon_min = 0;  // 0 = the constructor epsilon
+        double epsilon_max = 0;  // 0 = kDefaultRateRange × epsilon_min
+        // Code runs of points that stay within epsilon of the previous position
+        // (zero ZP residual) as one token. Points of a run are held back until
+        // it ends (or TakePacket/Close), so per-point packets never form runs
+        bool stationary_runs = false;
+        // Third mode next to multi-predictor and LDR-only, picked by the same cost
+        // windows: runs of points that one line in space-time covers within
+        // epsilon are coded as a segment token (Sim-Piece cones, in 2D). Needs
+        // level 3 without lookahead; not available on the integer grid or lossless
+        bool segment_mode = false;
+        // Start a new trip (escape token, predictor history reset) after a gap of
+        // more than gap_seconds, or on a jump the LDR prediction misses by more
+        // than an escape costs. 0 = off
+        uint32_t gap_seconds = 0;
+        // Quantize position residuals on a hexagonal lattice whose covering radius
+        // is epsilon: the Euclidean error in the lon/lat plane stays within epsilon,
+        // where the per-axis grid allows √2·epsilon. Not available on the integer
+        // grid, lossless or with segment mode
+        bool hex_lattice = false;
+        // Epsilon, epsilon_min and epsilon_max in meters: the east and north
+        // errors stay within epsilon meters at any latitude (the distance within
+        // √2·epsilon). Not available on the integer grid, lossless or with the
+        // hexagonal lattice
+        bool epsilon_in_meters = false;
+        // Code the magnitude class of each position residual with adaptive codes
+        // conditioned on the previous residuals and, for latitude, on the
+        // longitude residual of the same point (ResidualClassModel) instead of
+        // the fixed Elias-gamma prefix. Not available on the integer grid, lossless,
+        // with lookahead or at levels 4 and 5
+        bool adaptive_residuals = false;
+        // Archival blocks: hold the points until Close(), then code the residuals
+        // with classes fitted to the whole block (a class index and a fixed-width
+        // payload, see kMaxBlockClassBits) if that is smaller than Elias-gamma.
+        // Encodes the block up to twice, and no packets can be taken. Not
+        // available on the integer grid, lossless or with adaptive residuals
+        bool block_residual_classes = false;
     };
     
     // (comment removed)
     enum CompressionMode {
         MODE_MULTI_PREDICTOR = 0,  // （）
-        MODE_LDR_ONLY = 1          // 
+        MODE_LDR_ONLY = 1,         // 
+        MODE_SEGMENT = 2           // segment tokens (Options::segment_mode)
+    };
+    
+    // Warm start of a stream (SetPredictorPrior): the predictor flag pseudo-counts
+    // and the mode before the first evaluation point, learned from a fleet or from
+    // earlier trips of a vehicle (GetPredictorPrior)
+    static constexpr int kMaxPriorFrequency = 100;
+    struct PredictorPrior {
+        int predictor_frequency[kMaxPredictors] = {60, 10, 30, kInitialRouteTemplateFrequency};  // LDR, CP, ZP, RT
+        CompressionMode initial_mode = MODE_MULTI_PREDICTOR;  // levels 3-5; segment mode needs Options::segment_mode
     };
     
     // (comment removed)
@@ -71,9 +297,16 @@ public:
         int ldr_count = 0;
         int cp_count = 0;
         int zp_count = 0;
+        int rt_count = 0;
+        int stationary_points = 0;  // points coded in stationary run tokens
+        int segment_count = 0;      // segment tokens
+        int segment_points = 0;     // points coded in segment tokens
+        int gap_escapes = 0;        // trips started by a gap escape
+        int precision_switches = 0; // precision map level changes
         
         // (comment removed)
         int mode_switch_count = 0;
+        int epsilon_change_count = 0;
         int ldr_only_mode_points = 0;
         int multi_predictor_mode_points = 0;
         
@@ -83,6 +316,7 @@ public:
         int mode_switch_bits = 0;
         int quantized_data_bits = 0;
         int timestamp_bits = 0;  // timestamp（spatial）
+        int attribute_bits = 0;
         
         // (comment removed)
         double total_prediction_error = 0;
@@ -96,7 +330,7 @@ public:
     /**
      * 
      * @param block_size （）
-     * @param epsilon （），0.999，Serf-QT
+     * @param epsilon （），0.999，Serf-QT; 0 = lossless
      * @param evaluation_window （，，96）
      * @param use_time_window （，false）
      * @param time_window_seconds （，use_time_window=true，60）
@@ -106,14 +340,79 @@ public:
                                           bool use_time_window = false,
                                           uint64_t time_window_seconds = 60);
     
+    CoSTCompressor(int block_size, double epsilon, const Options& options);
+    
+    /**
+     * Start a new stream with the same parameters (and route template library),
+     * keeping the allocated output buffer, history and predictor window
+     */
+    void Reset();
+    
+    /**
+     * Start a new stream with new parameters; the output buffer is reallocated
+     * only if the new block needs more room. The first overload keeps the
+     * current options
+     */
+    void Reset(int block_size, double epsilon);
+    void Reset(int block_size, double epsilon, const Options& options);
+    
+    /**
+     * Enable the route-template predictor (must be called before the first point)
+     * @param library templates of prior reconstructed trips; the decoder needs the same library
+     * @param route_id template to use, or kAutoSelectRoute to pick the template
+     *        closest to the first point
+     */
+    static constexpr int kAutoSelectRoute = -1;
+    void SetRouteTemplateLibrary(const RouteTemplateLibrary* library, int route_id = kAutoSelectRoute);
+    
+    /**
+     * Write the compact header of a stream profile (must be called before the first point)
+     * @param profiles profile table; the decoder needs the same table, nullptr
+     *        restores the full header
+     * @param profile_id profile whose epsilon and window settings match this compressor
+     */
+    void SetStreamProfile(const StreamProfileTable* profiles, int profile_id);
+    
+    /**
+     * Start the stream from a shared prior instead of the built-in one (must be
+     * called before the first point)
+     * @param models table holding the prior; the decoder needs the same table,
+     *        nullptr restores the built-in prior
+     * @param prior_id prior to use, recorded in the header
+     */
+    void SetPredictorPrior(const StreamProfileTable* models, int prior_id);
+    
+    /**
+     * Take epsilon from a precision map (must be called before the first point):
+     * each point is coded with the epsilon of its cell, the compressor epsilon
+     * off the map. Not available on the integer grid, lossless, with rate
+     * control or segment mode
+     * @param map only the encoder needs it; must outlive the stream, nullptr turns it off
+     */
+    void SetPrecisionMap(const PrecisionMap* map);
+    
+    /**
+     * Prior learned from this stream: predictor flag frequencies scaled to
+     * kMaxPriorFrequency and the current mode. CoSTDecompressor::GetPredictorPrior
+     * returns the same prior once it has read the stream
+     */
+    PredictorPrior GetPredictorPrior() const;
+    
     /**
      * GPS
      * @param point GPS
      */
     void AddGpsPoint(const GpsPoint& point);
     
+    /**
+     * Add a GPS point with its attribute values
+     * @param attributes one value per configured attribute channel, in Options order
+     */
+    void AddGpsPoint(const GpsPoint& point, const double* attributes);
+    
     /**
      * ，
+     * A stream with fewer points than block_size records its point count in the header
      */
     void Close();
     
@@ -122,8 +421,30 @@ public:
      */
     Array<uint8_t> GetCompressedData();
     
+    /**
+     * The compressed stream in place, without a copy (after Close());
+     * valid until the next Reset() or AddGpsPoint()
+     */
+    ArrayView<const uint8_t> GetCompressedView() const;
+    
+    /**
+     * Copy the compressed stream into a caller-owned buffer (after Close())
+     * @return number of bytes written
+     */
+    int GetCompressedData(uint8_t* out, int capacity) const;
+    
+    /**
+     * Byte-aligned payload of everything encoded since the previous packet
+     * (packet mode, see NetCoSTCompressor); the stream continues in the next packet.
+     * Points still pending in the lookahead search are encoded first.
+     * Not available with Options::block_residual_classes
+     */
+    Array<uint8_t> TakePacket();
+    
     /**
      * （）
+     * With Options::lookahead, points still waiting for the search are not counted;
+     * with Options::block_residual_classes, nothing is counted before Close()
      */
     int GetCompressedSizeInBits() const { return compressed_size_in_bits_; }
     
@@ -131,22 +452,121 @@ public:
      * 
      */
     const CompressionStats& GetStats() const { return stats_; }
+    
+    // Current error bound (changes under rate control and with a precision map);
+    // latitude degrees with the metric bound
+    double GetEpsilon() const { return kEpsilon / 0.999; }
+    
+    int GetAttributeCount() const { return static_cast<int>(attribute_codecs_.size()); }
+    const AttributeChannel& GetAttributeChannel(int index) const { return attribute_codecs_[index].channel(); }
+    
+    // Index of the first point of each trip (0, then every gap escape)
+    const std::vector<int>& GetTripStarts() const { return trip_starts_; }
+    
+    // Position of a segment point at timestamp (start.timestamp < timestamp <= end.timestamp);
+    // shared with CoSTDecompressor so both sides round alike
+    static GpsPoint InterpolateSegment(const GpsPoint& start, const GpsPoint& end, uint64_t timestamp);
+    
+    // Prior from predictor counts (num_predictors of them) and a mode; counts of
+    // predictors not in use, or all of them if none were coded, come from base
+    static PredictorPrior LearnPrior(const int* counts, int num_predictors, CompressionMode mode,
+                                     const PredictorPrior& base);
 
 private:
-    // (comment removed)
-    const int kBlockSize;
-    const double kEpsilon;          // （0.999）
-    const double kQuantStep;        //  = 2 * epsilon * 0.999
+    // Stream parameters (fixed between Reset calls)
+    Options options_;  // as passed to the constructor or the last Reset
+    int kBlockSize;
+    double kEpsilon;          // （0.999）
+    double kQuantStep;        //  = 2 * epsilon * 0.999
+    bool metric_bound_ = false;
     
  // ：（）
-    const int kEvaluationWindow;                        // （，use_time_window_=false）
-    const bool use_time_window_;                        // 
-    const uint64_t kTimeWindowSeconds;                  // （，use_time_window_=true）
+    int kEvaluationWindow;                        // （，use_time_window_=false）
+    bool use_time_window_;                        // 
+    uint64_t kTimeWindowSeconds;                  // （，use_time_window_=true）
+    bool integer_grid_;
+    bool lossless_;                               // epsilon == 0
+    int level_;
+    double kInverseQuantStep;                     // grid mapping without a division
     static constexpr bool kClearWindowAfterSwitch = false;  // 
     
+    // Rate control
+    bool rate_control_ = false;
+    double rate_target_bits_per_point_ = 0;
+    double rate_target_bits_per_second_ = 0;
+    std::vector<double> rate_epsilons_;  // ladder of header-scaled epsilons (× 0.999)
+    int rate_start_step_ = 0;
+    int rate_step_ = 0;
+    double rate_bank_ = 0;               // budget bits saved (> 0) or overspent (< 0)
+    int rate_window_start_bits_ = 0;
+    int rate_window_start_point_ = 0;
+    uint64_t rate_window_start_timestamp_ = 0;
+    
+    // Stationary run being collected (positions are the current reconstruction)
+    bool stationary_runs_ = false;
+    std::vector<GpsPoint> run_points_;
+    std::vector<double> run_attributes_;  // one row of channel values per run point
+    
+    // Precision map (SetPrecisionMap)
+    const PrecisionMap* precision_map_ = nullptr;
+    std::vector<double> precision_epsilons_;  // level -> header-scaled epsilon (× 0.999)
+    int precision_level_ = 0;
+    bool precision_switch_pending_ = false;   // the next timestamp word carries a switch
+    
+    // Residual class model (Options::adaptive_residuals), null when off
+    std::unique_ptr<ResidualClassModel> residual_model_;
+    
+    // Block residual classes
+    bool block_classes_ = false;
+    bool block_replay_ = false;             // Close() is encoding the held points
+    std::vector<GpsPoint> block_points_;
+    std::vector<double> block_attributes_;  // one row of channel values per held point
+    int block_payload_lengths_[kMaxPayloadBits + 2];  // first pass: residuals per payload length (0-64)
+    int64_t block_gamma_bits_ = 0;          // first pass: Elias-gamma bits of the residuals
+    int block_class_bits_ = -1;             // z; -1 in the first pass, which codes Elias-gamma
+    uint8_t block_class_widths_[1 << kMaxBlockClassBits];
+    uint8_t block_class_of_length_[kMaxPayloadBits + 1];
+    
+    // Gap escapes
+    int64_t gap_seconds_ = 0;  // 0 = off
+    bool hex_lattice_ = false;
+    std::vector<int> trip_starts_;
+    
+    // Slopes (degrees per second, per axis) from an anchor that keep every added
+    // point within epsilon, as in Sim-Piece
+    struct SegmentCone {
+        GpsPoint anchor;
+        uint64_t last_timestamp = 0;
+        double slope_min[2];
+        double slope_max[2];
+        int count = 0;
+        
+        void Reset(const GpsPoint& start);
+        bool Add(const GpsPoint& point, double lon_epsilon, double lat_epsilon);  // false (cone unchanged) if no slope fits
+    };
+    struct SegmentEnd {
+        bool valid;
+        int64_t k[2];  // end point residual in quantization steps
+    };
+    
+    // Segment being collected (segment mode) and the segment cost estimate of the other modes
+    bool segment_mode_ = false;
+    SegmentCone segment_cone_;
+    bool segment_open_ = false;           // later points may still extend the segment
+    std::vector<GpsPoint> segment_points_;
+    std::vector<double> segment_attributes_;
+    std::vector<SegmentEnd> segment_ends_;  // possible end of a segment ending at each point
+    SegmentCone estimate_cone_;
+    GpsPoint estimate_velocity_;
+    int estimate_end_cost_ = 0;
+    int estimate_timestamp_bits_ = 0;
+    int64_t estimate_timestamp_delta_ = 0;
+    
     // (comment removed)
     std::unique_ptr<OutputBitStream> output_bit_stream_;
+    uint32_t output_capacity_ = 0;  // bytes allocated for output_bit_stream_
     int compressed_size_in_bits_ = 0;
+    int packet_start_bits_ = 0;  // compressed_size_in_bits_ at the start of the current packet
     bool first_point_ = true;
     
     // (comment removed)
@@ -160,13 +580,35 @@ private:
     std::vector<HistoryState> history_states_;
     static constexpr int kMaxHistorySize = 3;
     
+    // Route template predictor state (position of the reconstructed point on the template)
+    const RouteTemplateLibrary* route_templates_ = nullptr;
+    int route_id_ = kAutoSelectRoute;
+    int requested_route_id_ = kAutoSelectRoute;  // as passed to SetRouteTemplateLibrary
+    
+    // Compact header (SetStreamProfile)
+    const StreamProfileTable* stream_profiles_ = nullptr;
+    int stream_profile_id_ = 0;
+    
+    // Predictor prior (SetPredictorPrior)
+    int prior_id_ = -1;  // -1 = built-in prior
+    PredictorPrior prior_;
+    int route_segment_ = -1;
+    double route_offset_ = 0;
+    
+    // Integer-grid state (integer_grid_ only)
+    GridPredictor grid_predictor_;
+    
+    std::vector<AttributeChannelCodec> attribute_codecs_;
+    
     // (comment removed)
     CompressionStats stats_;
     
  // Huffman （）
     static constexpr int kSlidingWindowSize = 1000;
     std::vector<PredictorType> predictor_window_;
-    int predictor_frequency_[3] = {0, 0, 0};  // [LDR, CP, ZP]
+    long long predictor_flags_ = 0;  // flags ever added to the window (SearchState::pending_flags)
+    int num_predictors_ = 3;
+    int predictor_frequency_[kMaxPredictors] = {0, 0, 0, 0};  // [LDR, CP, ZP, RT]
     
     struct HuffmanCode {
         std::vector<bool> bits;
@@ -174,7 +616,8 @@ private:
         HuffmanCode() : length(0) {}
         HuffmanCode(const std::vector<bool>& b) : bits(b), length(b.size()) {}
     };
-    HuffmanCode huffman_codes_[3];
+    HuffmanCode huffman_codes_[kMaxPredictors];
+    CompactFlagModel compact_flags_;  // level 2 flags (compact profile) instead of the window
     
  // ：
     static constexpr int kSwitchCost = 4;   // （）
@@ -239,12 +682,99 @@ private:
     RingBuffer<CostRecord, kMaxCostWindowSize> point_costs_ldr_only_;    // LDR-Only
     long long window_total_cost_multi_ = 0;          // 
     long long window_total_cost_ldr_only_ = 0;       // LDR-Only
+    RingBuffer<CostRecord, kMaxCostWindowSize> point_costs_segment_;  // filled when segments close
+    long long window_total_cost_segment_ = 0;
     
     // (comment removed)
     uint64_t last_evaluation_timestamp_ = 0;         // 
     
+    // Predictor and mode search (Options::lookahead)
+    struct SearchState {
+        GpsPoint reconstructed;
+        HistoryState history[kMaxHistorySize];
+        int history_size;
+        int route_segment;
+        double route_offset;
+        CompressionMode mode;
+        uint64_t last_evaluation_timestamp;
+        long long cost;  // estimated bits of the pending points on this path
+        int predictor_frequency[kMaxPredictors];
+        uint8_t code_length[kMaxPredictors];
+        // Flags this path added after predictor_window_; its window is the tail of
+        // predictor_window_ followed by them, so only the count is kept
+        int pending_flags;
+    };
+    struct SearchChoice {
+        int parent;  // beam entry of the previous pending point
+        PredictorType predictor;
+        CompressionMode mode;  // mode after the point
+    };
+    struct SearchCandidate {
+        long long cost;
+        int order;  // generation order, breaks cost ties
+        int parent;
+        PredictorType predictor;
+        CompressionMode mode;
+        uint64_t last_evaluation_timestamp;
+        GpsPoint prediction;
+    };
+    int lookahead_ = 0;
+    bool search_modes_ = false;           // mode bits chosen by the search, not the heuristic
+    std::vector<SearchState> beam_;       // paths ending at the newest pending point
+    std::vector<SearchState> next_beam_;
+    std::vector<SearchChoice> choices_;   // kSearchBeamWidth entries per pending point
+    std::vector<SearchCandidate> candidates_;
+    std::vector<SearchChoice> best_path_;
+    size_t choices_head_ = 0;
+    std::vector<GpsPoint> pending_points_;
+    std::vector<double> pending_attributes_;  // one row of channel values per pending point
+    size_t pending_head_ = 0;
+    int pending_count_ = 0;
+    
+    // Validate and apply stream parameters, (re)allocating the output buffer if needed
+    void Configure(int block_size, double epsilon, const Options& options);
+    void AllocateOutput();  // room for kBlockSize points, reusing the buffer if it is large enough
+    
+    // Per-stream state back to its initial values
+    void ResetStreamState();
+    void ApplyPredictorPrior();  // flag frequencies and initial mode from prior_
+    
+    // Encode a point now; choice overrides the greedy predictor and mode decisions
+    void EncodePoint(const GpsPoint& point, const double* attributes, const SearchChoice* choice);
+    void EncodeSinglePoint(const GpsPoint& point, const double* attributes, const SearchChoice* choice);
+    
+    // Stationary runs
+    bool IsStationary(const GpsPoint& point) const;
+    void FlushStationaryRun();
+    
+    // Gap escapes
+    bool IsJump(const GpsPoint& point);
+    void EncodeGapPoint(const GpsPoint& point, const double* attributes, const SearchChoice* choice);
+    
+    // Segment mode
+    void EncodeMovingPoint(const GpsPoint& point, const double* attributes, const SearchChoice* choice);
+    void AddSegmentPoint(const GpsPoint& point, const double* attributes);
+    void FlushSegment();  // longest segment the held points allow; re-adds the rest
+    bool CheckSegment(int count, const GpsPoint& end) const;
+    void EmitSegment(int count, const GpsPoint& end);
+    GpsPoint SegmentEndPoint(int index);  // end point of a segment over the first index + 1 held points
+    void EstimateSegmentCost(const GpsPoint& point);
+    
+    // Lookahead search
+    void SnapshotSearchState(SearchState& state) const;
+    void PredictSearchState(const SearchState& state, uint64_t timestamp, GpsPoint predictions[kMaxPredictors]) const;
+    void ApplySearchStep(SearchState& state, const GpsPoint& point, const SearchCandidate& candidate) const;
+    void ExpandSearch(const GpsPoint& point, int point_number);
+    void CommitSearchSteps(int count);
+    void RestartSearch();
+    
     // (comment removed)
     void ProcessFirstPoint(const GpsPoint& point);
+    GpsPoint EncodeFirstPoint(const GpsPoint& point);  // raw, or against the profile origin
+    // Throws unless the profile describes a stream of these parameters (epsilon × 0.999)
+    static void CheckStreamProfile(const StreamProfileTable* profiles, int profile_id, double stored_epsilon,
+                                   bool metric_bound, int evaluation_window, bool use_time_window,
+                                   uint64_t time_window_seconds, bool rate_control);
     
     // (comment removed)
     void ParallelPredict(GpsPoint& pred_ldr, GpsPoint& pred_cp, GpsPoint& pred_zp, uint64_t current_timestamp);
@@ -254,11 +784,42 @@ private:
                                             const GpsPoint& pred_ldr,
                                             const GpsPoint& pred_cp,
                                             const GpsPoint& pred_zp,
+                                            const GpsPoint& pred_rt,
                                             GpsPoint& best_prediction,
                                             int& best_cost);
     
+    // Route template prediction (falls back to pred_ldr when off the template)
+    GpsPoint PredictRouteTemplate(const GpsPoint& pred_ldr, uint64_t current_timestamp) const;
+    
+    // Mode bit at the end of each evaluation window
+    void WriteModeBitIfDue(uint64_t timestamp, const SearchChoice* choice);
+    void WriteRateStep(uint64_t timestamp);
+    void SetRateStep(int step);
+    void BuildPrecisionLevels();  // from the map and the constructor epsilon
+    void SetPrecisionLevel(int level);
+    int WriteTimestampWord(uint64_t word);  // merged into a pending precision switch
+    bool IsEvaluationPoint(int point_number, uint64_t timestamp, uint64_t& last_evaluation_timestamp) const;
+    
+    // Integer-grid encoding path
+    GridPoint ToGrid(const GpsPoint& point) const;
+    GpsPoint FromGrid(const GridPoint& point) const;
+    void EncodeGridPoint(const GpsPoint& point);
+    int EstimateGridResidualCost(const GridPoint& point, const GridPoint& prediction) const;
+    
+    void EncodeAttributes(const double* attributes, uint64_t timestamp);
+    
+    // Residual against the chosen prediction; returns the reconstructed position
+    GpsPoint EncodeResidual(const GpsPoint& point, const GpsPoint& prediction);
+    // A residual pair as ZigZag + 1 codes: Elias-gamma, the residual class model or block classes
+    int WriteResidualCodes(uint64_t lon_code, uint64_t lat_code);
+    void EncodeBlock();  // both passes over the held points
+    bool BuildBlockClasses();  // false if Elias-gamma is no larger
+    int WriteBlockClassCode(uint64_t payload);
+    void FlushPendingPoints();  // search steps, run and segments not yet coded
+    void WritePointCount();  // into the block size field of a short stream (Close())
+    
     // (comment removed)
-    void EncodeMultiPredictor(const GpsPoint& point);
+    void EncodeMultiPredictor(const GpsPoint& point, const SearchChoice* choice);
     
  // LDR-Only
     void EncodeLDROnly(const GpsPoint& point);
@@ -270,11 +831,22 @@ private:
     
  // （，）
     void EvaluateAndSwitchModeBasedOnCost();
+    void PushSegmentCost(int cost, uint64_t timestamp);
     void EncodeModeSwitch(CompressionMode new_mode);
     
     // (comment removed)
     int EstimateEliasGammaBits(int64_t value) const;
-    int EstimateErrorEncodingCost(const GpsPoint& error) const;
+    int EstimateErrorEncodingCost(const GpsPoint& error, double prediction_latitude) const;
+    int EstimateResidualCodeBits(uint64_t lon_code, uint64_t lat_code) const;
+    // Longitude step of a residual whose latitude is quantized_lat steps from prediction_latitude
+    double LonQuantStep(double prediction_latitude, int64_t quantized_lat) const {
+        return metric_bound_ ? kQuantStep * MetricLonScale(prediction_latitude + quantized_lat * kQuantStep, kQuantStep)
+                             : kQuantStep;
+    }
+    double LonEpsilon(double latitude) const {  // of an input point
+        return metric_bound_ ? kEpsilon * MetricLonScale(latitude, 0) : kEpsilon;
+    }
+    int EstimateResidualCost(const GpsPoint& point, const GpsPoint& prediction) const;
     
     // (comment removed)
     void UpdateCostWindows(int multi_cost, int ldr_only_cost, uint64_t timestamp);
@@ -303,10 +875,31 @@ public:
     using CompressionMode = CoSTCompressor::CompressionMode;
     using HistoryState = CoSTCompressor::HistoryState;
     
-    CoSTDecompressor(uint8_t* compressed_data, int data_size);
+    /**
+     * @param route_templates required when the stream was compressed with a route template
+     * @param stream_profiles required when the stream starts with a compact header
+     */
+    CoSTDecompressor(const uint8_t* compressed_data, int data_size,
+                     const RouteTemplateLibrary* route_templates = nullptr,
+                     const StreamProfileTable* stream_profiles = nullptr);
     
     bool ReadNextPoint(GpsPoint& point);
+    
+    /**
+     * @param attributes receives one value per attribute channel of the stream
+     */
+    bool ReadNextPoint(GpsPoint& point, double* attributes);
     std::vector<GpsPoint> ReadAllPoints();
+    
+    /**
+     * Continue decoding from the next packet produced by CoSTCompressor::TakePacket
+     */
+    void SetPacket(ArrayView<const uint8_t> packet);
+    
+    const std::vector<AttributeChannel>& GetAttributeChannels() const { return attribute_channels_; }
+    int GetLevel() const { return level_; }  // compression level of the stream
+    CoSTCompressor::PredictorPrior GetPredictorPrior() const;  // as CoSTCompressor::GetPredictorPrior
+    const std::vector<int>& GetTripStarts() const { return trip_starts_; }  // as CoSTCompressor::GetTripStarts
 
 private:
     std::unique_ptr<InputBitStream> input_bit_stream_;
@@ -315,13 +908,37 @@ private:
     int block_size_;
     double epsilon_;
     double quant_step_;
+    bool metric_bound_ = false;
     int evaluation_window_;  // （）
     bool use_time_window_;   // 
     uint64_t time_window_seconds_;  // （）
+    bool integer_grid_ = false;
+    bool lossless_ = false;
+    int level_ = CoSTCompressor::kDefaultLevel;
+    bool rate_control_ = false;
+    std::vector<double> rate_epsilons_;  // same ladder as the encoder
+    int rate_step_ = 0;
+    bool stationary_runs_ = false;
+    std::vector<uint64_t> run_timestamps_;  // decoded run token, returned one point per call
+    size_t run_next_ = 0;
+    bool segment_mode_ = false;
+    std::vector<uint64_t> segment_timestamps_;  // decoded segment token
+    size_t segment_next_ = 0;
+    GpsPoint segment_start_;
+    GpsPoint segment_end_;
+    bool gap_escapes_ = false;
+    bool hex_lattice_ = false;
+    bool precision_map_ = false;
+    std::vector<double> precision_epsilons_;  // header epsilon, then the table of the header
+    std::unique_ptr<ResidualClassModel> residual_model_;  // same updates as the encoder, null when off
+    int block_class_bits_ = -1;  // -1 without block classes
+    uint8_t block_class_widths_[1 << CoSTCompressor::kMaxBlockClassBits];
+    std::vector<int> trip_starts_;
     
     // (comment removed)
     bool first_point_ = true;
     int points_read_ = 0;  // （）
+    int point_count_ = INT_MAX;  // bound from the header block size field, lifted by SetPacket
     uint64_t last_evaluation_timestamp_ = 0;  // （）
     CompressionMode current_mode_ = CompressionMode::MODE_MULTI_PREDICTOR;
     PredictorType last_used_predictor_ = PredictorType::PREDICTOR_ZP;
@@ -331,15 +948,51 @@ private:
     std::vector<HistoryState> history_states_;
     static constexpr int kMaxHistorySize = 3;
     
+    // Route template predictor state
+    const RouteTemplateLibrary* route_templates_;
+    int route_id_ = -1;
+    int route_segment_ = -1;
+    double route_offset_ = 0;
+    bool stream_valid_ = true;  // false if the stream needs a template or profile we do not have
+    
+    // Compact header: the first point is coded against the profile origin
+    const StreamProfileTable* stream_profiles_;
+    bool compact_header_ = false;
+    GpsPoint profile_origin_;
+    CoSTCompressor::PredictorPrior prior_;  // prior of the stream, built-in unless the header names one
+    
+    // Integer-grid state
+    GridPredictor grid_predictor_;
+    
+    std::vector<AttributeChannel> attribute_channels_;
+    std::vector<AttributeChannelCodec> attribute_codecs_;
+    std::vector<double> attribute_scratch_;  // values dropped by ReadNextPoint(point)
+    
  // Huffman 
     static constexpr int kSlidingWindowSize = 1000;
     std::vector<PredictorType> predictor_window_;
-    int predictor_frequency_[3] = {0, 0, 0};
-    PredictorType huffman_decoder_map_[3];
+    int num_predictors_ = 3;
+    int predictor_frequency_[CoSTCompressor::kMaxPredictors] = {0, 0, 0, 0};
+    PredictorType huffman_decoder_map_[CoSTCompressor::kMaxPredictors];
+    bool compact_profile_ = false;
+    CompactFlagModel compact_flags_;
     
     // (comment removed)
     void ReadHeader();
+    bool ReadFirstPoint(GpsPoint& point);  // false on a corrupt first point
+    bool ReadTimestampWord(uint64_t& word);  // applies a precision switch; false if corrupt
+    GpsPoint DecodeResidual(const GpsPoint& prediction);
+    uint64_t ReadBlockClassCode();  // ZigZag + 1
+    GpsPoint ReconstructGridPoint(PredictorType predictor, uint64_t current_timestamp);
+    bool FinishPoint(uint64_t current_timestamp, double* attributes);  // attributes and mode bit after each point
+    bool ReadRunToken();  // false on a corrupt token
+    bool NextRunPoint(GpsPoint& point, double* attributes);
+    bool ReadSegmentToken(size_t count);
+    bool ReadGapPoint(GpsPoint& point, double* attributes, uint64_t timestamp_code);  // code = ZigZag(delta) + 1
+    bool NextSegmentPoint(GpsPoint& point, double* attributes);
+    void DecodeAttributes(double* attributes, uint64_t current_timestamp);
     void ParallelPredict(GpsPoint& pred_ldr, GpsPoint& pred_cp, GpsPoint& pred_zp, uint64_t current_timestamp);
+    GpsPoint PredictRouteTemplate(const GpsPoint& pred_ldr, uint64_t current_timestamp) const;
     void UpdateHistory(const GpsPoint& reconstructed_point);
     void UpdateHuffmanDecoder();
     PredictorType DecodeWithHuffman();  // Huffman（）
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "algorithm/compact_cost_encoder.h"
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Heap-free CoST encoder for tracker firmware
+ *
+ * Wraps CompactCoSTEncoder with fixed-size storage and a caller-supplied output
+ * buffer: no heap, no exceptions, no iostreams, no STL containers. The output is
+ * a regular CoST stream (compact profile) readable by CoSTDecompressor; after
+ * Finish() its header holds the point count, so ReadAllPoints() needs nothing else.
+ *
+ *   static uint8_t buffer[1024];
+ *   EmbeddedCoSTEncoder encoder(1e-5);
+ *   encoder.Reset(buffer, sizeof(buffer));
+ *   if (!encoder.AddGpsPoint(lon, lat, ts)) { ... buffer full: Finish(), send, Reset() ... }
+ *   int bytes = encoder.Finish();
+ *
+ * sizeof(EmbeddedCoSTEncoder) is the whole RAM footprint besides the buffer.
+ */
+class EmbeddedCoSTEncoder {
+public:
+    /**
+     * @param error_bound epsilon in degrees (values below CompactCoSTConfig::kMinErrorBound are clamped to it)
+     * @param max_points block size announced in the header; Finish() replaces it
+     *        with the point count, so the decoder stops after the last point
+     * @param evaluation_window points between mode evaluations, clamped to [1, 32767]
+     */
+    explicit EmbeddedCoSTEncoder(double error_bound, uint16_t max_points = 0xFFFF,
+                                 uint16_t evaluation_window = 96)
+        : config_(error_bound, max_points, evaluation_window) {
+        Reset(nullptr, 0);
+    }
+
+    // Start a new stream in buffer (the encoder does not take ownership)
+    void Reset(uint8_t* buffer, int capacity) {
+        buffer_ = buffer;
+        capacity_ = capacity;
+        size_ = 0;
+        finished_ = false;
+        state_.Reset();
+    }
+
+    /**
+     * Encode a point
+     * @return false (and leave the stream unchanged) if the point and the final
+     *         padding byte do not fit in the buffer, or after Finish()
+     */
+    bool AddGpsPoint(double longitude, double latitude, uint64_t timestamp) {
+        if (finished_) return false;
+        int remaining = capacity_ - size_;
+
+        // Fast path: the worst case fits, encode in place
+        if (remaining > CompactCoSTEncoder::kMaxBytesPerPoint) {
+            size_ += CompactCoSTEncoder::Encode(config_, state_, longitude, latitude, timestamp, buffer_ + size_);
+            return true;
+        }
+
+        // Near the end of the buffer: encode to scratch and roll back if it does not fit
+        CompactCoSTState saved = state_;
+        uint8_t scratch[CompactCoSTEncoder::kMaxBytesPerPoint];
+        int bytes = CompactCoSTEncoder::Encode(config_, state_, longitude, latitude, timestamp, scratch);
+        int padding = state_.bits_in_buffer > 0 ? 1 : 0;
+        if (bytes + padding > remaining) {
+            state_ = saved;
+            return false;
+        }
+        memcpy(buffer_ + size_, scratch, bytes);
+        size_ += bytes;
+        return true;
+    }
+
+    /**
+     * Write the pending bits and the point count; the stream is complete afterwards
+     * @return stream length in bytes
+     */
+    int Finish() {
+        if (!finished_ && buffer_ != nullptr) {
+            size_ += CompactCoSTEncoder::Finish(state_, buffer_ + size_);
+            CompactCoSTEncoder::WritePointCount(config_, state_, buffer_);
+            finished_ = true;
+        }
+        return size_;
+    }
+
+    int GetSize() const { return size_; }  // complete bytes so far
+    uint32_t GetPointCount() const { return state_.points; }
+
+private:
+    CompactCoSTState state_;
+    CompactCoSTConfig config_;
+    uint8_t* buffer_;
+    int capacity_;
+    int size_;
+    bool finished_;
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Integer-grid predictors for CoST's fixed-point mode
+ *
+ * Coordinates are mapped once to an int64 grid of step 2ε; LDR/CP/ZP
+ * predictions, residuals and reconstruction then stay in integers, so the
+ * encoder and the decoder agree bit-exactly regardless of compiler flags
+ * (-ffast-math, FMA contraction, x87, ...).
+ *
+ * The predictors mirror the floating-point ones in CoSTCompressor:
+ *   LDR: p + v * dt
+ *   CP:  p + v * dt + (v - v_prev) * dt^2 / 2
+ * with v = (p - p_prev) / dt_prev evaluated as exact rationals and rounded
+ * once to the nearest grid cell. Uniform sampling takes a division-free path.
+ */
+struct GridPoint {
+    int64_t x = 0;  // longitude / step
+    int64_t y = 0;  // latitude / step
+    uint64_t timestamp = 0;
+
+    GridPoint() {}
+    GridPoint(int64_t gx, int64_t gy, uint64_t ts) : x(gx), y(gy), timestamp(ts) {}
+};
+
+class GridPredictor {
+public:
+    void Reset() { size_ = 0; }
+
+    void Push(const GridPoint& point) {
+        history_[0] = history_[1];
+        history_[1] = history_[2];
+        history_[2] = point;
+        if (size_ < 3) size_++;
+    }
+
+    const GridPoint& Last() const { return history_[2]; }
+
+    void Predict(uint64_t timestamp, GridPoint& pred_ldr, GridPoint& pred_cp, GridPoint& pred_zp) const {
+        const GridPoint& p = history_[2];
+        pred_zp = GridPoint(p.x, p.y, timestamp);
+
+        if (size_ < 2) {
+            pred_ldr = pred_zp;
+            pred_cp = pred_zp;
+            return;
+        }
+
+        int64_t dt = static_cast<int64_t>(timestamp) - static_cast<int64_t>(p.timestamp);
+        if (dt <= 0) dt = 1;  // same fallback as the floating-point predictors
+
+        // Velocity of the last step as a rational (dx, dy) / dt1; zero on non-positive dt1
+        const GridPoint& q = history_[1];
+        int64_t dt1 = static_cast<int64_t>(p.timestamp) - static_cast<int64_t>(q.timestamp);
+        int64_t dx1 = 0, dy1 = 0;
+        if (dt1 > 0) {
+            dx1 = p.x - q.x;
+            dy1 = p.y - q.y;
+        } else {
+            dt1 = 1;
+        }
+
+        if (dt == dt1) {
+            pred_ldr = GridPoint(p.x + dx1, p.y + dy1, timestamp);
+        } else {
+            pred_ldr = GridPoint(p.x + RoundDiv(static_cast<__int128>(dx1) * dt, dt1),
+                                 p.y + RoundDiv(static_cast<__int128>(dy1) * dt, dt1), timestamp);
+        }
+
+        if (size_ < 3) {
+            pred_cp = pred_ldr;
+            return;
+        }
+
+        const GridPoint& r = history_[0];
+        int64_t dt0 = static_cast<int64_t>(q.timestamp) - static_cast<int64_t>(r.timestamp);
+        int64_t dx0 = 0, dy0 = 0;
+        if (dt0 > 0) {
+            dx0 = q.x - r.x;
+            dy0 = q.y - r.y;
+        } else {
+            dt0 = 1;
+        }
+
+        if (dt == dt1 && dt == dt0) {
+            // Uniform sampling: p + d1 + (d1 - d0) * dt / 2
+            pred_cp = GridPoint(p.x + dx1 + HalfRound(static_cast<__int128>(dx1 - dx0) * dt),
+                                p.y + dy1 + HalfRound(static_cast<__int128>(dy1 - dy0) * dt), timestamp);
+        } else {
+            pred_cp = GridPoint(p.x + CurveOffset(dx1, dt1, dx0, dt0, dt),
+                                p.y + CurveOffset(dy1, dt1, dy0, dt0, dt), timestamp);
+        }
+    }
+
+private:
+    GridPoint history_[3];
+    int size_ = 0;
+
+    // d1/dt1 * dt + (d1/dt1 - d0/dt0) * dt^2 / 2, over the common denominator 2*dt1*dt0
+    static int64_t CurveOffset(int64_t d1, int64_t dt1, int64_t d0, int64_t dt0, int64_t dt) {
+        __int128 t = dt;
+        __int128 num = 2 * static_cast<__int128>(d1) * dt0 * t +
+                       (static_cast<__int128>(d1) * dt0 - static_cast<__int128>(d0) * dt1) * t * t;
+        return RoundDiv(num, 2 * static_cast<__int128>(dt1) * dt0);
+    }
+
+    // Round-half-up integer division for den > 0
+    static int64_t RoundDiv(__int128 num, __int128 den) {
+        __int128 twice = 2 * num + den;
+        __int128 q = twice / (2 * den);
+        if ((twice % (2 * den)) < 0) q -= 1;  // floor for negative numerators
+        return static_cast<int64_t>(q);
+    }
+
+    static int64_t HalfRound(__int128 value) {
+        return static_cast<int64_t>((value + 1) >> 1);  // arithmetic shift == floor
+    }
+};
@@ -0,0 +1,143 @@
+#include "algorithm/net_cost_compressor.h"
+#include <stdexcept>
+
+// ==================== NetCoST Compressor ====================
+
+NetCoSTCompressor::NetCoSTCompressor(double epsilon, int batch_size, const CoSTCompressor::Options& options)
+    : compressor_(batch_size, epsilon, options), kBatchSize(batch_size) {}
+
+Array<uint8_t> NetCoSTCompressor::Compress(const GpsPoint& point) {
+    return Compress(point, nullptr);
+}
+
+Array<uint8_t> NetCoSTCompressor::Compress(const GpsPoint& point, const double* attributes) {
+    compressor_.AddGpsPoint(point, attributes);
+    if (++pending_points_ < kBatchSize) return Array<uint8_t>();
+    return Flush();
+}
+
+Array<uint8_t> NetCoSTCompressor::Flush() {
+    if (pending_points_ == 0) return Array<uint8_t>();
+    pending_points_ = 0;
+    last_compressed_bits_ = compressor_.GetCompressedSizeInBits() - packet_start_bits_;
+    packet_start_bits_ = compressor_.GetCompressedSizeInBits();
+    return compressor_.TakePacket();
+}
+
+// ==================== NetCoST Decompressor ====================
+
+NetCoSTDecompressor::NetCoSTDecompressor(const RouteTemplateLibrary* route_templates)
+    : route_templates_(route_templates) {}
+
+bool NetCoSTDecompressor::Decompress(ArrayView<const uint8_t> packet, GpsPoint& point, double* attributes) {
+    return Decompress(packet, 1, &point, attributes) == 1;
+}
+
+int NetCoSTDecompressor::Decompress(ArrayView<const uint8_t> packet, int point_count, GpsPoint* points,
+                                    double* attributes) {
+    if (decompressor_ == nullptr) {
+        decompressor_ = std::make_unique<CoSTDecompressor>(packet.begin(), packet.length(), route_templates_);
+    } else {
+        decompressor_->SetPacket(packet);
+    }
+
+    int channels = static_cast<int>(decompressor_->GetAttributeChannels().size());
+    for (int i = 0; i < point_count; ++i) {
+        double* row = attributes != nullptr ? attributes + i * channels : nullptr;
+        if (!decompressor_->ReadNextPoint(points[i], row)) return i;
+    }
+    return point_count;
+}
+
+// ==================== Framed NetCoST ====================
+
+FramedNetCoSTCompressor::FramedNetCoSTCompressor(double epsilon, const FramingOptions& framing,
+                                                 int batch_size, const CoSTCompressor::Options& options)
+    : kEpsilon(epsilon), framing_(framing), kBatchSize(batch_size), options_(options) {
+    if (framing.sequence_bits < 0 || framing.sequence_bits > 31 || framing.keyframe_interval < 1) {
+        throw std::invalid_argument("NetCoST: invalid framing options");
+    }
+}
+
+Array<uint8_t> FramedNetCoSTCompressor::Compress(const GpsPoint& point) {
+    return Compress(point, nullptr);
+}
+
+Array<uint8_t> FramedNetCoSTCompressor::Compress(const GpsPoint& point, const double* attributes) {
+    // Restart the stream at a packet boundary once the keyframe interval is used up
+    if (stream_ == nullptr || (stream_->GetPendingPoints() == 0 && packets_in_stream_ >= framing_.keyframe_interval)) {
+        stream_ = std::make_unique<NetCoSTCompressor>(kEpsilon, kBatchSize, options_);
+        keyframe_ = true;
+        packets_in_stream_ = 0;
+    }
+    Array<uint8_t> packet = stream_->Compress(point, attributes);
+    if (packet.length() == 0) return Array<uint8_t>();
+    return Frame(packet);
+}
+
+Array<uint8_t> FramedNetCoSTCompressor::Flush() {
+    if (stream_ == nullptr) return Array<uint8_t>();
+    Array<uint8_t> packet = stream_->Flush();
+    if (packet.length() == 0) return Array<uint8_t>();
+    return Frame(packet);
+}
+
+Array<uint8_t> FramedNetCoSTCompressor::Frame(ArrayView<const uint8_t> packet) {
+    int header_bits = 1 + framing_.sequence_bits;
+    int payload_bits = stream_->GetLastCompressedBits();
+    last_compressed_bits_ = header_bits + payload_bits;
+
+    OutputBitStream frame(packet.length() + 8);
+    frame.WriteInt((static_cast<uint32_t>(keyframe_) << framing_.sequence_bits) | sequence_, header_bits);
+    for (int i = 0; i < packet.length(); ++i) frame.WriteInt(packet[i], 8);
+    frame.Flush();
+
+    keyframe_ = false;
+    packets_in_stream_++;
+    sequence_ = (sequence_ + 1) & ((1u << framing_.sequence_bits) - 1);
+    return frame.GetBuffer((last_compressed_bits_ + 7) / 8);
+}
+
+FramedNetCoSTDecompressor::FramedNetCoSTDecompressor(int sequence_bits,
+                                                     const RouteTemplateLibrary* route_templates)
+    : kSequenceBits(sequence_bits),
+      kSequenceMask(sequence_bits >= 0 && sequence_bits <= 31 ? (1u << sequence_bits) - 1 : 0),
+      route_templates_(route_templates) {
+    if (sequence_bits < 0 || sequence_bits > 31) {
+        throw std::invalid_argument("NetCoST: invalid framing options");
+    }
+}
+
+bool FramedNetCoSTDecompressor::Decompress(ArrayView<const uint8_t> frame, GpsPoint& point, double* attributes) {
+    return Decompress(frame, 1, &point, attributes) == 1;
+}
+
+int FramedNetCoSTDecompressor::Decompress(ArrayView<const uint8_t> frame, int point_count, GpsPoint* points,
+                                          double* attributes) {
+    if (frame.length() == 0) return 0;
+    InputBitStream input(frame);
+    uint32_t header = input.ReadInt(1 + kSequenceBits);
+    bool keyframe = (header >> kSequenceBits) != 0;
+    uint32_t sequence = header & kSequenceMask;
+
+    if (started_ && sequence != expected_sequence_) {
+        lost_frames_ += (sequence - expected_sequence_) & kSequenceMask;
+        synchronized_ = false;
+    }
+    started_ = true;
+    expected_sequence_ = (sequence + 1) & kSequenceMask;
+
+    if (keyframe) {
+        stream_ = std::make_unique<NetCoSTDecompressor>(route_templates_);
+        synchronized_ = true;
+    }
+    if (!synchronized_) {
+        dropped_frames_++;
+        return 0;
+    }
+
+    // Realign the NetCoST packet that follows the frame header
+    payload_.resize((frame.length() * 8 - 1 - kSequenceBits + 7) / 8);
+    for (uint8_t& byte : payload_) byte = input.ReadInt(8);
+    return stream_->Decompress(payload_, point_count, points, attributes);
+}
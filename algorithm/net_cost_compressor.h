@@ -0,0 +1,167 @@
+#pragma once
+
+#include "algorithm/cost_compressor.h"
+#include <memory>
+#include <vector>
+
+/**
+ * NetCoST: per-point (or small-batch) uplink packets
+ *
+ * CoST coding with the output cut into byte-aligned packets as soon as a point
+ * (or a batch of points) is encoded. The first packet also carries the stream
+ * header. Packets must be decoded in order by a single NetCoSTDecompressor, and
+ * the receiver must know how many points each packet holds (batch_size, or the
+ * count returned with the final packet from Flush()).
+ */
+class NetCoSTCompressor {
+public:
+    using GpsPoint = CoSTCompressor::GpsPoint;
+
+    /**
+     * @param epsilon error bound (0 = lossless)
+     * @param batch_size points per packet (1 = one packet per fix)
+     * @param options encoder options, see CoSTCompressor::Options
+     */
+    explicit NetCoSTCompressor(double epsilon, int batch_size = 1,
+                               const CoSTCompressor::Options& options = CoSTCompressor::Options());
+
+    /**
+     * Encode a point
+     * @return the packet once batch_size points are pending, an empty array otherwise
+     */
+    Array<uint8_t> Compress(const GpsPoint& point);
+    Array<uint8_t> Compress(const GpsPoint& point, const double* attributes);
+
+    /**
+     * Packet with the points of an incomplete batch (empty if nothing is pending)
+     */
+    Array<uint8_t> Flush();
+
+    // Points encoded since the last packet
+    int GetPendingPoints() const { return pending_points_; }
+
+    // Bits of the last packet before byte padding
+    int GetLastCompressedBits() const { return last_compressed_bits_; }
+
+    const CoSTCompressor::CompressionStats& GetStats() const { return compressor_.GetStats(); }
+
+private:
+    CoSTCompressor compressor_;
+    const int kBatchSize;
+    int pending_points_ = 0;
+    int packet_start_bits_ = 0;
+    int last_compressed_bits_ = 0;
+};
+
+class NetCoSTDecompressor {
+public:
+    using GpsPoint = CoSTCompressor::GpsPoint;
+
+    /**
+     * @param route_templates required when the stream was compressed with a route template
+     */
+    explicit NetCoSTDecompressor(const RouteTemplateLibrary* route_templates = nullptr);
+
+    /**
+     * Decode a single-point packet
+     * @param attributes receives one value per attribute channel (may be nullptr)
+     */
+    bool Decompress(ArrayView<const uint8_t> packet, GpsPoint& point, double* attributes = nullptr);
+
+    /**
+     * Decode a packet holding point_count points
+     * @param attributes point_count rows of attribute values (may be nullptr)
+     * @return number of points decoded
+     */
+    int Decompress(ArrayView<const uint8_t> packet, int point_count, GpsPoint* points,
+                   double* attributes = nullptr);
+
+private:
+    const RouteTemplateLibrary* route_templates_;
+    std::unique_ptr<CoSTDecompressor> decompressor_;  // created from the first (header) packet
+};
+
+/**
+ * Loss-tolerant framing for NetCoST packets
+ *
+ *   frame = keyframe (1) | sequence number (sequence_bits) | NetCoST packet
+ *
+ * Every keyframe_interval packets the sender restarts the CoST stream, so a
+ * keyframe carries the header and the full first point and resets all
+ * predictor state. A receiver that sees a gap in the sequence numbers drops
+ * frames until the next keyframe. Losing exactly a multiple of
+ * 2^sequence_bits consecutive frames goes unnoticed.
+ */
+struct FramingOptions {
+    int sequence_bits = 8;       // 0..31, must match the receiver
+    int keyframe_interval = 32;  // packets per keyframe (1 = every packet)
+};
+
+class FramedNetCoSTCompressor {
+public:
+    using GpsPoint = CoSTCompressor::GpsPoint;
+
+    explicit FramedNetCoSTCompressor(double epsilon, const FramingOptions& framing = FramingOptions(),
+                                     int batch_size = 1,
+                                     const CoSTCompressor::Options& options = CoSTCompressor::Options());
+
+    // Same contract as NetCoSTCompressor, returning frames instead of packets
+    Array<uint8_t> Compress(const GpsPoint& point);
+    Array<uint8_t> Compress(const GpsPoint& point, const double* attributes);
+    Array<uint8_t> Flush();
+
+    int GetPendingPoints() const { return stream_ != nullptr ? stream_->GetPendingPoints() : 0; }
+
+    // Bits of the last frame before byte padding
+    int GetLastCompressedBits() const { return last_compressed_bits_; }
+
+private:
+    const double kEpsilon;
+    const FramingOptions framing_;
+    const int kBatchSize;
+    const CoSTCompressor::Options options_;
+
+    std::unique_ptr<NetCoSTCompressor> stream_;
+    bool keyframe_ = false;  // the pending packet starts a new stream
+    int packets_in_stream_ = 0;
+    uint32_t sequence_ = 0;
+    int last_compressed_bits_ = 0;
+
+    Array<uint8_t> Frame(ArrayView<const uint8_t> packet);
+};
+
+class FramedNetCoSTDecompressor {
+public:
+    using GpsPoint = CoSTCompressor::GpsPoint;
+
+    /**
+     * @param sequence_bits FramingOptions::sequence_bits of the sender (0..31, throws otherwise)
+     */
+    explicit FramedNetCoSTDecompressor(int sequence_bits = 8,
+                                       const RouteTemplateLibrary* route_templates = nullptr);
+
+    /**
+     * Decode a frame holding point_count points
+     * @return number of points decoded; 0 while waiting for a keyframe
+     */
+    int Decompress(ArrayView<const uint8_t> frame, int point_count, GpsPoint* points,
+                   double* attributes = nullptr);
+    bool Decompress(ArrayView<const uint8_t> frame, GpsPoint& point, double* attributes = nullptr);
+
+    bool IsSynchronized() const { return synchronized_; }
+    int GetLostFrames() const { return lost_frames_; }        // gaps seen in the sequence numbers
+    int GetDroppedFrames() const { return dropped_frames_; }  // received but not decodable
+
+private:
+    const int kSequenceBits;
+    const uint32_t kSequenceMask;
+    const RouteTemplateLibrary* route_templates_;
+
+    std::unique_ptr<NetCoSTDecompressor> stream_;
+    bool started_ = false;
+    bool synchronized_ = false;
+    uint32_t expected_sequence_ = 0;
+    int lost_frames_ = 0;
+    int dropped_frames_ = 0;
+    std::vector<uint8_t> payload_;  // realigned packet, reused across frames
+};
@@ -0,0 +1,191 @@
+#include "algorithm/precision_map.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Cells [first, last] of an axis that the closed interval [low, high] meets; false if none
+bool CellRange(double low, double high, double origin, double inverse_cell_size, int count,
+               int& first, int& last) {
+    double first_cell = std::floor((low - origin) * inverse_cell_size);
+    double last_cell = std::floor((high - origin) * inverse_cell_size);
+    if (!(last_cell >= 0 && first_cell < count)) return false;
+    first = static_cast<int>(std::max(first_cell, 0.0));
+    last = static_cast<int>(std::min(last_cell, static_cast<double>(count - 1)));
+    return true;
+}
+
+// Rest of a line must be empty or a comment
+bool AtLineEnd(std::istringstream& stream) {
+    std::string rest;
+    return !(stream >> rest) || rest[0] == '#';
+}
+
+}  // namespace
+
+PrecisionMap::PrecisionMap(double min_longitude, double min_latitude, double cell_size, int columns, int rows)
+    : min_longitude_(min_longitude), min_latitude_(min_latitude), cell_size_(cell_size),
+      inverse_cell_size_(1.0 / cell_size), columns_(columns), rows_(rows) {
+    if (!(std::isfinite(min_longitude) && std::isfinite(min_latitude) && cell_size > 0 && std::isfinite(cell_size))) {
+        throw std::invalid_argument("CoST: invalid precision map grid");
+    }
+    if (columns <= 0 || rows <= 0 || static_cast<int64_t>(columns) * rows > kMaxCells) {
+        throw std::invalid_argument("CoST: precision map grid must have 1 to 2^24 cells");
+    }
+    cells_.assign(static_cast<size_t>(columns) * rows, 0);
+}
+
+int PrecisionMap::LevelOf(double epsilon) {
+    if (!(epsilon > 0 && std::isfinite(epsilon))) throw std::invalid_argument("CoST: precision map epsilon must be > 0");
+    for (size_t i = 0; i < epsilons_.size(); ++i) {
+        if (epsilons_[i] == epsilon) return static_cast<int>(i) + 1;
+    }
+    if (epsilons_.size() == static_cast<size_t>(kMaxEpsilons)) {
+        throw std::invalid_argument("CoST: a precision map holds at most 15 epsilons");
+    }
+    epsilons_.push_back(epsilon);
+    return static_cast<int>(epsilons_.size());
+}
+
+void PrecisionMap::SetCell(int column, int row, int level) {
+    uint8_t& cell = cells_[static_cast<size_t>(row) * columns_ + column];
+    if (cell == 0 || epsilons_[level - 1] < epsilons_[cell - 1]) cell = static_cast<uint8_t>(level);
+}
+
+void PrecisionMap::AddCell(int column, int row, double epsilon) {
+    if (column < 0 || column >= columns_ || row < 0 || row >= rows_) {
+        throw std::invalid_argument("CoST: precision map cell outside the grid");
+    }
+    SetCell(column, row, LevelOf(epsilon));
+}
+
+bool PrecisionMap::SegmentTouchesCell(const GpsPoint& a, const GpsPoint& b, int column, int row) const {
+    double x0 = min_longitude_ + column * cell_size_;
+    double y0 = min_latitude_ + row * cell_size_;
+    double dx = b.longitude - a.longitude;
+    double dy = b.latitude - a.latitude;
+    const double p[4] = {-dx, dx, -dy, dy};
+    const double q[4] = {a.longitude - x0, x0 + cell_size_ - a.longitude,
+                         a.latitude - y0, y0 + cell_size_ - a.latitude};
+    double t0 = 0, t1 = 1;
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0) {
+            if (q[i] < 0) return false;
+        } else if (p[i] < 0) {
+            t0 = std::max(t0, q[i] / p[i]);
+        } else {
+            t1 = std::min(t1, q[i] / p[i]);
+        }
+    }
+    return t0 <= t1;
+}
+
+void PrecisionMap::AddPolygon(const std::vector<GpsPoint>& vertices, double epsilon) {
+    if (vertices.size() < 3) throw std::invalid_argument("CoST: a precision map polygon needs 3 vertices");
+    int level = LevelOf(epsilon);
+    size_t n = vertices.size();
+
+    // Cells an edge passes through
+    for (size_t i = 0; i < n; ++i) {
+        const GpsPoint& a = vertices[i];
+        const GpsPoint& b = vertices[(i + 1) % n];
+        int first_column, last_column, first_row, last_row;
+        if (!CellRange(std::min(a.longitude, b.longitude), std::max(a.longitude, b.longitude), min_longitude_,
+                       inverse_cell_size_, columns_, first_column, last_column) ||
+            !CellRange(std::min(a.latitude, b.latitude), std::max(a.latitude, b.latitude), min_latitude_,
+                       inverse_cell_size_, rows_, first_row, last_row)) {
+            continue;
+        }
+        for (int row = first_row; row <= last_row; ++row) {
+            for (int column = first_column; column <= last_column; ++column) {
+                if (SegmentTouchesCell(a, b, column, row)) SetCell(column, row, level);
+            }
+        }
+    }
+
+    // Cells whose center is inside (even-odd rule), one scanline per row the polygon spans
+    auto [lowest, highest] = std::minmax_element(vertices.begin(), vertices.end(),
+                                                 [](const GpsPoint& a, const GpsPoint& b) { return a.latitude < b.latitude; });
+    int first_row, last_row;
+    if (!CellRange(lowest->latitude, highest->latitude, min_latitude_, inverse_cell_size_, rows_, first_row, last_row)) {
+        return;
+    }
+    std::vector<double> crossings;
+    for (int row = first_row; row <= last_row; ++row) {
+        double y = min_latitude_ + (row + 0.5) * cell_size_;
+        crossings.clear();
+        for (size_t i = 0; i < n; ++i) {
+            const GpsPoint& a = vertices[i];
+            const GpsPoint& b = vertices[(i + 1) % n];
+            if ((a.latitude > y) != (b.latitude > y)) {
+                crossings.push_back(a.longitude + (y - a.latitude) / (b.latitude - a.latitude) * (b.longitude - a.longitude));
+            }
+        }
+        std::sort(crossings.begin(), crossings.end());
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+            int first_column, last_column;
+            if (!CellRange(crossings[i] - 0.5 * cell_size_, crossings[i + 1] - 0.5 * cell_size_, min_longitude_,
+                           inverse_cell_size_, columns_, first_column, last_column)) {
+                continue;
+            }
+            // Centers in [crossings[i], crossings[i + 1]]
+            if (min_longitude_ + (first_column + 0.5) * cell_size_ < crossings[i]) first_column++;
+            for (int column = first_column; column <= last_column; ++column) SetCell(column, row, level);
+        }
+    }
+}
+
+PrecisionMap PrecisionMap::LoadFromFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) throw std::invalid_argument("CoST: cannot open precision map " + path);
+
+    std::optional<PrecisionMap> map;  // empty until the grid line
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        std::istringstream stream(line);
+        std::string keyword;
+        if (!(stream >> keyword) || keyword[0] == '#') continue;
+        std::string error = "CoST: precision map line " + std::to_string(line_number) + ": ";
+
+        if (keyword == "grid") {
+            double min_longitude, min_latitude, cell_size;
+            int columns, rows;
+            if (map) throw std::invalid_argument(error + "second grid");
+            if (!(stream >> min_longitude >> min_latitude >> cell_size >> columns >> rows) || !AtLineEnd(stream)) {
+                throw std::invalid_argument(error + "expected grid <min_lon> <min_lat> <cell_size> <columns> <rows>");
+            }
+            map.emplace(min_longitude, min_latitude, cell_size, columns, rows);
+        } else if (!map) {
+            throw std::invalid_argument(error + "the grid must come first");
+        } else if (keyword == "cell") {
+            int column, row;
+            double epsilon;
+            if (!(stream >> column >> row >> epsilon) || !AtLineEnd(stream)) {
+                throw std::invalid_argument(error + "expected cell <column> <row> <epsilon>");
+            }
+            map->AddCell(column, row, epsilon);
+        } else if (keyword == "polygon") {
+            double epsilon;
+            if (!(stream >> epsilon)) throw std::invalid_argument(error + "expected polygon <epsilon> <lon> <lat> ...");
+            std::vector<GpsPoint> vertices;
+            double longitude, latitude;
+            while (stream >> longitude) {
+                if (!(stream >> latitude)) throw std::invalid_argument(error + "odd number of coordinates");
+                vertices.emplace_back(longitude, latitude);
+            }
+            stream.clear();
+            if (!AtLineEnd(stream)) throw std::invalid_argument(error + "expected polygon <epsilon> <lon> <lat> ...");
+            map->AddPolygon(vertices, epsilon);
+        } else {
+            throw std::invalid_argument(error + "unknown entry " + keyword);
+        }
+    }
+    if (!map) throw std::invalid_argument("CoST: precision map " + path + " has no grid");
+    return std::move(*map);
+}
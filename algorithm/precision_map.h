@@ -0,0 +1,79 @@
+#pragma once
+
+#include "algorithm/cost_compressor.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Precision Map
+ *
+ * Error bounds that vary with position, e.g. tight at depots and customer
+ * sites and loose on highways. The map is a uniform grid over a bounding box
+ * whose cells each hold a precision level: 0 (the epsilon of the compressor)
+ * or one of up to kMaxEpsilons map epsilons. Cells are set one by one or
+ * from polygons; a polygon covers every cell it touches, and where entries
+ * overlap the smallest epsilon wins, so no point gets a looser bound than an
+ * entry around it asks for. Lookup is one cell index per point.
+ *
+ * Only the encoder needs the map (CoSTCompressor::SetPrecisionMap): the
+ * header carries the epsilons and the stream a switch token wherever the
+ * level changes.
+ */
+class PrecisionMap {
+public:
+    using GpsPoint = CoSTCompressor::GpsPoint;
+
+    static constexpr int kMaxEpsilons = 15;
+    static constexpr int64_t kMaxCells = 1ll << 24;
+
+    /**
+     * @param min_longitude west edge of the grid (degrees)
+     * @param min_latitude south edge of the grid (degrees)
+     * @param cell_size cell width and height (degrees)
+     */
+    PrecisionMap(double min_longitude, double min_latitude, double cell_size, int columns, int rows);
+
+    /**
+     * Epsilons are in the unit of the compressor epsilon (meters with
+     * Options::epsilon_in_meters) and must be > 0
+     */
+    void AddCell(int column, int row, double epsilon);
+    void AddPolygon(const std::vector<GpsPoint>& vertices, double epsilon);  // closed implicitly
+
+    /**
+     * Read a map from a text file, one entry per line ('#' starts a comment):
+     *   grid <min_lon> <min_lat> <cell_size> <columns> <rows>   (first entry)
+     *   cell <column> <row> <epsilon>
+     *   polygon <epsilon> <lon> <lat> <lon> <lat> <lon> <lat> ...
+     * Throws std::invalid_argument on a missing or malformed file
+     */
+    static PrecisionMap LoadFromFile(const std::string& path);
+
+    // Level of a position: 0 off the grid and in cells without an entry,
+    // otherwise 1 + its index in GetEpsilons()
+    int Lookup(double longitude, double latitude) const {
+        double x = (longitude - min_longitude_) * inverse_cell_size_;
+        double y = (latitude - min_latitude_) * inverse_cell_size_;
+        if (!(x >= 0 && x < columns_ && y >= 0 && y < rows_)) return 0;
+        return cells_[static_cast<size_t>(y) * columns_ + static_cast<size_t>(x)];
+    }
+
+    const std::vector<double>& GetEpsilons() const { return epsilons_; }
+
+private:
+    double min_longitude_;
+    double min_latitude_;
+    double cell_size_;
+    double inverse_cell_size_;
+    int columns_;
+    int rows_;
+    std::vector<uint8_t> cells_;    // level per cell, row-major from the south-west corner
+    std::vector<double> epsilons_;  // level - 1 -> epsilon
+
+    int LevelOf(double epsilon);  // adds the epsilon if it is new
+    void SetCell(int column, int row, int level);  // keeps the smaller epsilon
+
+    // Whether the segment a-b meets the closed cell (Liang-Barsky clipping)
+    bool SegmentTouchesCell(const GpsPoint& a, const GpsPoint& b, int column, int row) const;
+};
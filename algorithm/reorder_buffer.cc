@@ -0,0 +1,153 @@
+#include "algorithm/reorder_buffer.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+constexpr double kRadiansPerDegree = M_PI / 180;
+
+}  // namespace
+
+CoSTReorderBuffer::CoSTReorderBuffer(CoSTCompressor& compressor, const ReorderOptions& options)
+    : compressor_(compressor), options_(options), kChannels(compressor.GetAttributeCount()) {
+    if (options.max_points < 1) {
+        throw std::invalid_argument("CoST: reorder buffer needs max_points >= 1");
+    }
+    if (options.max_lead_seconds != 0 && options.max_lead_seconds <= options.lateness_seconds) {
+        throw std::invalid_argument("CoST: reorder buffer needs max_lead_seconds > lateness_seconds");
+    }
+    for (int i = 0; i < kChannels; ++i) {
+        const AttributeChannel& channel = compressor.GetAttributeChannel(i);
+        if (channel.is_integer || channel.epsilon == 0) {
+            merge_rules_.push_back(MERGE_KEEP_FIRST);
+        } else if (channel.kind == AttributeChannel::HEADING) {
+            merge_rules_.push_back(MERGE_CIRCULAR_MEAN);
+        } else {
+            merge_rules_.push_back(MERGE_MEAN);
+        }
+    }
+}
+
+void CoSTReorderBuffer::AddGpsPoint(const GpsPoint& point) {
+    AddGpsPoint(point, nullptr);
+}
+
+void CoSTReorderBuffer::AddGpsPoint(const GpsPoint& point, const double* attributes) {
+    if (attributes == nullptr && kChannels > 0) {
+        throw std::invalid_argument("CoST: attribute values are required for this stream");
+    }
+    stats_.received++;
+    if (quarantined_) {
+        // The next point judges the one out ahead: back near the stream, it was an
+        // outlier; out ahead as well, the stream moved there
+        quarantined_ = false;
+        if (!IsLeading(point.timestamp)) {
+            stats_.outliers++;
+        } else {
+            Insert(quarantine_, quarantine_attributes_.data());
+            if (point.timestamp <= quarantine_.timestamp + options_.max_lead_seconds) {
+                Insert(point, attributes);
+                return;
+            }
+        }
+    }
+    if (IsLeading(point.timestamp)) {
+        quarantined_ = true;
+        quarantine_ = point;
+        quarantine_attributes_.assign(attributes, attributes + kChannels);
+        return;
+    }
+    Insert(point, attributes);
+}
+
+bool CoSTReorderBuffer::IsLeading(uint64_t timestamp) const {
+    if (options_.max_lead_seconds == 0) return false;
+    if (!passed_any_ && points_.empty()) return false;  // nothing to measure against yet
+    uint64_t reference = passed_any_ ? last_passed_ : points_.front().point.timestamp;
+    return timestamp > reference && timestamp - reference > options_.max_lead_seconds;
+}
+
+void CoSTReorderBuffer::Insert(const GpsPoint& point, const double* attributes) {
+    if (passed_any_ && point.timestamp <= last_passed_) {
+        if (point.timestamp == last_passed_) {
+            stats_.duplicates++;
+        } else {
+            stats_.late++;
+        }
+        return;
+    }
+
+    auto position = std::upper_bound(points_.begin(), points_.end(), point.timestamp,
+                                     [](uint64_t timestamp, const HeldPoint& held) {
+                                         return timestamp < held.point.timestamp;
+                                     });
+    size_t index = position - points_.begin();
+    if (index > 0 && points_[index - 1].point.timestamp == point.timestamp) {
+        stats_.duplicates++;
+        if (options_.merge_duplicates) {
+            // Running mean of the fixes with this timestamp
+            size_t held = index - 1;
+            HeldPoint& target = points_[held];
+            double weight = 1.0 / ++target.merged;
+            target.point.longitude += (point.longitude - target.point.longitude) * weight;
+            target.point.latitude += (point.latitude - target.point.latitude) * weight;
+            for (int i = 0; i < kChannels; ++i) {
+                double& value = attributes_[held * kChannels + i];
+                if (merge_rules_[i] == MERGE_MEAN) {
+                    value += (attributes[i] - value) * weight;
+                } else if (merge_rules_[i] == MERGE_CIRCULAR_MEAN) {
+                    // Direction of the summed unit vectors
+                    double& sin_sum = heading_sums_[(held * kChannels + i) * 2];
+                    double& cos_sum = heading_sums_[(held * kChannels + i) * 2 + 1];
+                    sin_sum += std::sin(attributes[i] * kRadiansPerDegree);
+                    cos_sum += std::cos(attributes[i] * kRadiansPerDegree);
+                    value = std::atan2(sin_sum, cos_sum) / kRadiansPerDegree;
+                    if (value < 0) value += 360;
+                    if (value >= 360) value -= 360;  // -tiny + 360 rounds to 360
+                }
+            }
+        }
+        return;
+    }
+    points_.insert(position, HeldPoint{point, 1, index < points_.size()});
+    if (kChannels > 0) {
+        attributes_.insert(attributes_.begin() + index * kChannels, attributes, attributes + kChannels);
+    }
+    if (options_.merge_duplicates && kChannels > 0) {
+        auto sums = heading_sums_.insert(heading_sums_.begin() + index * kChannels * 2, kChannels * 2, 0.0);
+        for (int i = 0; i < kChannels; ++i) {
+            if (merge_rules_[i] != MERGE_CIRCULAR_MEAN) continue;
+            sums[i * 2] = std::sin(attributes[i] * kRadiansPerDegree);
+            sums[i * 2 + 1] = std::cos(attributes[i] * kRadiansPerDegree);
+        }
+    }
+
+    uint64_t newest = points_.back().point.timestamp;
+    while (!points_.empty() && (newest - points_.front().point.timestamp > options_.lateness_seconds ||
+                                static_cast<int>(points_.size()) > options_.max_points)) {
+        PassOldest();
+    }
+}
+
+void CoSTReorderBuffer::Flush() {
+    // Nothing is left to judge a quarantined point by, and the last fix of a sparse stream waits there
+    if (quarantined_) {
+        quarantined_ = false;
+        Insert(quarantine_, quarantine_attributes_.data());
+    }
+    while (!points_.empty()) PassOldest();
+}
+
+void CoSTReorderBuffer::PassOldest() {
+    const HeldPoint& oldest = points_.front();
+    row_.assign(attributes_.begin(), attributes_.begin() + kChannels);
+    compressor_.AddGpsPoint(oldest.point, kChannels > 0 ? row_.data() : nullptr);
+    passed_any_ = true;
+    last_passed_ = oldest.point.timestamp;
+    stats_.passed++;
+    if (oldest.reordered) stats_.reordered++;
+    points_.pop_front();
+    attributes_.erase(attributes_.begin(), attributes_.begin() + kChannels);
+    if (!heading_sums_.empty()) heading_sums_.erase(heading_sums_.begin(), heading_sums_.begin() + kChannels * 2);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "algorithm/cost_compressor.h"
+#include <deque>
+#include <vector>
+
+/**
+ * Bounded reorder buffer in front of CoSTCompressor::AddGpsPoint
+ *
+ * Late and repeated fixes from real feeds break the predictors: a negative
+ * timestamp delta costs a 64-bit two's-complement value and ParallelPredict
+ * falls back to dt = 1. The buffer holds points for lateness_seconds (of
+ * stream time, measured from the newest timestamp seen), sorts them by
+ * timestamp and passes them on in order:
+ *
+ *   CoSTCompressor compressor(block_size, 1e-5);
+ *   CoSTReorderBuffer reorder(compressor);
+ *   for (...) reorder.AddGpsPoint(point);
+ *   reorder.Flush();
+ *   compressor.Close();
+ *
+ * Points older than the last one passed on are dropped (late). Points with the
+ * timestamp of a held point are duplicates: dropped (the first fix is kept) or
+ * merged (positions and attributes averaged). A point more than
+ * max_lead_seconds ahead of the stream would push every held point out and
+ * make the real ones late, so it waits in quarantine for the next arrival.
+ * If that one is back near the stream, the point is dropped as an outlier;
+ * if it is out ahead as well, the stream did move there (a sparse stream or a
+ * trip after a long pause) and both go in.
+ */
+struct ReorderOptions {
+    uint64_t lateness_seconds = 10;  // hold time; 0 only merges equal timestamps
+    int max_points = 1024;           // held points before the oldest is passed on regardless
+    // Lead over the last point passed on (the oldest held one before that)
+    // beyond which a point waits in quarantine; 0 accepts any lead, otherwise
+    // it must exceed lateness_seconds
+    uint64_t max_lead_seconds = 3600;
+    // Average duplicates instead of keeping the first. Positions and lossy
+    // attributes are averaged; lossy headings on the circle (359 and 1 give 0,
+    // results in [0, 360)). Integer and lossless channels keep the first value,
+    // since an average would be a value that was never measured
+    bool merge_duplicates = false;
+};
+
+class CoSTReorderBuffer {
+public:
+    using GpsPoint = CoSTCompressor::GpsPoint;
+
+    struct Stats {
+        int received = 0;
+        int passed = 0;      // points handed to the compressor
+        int reordered = 0;   // passed on ahead of a point that arrived before them
+        int late = 0;        // dropped: older than a point already passed on
+        int duplicates = 0;  // dropped or merged: same timestamp as an earlier point
+        int outliers = 0;    // dropped: too far ahead, and the next point fell back (max_lead_seconds)
+    };
+
+    /**
+     * @param compressor receives the ordered points (not owned; must outlive the buffer)
+     */
+    explicit CoSTReorderBuffer(CoSTCompressor& compressor, const ReorderOptions& options = ReorderOptions());
+
+    void AddGpsPoint(const GpsPoint& point);
+    void AddGpsPoint(const GpsPoint& point, const double* attributes);
+
+    // Pass on every held point (before CoSTCompressor::Close or TakePacket),
+    // a point in quarantine too
+    void Flush();
+
+    int GetHeldPoints() const { return static_cast<int>(points_.size()) + (quarantined_ ? 1 : 0); }
+    const Stats& GetStats() const { return stats_; }
+
+private:
+    CoSTCompressor& compressor_;
+    const ReorderOptions options_;
+    const int kChannels;
+
+    enum MergeRule { MERGE_MEAN, MERGE_CIRCULAR_MEAN, MERGE_KEEP_FIRST };
+    std::vector<MergeRule> merge_rules_;  // per attribute channel
+
+    struct HeldPoint {
+        GpsPoint point;
+        int merged;      // fixes averaged into the point
+        bool reordered;  // inserted ahead of a held point
+    };
+
+    // Held points in timestamp order, with one row of attributes per point
+    std::deque<HeldPoint> points_;
+    std::deque<double> attributes_;
+    std::deque<double> heading_sums_;  // with merge_duplicates: sin and cos sums per channel and point
+    std::vector<double> row_;          // attributes of the point being passed on
+    bool passed_any_ = false;
+    uint64_t last_passed_ = 0;
+
+    // Point too far ahead of the stream, waiting for a second one (max_lead_seconds)
+    bool quarantined_ = false;
+    GpsPoint quarantine_;
+    std::vector<double> quarantine_attributes_;
+
+    Stats stats_;
+
+    bool IsLeading(uint64_t timestamp) const;
+    void Insert(const GpsPoint& point, const double* attributes);
+    void PassOldest();
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "utils/output_bit_stream.h"
+#include "utils/input_bit_stream.h"
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * Context-adaptive residual codes (CoSTCompressor::Options::adaptive_residuals)
+ *
+ * A residual code v = ZigZag + 1 splits as in Elias-gamma into its magnitude
+ * class c = floor(log2 v) and the c bits below the leading one. Elias-gamma
+ * spends c + 1 bits on the class whatever the data; here the class gets an
+ * adaptive Huffman code of the context it is coded in:
+ *   longitude  buckets of the classes of the previous longitude and latitude residuals
+ *   latitude   buckets of the classes of the longitude residual of the same
+ *              point and of the previous latitude residual
+ * so a stop or a turn (small or large residuals on both axes) shifts both
+ * codes at once. Class counts start from the Elias-gamma lengths and are
+ * halved once they sum to kDecayThreshold; a context rebuilds its code after
+ * 1, 2, 4, ... symbols and then every kRebuildInterval. The encoder and the
+ * decoder make the same updates, so the stream carries no tables.
+ */
+class ResidualClassModel {
+public:
+    static constexpr int kClasses = 64;
+    static constexpr int kBuckets = 6;                          // classes 0, 1, 2, 3, 4-5, 6+
+    static constexpr int kContexts = 2 * kBuckets * kBuckets;   // longitude, then latitude
+    static constexpr int kMaxCodeLength = 24;
+    static constexpr uint32_t kIncrement = 32;
+    static constexpr uint32_t kDecayThreshold = 1u << 16;
+    static constexpr uint32_t kRebuildInterval = 32;
+
+    ResidualClassModel() { Reset(); }
+
+    void Reset() {
+        static const Context initial = InitialContext();
+        std::fill(contexts_, contexts_ + kContexts, initial);
+        previous_lon_class_ = 0;
+        previous_lat_class_ = 0;
+    }
+
+    static int Class(uint64_t code) { return 63 - __builtin_clzll(code); }
+
+    // Bits of a residual pair (codes >= 1) in the current state
+    int Cost(uint64_t lon_code, uint64_t lat_code) const {
+        int lon_class = Class(lon_code);
+        int lat_class = Class(lat_code);
+        return contexts_[LonContext()].length[lon_class] + lon_class +
+               contexts_[LatContext(lon_class)].length[lat_class] + lat_class;
+    }
+
+    int Encode(uint64_t lon_code, uint64_t lat_code, OutputBitStream* output_bit_stream_ptr) {
+        int lon_class = Class(lon_code);
+        int lat_class = Class(lat_code);
+        int bits = Write(contexts_[LonContext()], lon_class, lon_code, output_bit_stream_ptr);
+        bits += Write(contexts_[LatContext(lon_class)], lat_class, lat_code, output_bit_stream_ptr);
+        previous_lon_class_ = lon_class;
+        previous_lat_class_ = lat_class;
+        return bits;
+    }
+
+    void Decode(InputBitStream* input_bit_stream_ptr, uint64_t& lon_code, uint64_t& lat_code) {
+        int lon_class = Read(contexts_[LonContext()], input_bit_stream_ptr, lon_code);
+        int lat_class = Read(contexts_[LatContext(lon_class)], input_bit_stream_ptr, lat_code);
+        previous_lon_class_ = lon_class;
+        previous_lat_class_ = lat_class;
+    }
+
+private:
+    struct Context {
+        uint32_t count[kClasses];
+        uint32_t code[kClasses];
+        uint8_t length[kClasses];
+        uint8_t symbols[kClasses];                // classes in canonical code order
+        uint8_t length_count[kMaxCodeLength + 1];
+        uint32_t total;
+        uint32_t symbols_seen;
+        uint32_t next_rebuild;
+    };
+
+    Context contexts_[kContexts];
+    int previous_lon_class_;
+    int previous_lat_class_;
+
+    static int Bucket(int c) { return c < 4 ? c : (c < 6 ? 4 : 5); }
+    int LonContext() const { return Bucket(previous_lon_class_) * kBuckets + Bucket(previous_lat_class_); }
+    int LatContext(int lon_class) const {
+        return kBuckets * kBuckets + Bucket(lon_class) * kBuckets + Bucket(previous_lat_class_);
+    }
+
+    static Context InitialContext() {
+        Context context;
+        context.total = 0;
+        for (int c = 0; c < kClasses; ++c) {
+            context.count[c] = c < 10 ? 1024u >> c : 1;  // about 2^-(c + 1), the Elias-gamma class lengths
+            context.total += context.count[c];
+        }
+        context.symbols_seen = 0;
+        context.next_rebuild = 1;
+        Rebuild(context);
+        return context;
+    }
+
+    static int Write(Context& context, int c, uint64_t code, OutputBitStream* output_bit_stream_ptr) {
+        int bits = output_bit_stream_ptr->WriteLong(context.code[c], context.length[c]);
+        bits += output_bit_stream_ptr->WriteLong(code, c);  // the bits below the leading one
+        Update(context, c);
+        return bits;
+    }
+
+    static int Read(Context& context, InputBitStream* input_bit_stream_ptr, uint64_t& code) {
+        // Canonical decoding: codes of one length are consecutive, starting at first
+        int c = 0;
+        uint32_t value = 0, first = 0, index = 0;
+        for (int length = 1; length <= kMaxCodeLength; ++length) {
+            value = (value << 1) | input_bit_stream_ptr->ReadBit();
+            uint32_t n = context.length_count[length];
+            if (value - first < n) {
+                c = context.symbols[index + value - first];
+                break;
+            }
+            index += n;
+            first = (first + n) << 1;
+        }
+        code = c == 0 ? 1 : (1ull << c) | input_bit_stream_ptr->ReadLong(c);
+        Update(context, c);
+        return c;
+    }
+
+    static void Update(Context& context, int c) {
+        context.count[c] += kIncrement;
+        context.total += kIncrement;
+        if (context.total >= kDecayThreshold) {
+            context.total = 0;
+            for (uint32_t& count : context.count) {
+                count = (count + 1) >> 1;
+                context.total += count;
+            }
+        }
+        if (++context.symbols_seen == context.next_rebuild) {
+            context.next_rebuild += std::min(context.symbols_seen, kRebuildInterval);
+            Rebuild(context);
+        }
+    }
+
+    // Huffman code lengths of the counts (two-queue method), flattened until
+    // they fit in kMaxCodeLength, then canonical codes in (length, class) order
+    static void Rebuild(Context& context) {
+        uint32_t weight[kClasses];
+        std::copy(context.count, context.count + kClasses, weight);
+        while (BuildLengths(weight, context.length) > kMaxCodeLength) {
+            for (uint32_t& w : weight) w = (w >> 1) | 1;
+        }
+
+        for (int c = 0; c < kClasses; ++c) context.symbols[c] = static_cast<uint8_t>(c);
+        std::sort(context.symbols, context.symbols + kClasses, [&context](uint8_t a, uint8_t b) {
+            return context.length[a] != context.length[b] ? context.length[a] < context.length[b] : a < b;
+        });
+        std::fill(context.length_count, context.length_count + kMaxCodeLength + 1, 0);
+        uint32_t code = 0;
+        for (int i = 0; i < kClasses; ++i) {
+            int c = context.symbols[i];
+            if (i > 0) code = (code + 1) << (context.length[c] - context.length[context.symbols[i - 1]]);
+            context.code[c] = code;
+            context.length_count[context.length[c]]++;
+        }
+    }
+
+    // Returns the longest code length
+    static int BuildLengths(const uint32_t* weight, uint8_t* length) {
+        static constexpr int kNodes = 2 * kClasses - 1;
+        uint8_t leaves[kClasses];
+        for (int c = 0; c < kClasses; ++c) leaves[c] = static_cast<uint8_t>(c);
+        std::sort(leaves, leaves + kClasses, [weight](uint8_t a, uint8_t b) {
+            return weight[a] != weight[b] ? weight[a] < weight[b] : a > b;
+        });
+
+        // Nodes 0..kClasses-1 are the sorted leaves, then the merged nodes in order
+        uint64_t node_weight[kNodes];
+        int parent[kNodes];
+        for (int i = 0; i < kClasses; ++i) node_weight[i] = weight[leaves[i]];
+        int next_leaf = 0, next_merged = kClasses;
+        for (int merged = kClasses; merged < kNodes; ++merged) {
+            int pair[2];
+            for (int& node : pair) {
+                bool take_leaf = next_leaf < kClasses &&
+                                 (next_merged == merged || node_weight[next_leaf] <= node_weight[next_merged]);
+                node = take_leaf ? next_leaf++ : next_merged++;
+            }
+            node_weight[merged] = node_weight[pair[0]] + node_weight[pair[1]];
+            parent[pair[0]] = merged;
+            parent[pair[1]] = merged;
+        }
+
+        int depth[kNodes];
+        depth[kNodes - 1] = 0;
+        int longest = 0;
+        for (int node = kNodes - 2; node >= 0; --node) {
+            depth[node] = depth[parent[node]] + 1;
+            if (node < kClasses) {
+                length[leaves[node]] = static_cast<uint8_t>(depth[node]);
+                longest = std::max(longest, depth[node]);
+            }
+        }
+        return longest;
+    }
+};
@@ -0,0 +1,131 @@
+#include "algorithm/route_template_library.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void RouteTemplateLibrary::AddTemplate(uint16_t route_id, const std::vector<GpsPoint>& trajectory,
+                                       double min_spacing) {
+    std::vector<TemplatePoint> points;
+    points.reserve(trajectory.size());
+
+    // Template time only accumulates forward steps so it stays monotonic for Advance()
+    double offset = 0;
+    for (size_t i = 0; i < trajectory.size(); ++i) {
+        const GpsPoint& p = trajectory[i];
+        if (i > 0) {
+            int64_t dt = static_cast<int64_t>(p.timestamp) - static_cast<int64_t>(trajectory[i - 1].timestamp);
+            offset += static_cast<double>(std::max<int64_t>(dt, 0));
+        }
+        if (!points.empty()) {
+            double dx = p.longitude - points.back().longitude;
+            double dy = p.latitude - points.back().latitude;
+            // Keep the last point so the template covers the whole trip
+            if (i + 1 < trajectory.size() && std::sqrt(dx * dx + dy * dy) < min_spacing) continue;
+        }
+        points.push_back({p.longitude, p.latitude, offset});
+    }
+
+    if (points.size() < 2) return;
+    templates_[route_id] = std::move(points);
+}
+
+bool RouteTemplateLibrary::HasTemplate(uint16_t route_id) const {
+    return templates_.find(route_id) != templates_.end();
+}
+
+int RouteTemplateLibrary::FindBestTemplate(const GpsPoint& point) const {
+    int best_id = kNoTemplate;
+    double best_distance = kMaxMatchDistance;
+
+    for (const auto& entry : templates_) {
+        const std::vector<TemplatePoint>& points = entry.second;
+        for (size_t i = 0; i + 1 < points.size(); ++i) {
+            double fraction;
+            double distance = ProjectOnSegment(points[i], points[i + 1], point, fraction);
+            // Ties go to the smaller id so the choice does not depend on hash order
+            if (distance < best_distance || (distance == best_distance && entry.first < best_id)) {
+                best_distance = distance;
+                best_id = entry.first;
+            }
+        }
+    }
+    return best_id;
+}
+
+bool RouteTemplateLibrary::Locate(uint16_t route_id, const GpsPoint& point,
+                                  int& segment, double& offset) const {
+    auto it = templates_.find(route_id);
+    if (it == templates_.end()) return false;
+    const std::vector<TemplatePoint>& points = it->second;
+    int segment_count = static_cast<int>(points.size()) - 1;
+
+    // Incremental search around the previous match, full search otherwise
+    int first = 0, last = segment_count - 1;
+    if (segment >= 0) {
+        first = std::max(0, segment - kSearchBehind);
+        last = std::min(segment_count - 1, segment + kSearchAhead);
+    }
+
+    double best_distance = std::numeric_limits<double>::max();
+    for (int i = first; i <= last; ++i) {
+        double fraction;
+        best_distance = std::min(best_distance, ProjectOnSegment(points[i], points[i + 1], point, fraction));
+    }
+
+    // Routes often come back along the same road; take the earliest segment that is
+    // about as close as the best one so the match keeps moving forward
+    int best_segment = -1;
+    double best_fraction = 0;
+    for (int i = first; i <= last && best_segment < 0; ++i) {
+        double fraction;
+        if (ProjectOnSegment(points[i], points[i + 1], point, fraction) <= best_distance + kSnapTolerance) {
+            best_segment = i;
+            best_fraction = fraction;
+        }
+    }
+
+    if (best_segment < 0 || best_distance > kMaxMatchDistance) {
+        segment = -1;
+        return false;
+    }
+
+    segment = best_segment;
+    const TemplatePoint& a = points[best_segment];
+    const TemplatePoint& b = points[best_segment + 1];
+    offset = a.offset + (b.offset - a.offset) * best_fraction;
+    return true;
+}
+
+RouteTemplateLibrary::GpsPoint RouteTemplateLibrary::Advance(
+    uint16_t route_id, int segment, double offset, double dt) const {
+    const std::vector<TemplatePoint>& points = templates_.at(route_id);
+    double target = offset + dt;
+
+    size_t i = static_cast<size_t>(segment);
+    while (i + 2 < points.size() && points[i + 1].offset < target) ++i;
+
+    const TemplatePoint& a = points[i];
+    const TemplatePoint& b = points[i + 1];
+    double span = b.offset - a.offset;
+    double fraction = span > 0 ? (target - a.offset) / span : 1.0;
+    fraction = std::min(1.0, std::max(0.0, fraction));
+
+    return GpsPoint(a.longitude + (b.longitude - a.longitude) * fraction,
+                    a.latitude + (b.latitude - a.latitude) * fraction, 0);
+}
+
+double RouteTemplateLibrary::ProjectOnSegment(const TemplatePoint& a, const TemplatePoint& b,
+                                              const GpsPoint& point, double& fraction) {
+    double sx = b.longitude - a.longitude;
+    double sy = b.latitude - a.latitude;
+    double px = point.longitude - a.longitude;
+    double py = point.latitude - a.latitude;
+    double length_sq = sx * sx + sy * sy;
+
+    fraction = length_sq > 0 ? (px * sx + py * sy) / length_sq : 0;
+    fraction = std::min(1.0, std::max(0.0, fraction));
+
+    double dx = px - sx * fraction;
+    double dy = py - sy * fraction;
+    return std::sqrt(dx * dx + dy * dy);
+}
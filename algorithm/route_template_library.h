@@ -0,0 +1,77 @@
+#pragma once
+
+#include "algorithm/cost_compressor.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Route Template Library
+ *
+ * Compact library of previously reconstructed trajectories, keyed by a
+ * 16-bit route (or vehicle) id. CoST uses it for the route-template
+ * predictor (RT): the current reconstructed position is located on the
+ * template and advanced by the elapsed time.
+ *
+ * The library must hold identical templates on the encoder and the decoder
+ * side, so templates should be built from decompressed (reconstructed)
+ * trajectories rather than raw GPS fixes.
+ */
+class RouteTemplateLibrary {
+public:
+    using GpsPoint = CoSTCompressor::GpsPoint;
+
+    static constexpr int kNoTemplate = -1;
+
+    /**
+     * Add (or replace) the template of a route
+     * @param route_id route or vehicle id stored in the stream header
+     * @param trajectory reconstructed trajectory of a previous trip
+     * @param min_spacing points closer than this (degrees) to the previously
+     *        kept point are dropped to keep the template compact
+     */
+    void AddTemplate(uint16_t route_id, const std::vector<GpsPoint>& trajectory,
+                     double min_spacing = 0);
+
+    bool HasTemplate(uint16_t route_id) const;
+
+    /**
+     * Pick the template whose path passes closest to the given point
+     * @return route id, or kNoTemplate if no template is within kMaxMatchDistance
+     */
+    int FindBestTemplate(const GpsPoint& point) const;
+
+    /**
+     * Locate a reconstructed point on a template
+     * @param route_id template to search
+     * @param segment in: segment matched for the previous point, or -1 for a
+     *        full search; out: segment matched for this point
+     * @param offset out: template time (seconds) of the matched position
+     * @return false if the point is too far from the template
+     */
+    bool Locate(uint16_t route_id, const GpsPoint& point, int& segment, double& offset) const;
+
+    /**
+     * Template position reached after advancing from (segment, offset) by dt seconds
+     */
+    GpsPoint Advance(uint16_t route_id, int segment, double offset, double dt) const;
+
+    size_t size() const { return templates_.size(); }
+
+private:
+    struct TemplatePoint {
+        double longitude;
+        double latitude;
+        double offset;  // seconds since the template start
+    };
+
+    static constexpr double kMaxMatchDistance = 0.005;  // ~500 m
+    static constexpr double kSnapTolerance = 1e-4;      // ~10 m
+    static constexpr int kSearchBehind = 2;
+    static constexpr int kSearchAhead = 64;
+
+    std::unordered_map<uint16_t, std::vector<TemplatePoint>> templates_;
+
+    static double ProjectOnSegment(const TemplatePoint& a, const TemplatePoint& b,
+                                   const GpsPoint& point, double& fraction);
+};
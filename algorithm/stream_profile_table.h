@@ -0,0 +1,84 @@
+#pragma once
+
+#include "algorithm/cost_compressor.h"
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+
+/**
+ * Stream profile: the header parameters of a fleet or region
+ *
+ * A stream compressed with a profile (CoSTCompressor::SetStreamProfile) starts
+ * with the compact header: the profile id instead of epsilon and the window
+ * settings, and the first point as a residual against the profile origin
+ * instead of three raw 64-bit words. On trips of a few dozen points this takes
+ * the header from about 290 bits to a few dozen.
+ */
+struct StreamProfile {
+    using GpsPoint = CoSTCompressor::GpsPoint;
+
+    double epsilon = 0;  // constructor epsilon of the compressor (0 = lossless)
+    bool epsilon_in_meters = false;  // Options::epsilon_in_meters
+    int evaluation_window = 96;
+    bool use_time_window = false;
+    uint32_t time_window_seconds = 60;
+    // Regional origin: the first position is coded on the quantization grid
+    // relative to it, the first timestamp relative to origin.timestamp
+    GpsPoint origin;
+
+    StreamProfile() {}
+    StreamProfile(double eps, const GpsPoint& origin_point) : epsilon(eps), origin(origin_point) {}
+};
+
+/**
+ * Models shared by the encoder and the decoder: stream profiles by 8-bit id and
+ * predictor priors (CoSTCompressor::SetPredictorPrior) by 16-bit fleet or
+ * vehicle id. The decoder needs the same table as the encoder
+ */
+class StreamProfileTable {
+public:
+    using PredictorPrior = CoSTCompressor::PredictorPrior;
+
+    static constexpr int kMaxProfileId = 255;
+    static constexpr int kMaxPriorId = 65535;
+
+    // Add (or replace) a profile
+    void AddProfile(uint8_t profile_id, const StreamProfile& profile) { profiles_[profile_id] = profile; }
+
+    bool HasProfile(int profile_id) const {
+        return profile_id >= 0 && profile_id <= kMaxProfileId && profiles_.count(static_cast<uint8_t>(profile_id)) != 0;
+    }
+
+    const StreamProfile& GetProfile(int profile_id) const {
+        if (!HasProfile(profile_id)) throw std::invalid_argument("CoST: unknown stream profile");
+        return profiles_.at(static_cast<uint8_t>(profile_id));
+    }
+
+    // Add (or replace) a prior, e.g. CoSTCompressor::GetPredictorPrior of the previous trip
+    void AddPrior(uint16_t prior_id, const PredictorPrior& prior) {
+        for (int frequency : prior.predictor_frequency) {
+            if (frequency < 0 || frequency > CoSTCompressor::kMaxPriorFrequency) {
+                throw std::invalid_argument("CoST: prior frequencies must be in [0, 100]");
+            }
+        }
+        if (prior.initial_mode < CoSTCompressor::MODE_MULTI_PREDICTOR || prior.initial_mode > CoSTCompressor::MODE_SEGMENT) {
+            throw std::invalid_argument("CoST: invalid prior mode");
+        }
+        priors_[prior_id] = prior;
+    }
+
+    bool HasPrior(int prior_id) const {
+        return prior_id >= 0 && prior_id <= kMaxPriorId && priors_.count(static_cast<uint16_t>(prior_id)) != 0;
+    }
+
+    const PredictorPrior& GetPrior(int prior_id) const {
+        if (!HasPrior(prior_id)) throw std::invalid_argument("CoST: unknown predictor prior");
+        return priors_.at(static_cast<uint16_t>(prior_id));
+    }
+
+    size_t size() const { return profiles_.size(); }
+
+private:
+    std::unordered_map<uint8_t, StreamProfile> profiles_;
+    std::unordered_map<uint16_t, PredictorPrior> priors_;
+};
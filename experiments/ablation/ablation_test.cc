@@ -12,6 +12,11 @@
 #include "baselines/trajcompress/trajcompress_sp_compressor.h"
 #include "baselines/trajcompress/trajcompress_sp_adaptive_compressor.h"
 #include "algorithm/cost_compressor.h"
+#include "algorithm/net_cost_compressor.h"
+#include "algorithm/precision_map.h"
+#include "algorithm/reorder_buffer.h"
+#include "algorithm/route_template_library.h"
+#include "algorithm/stream_profile_table.h"
 #include "baselines/serf/serf_qt_compressor.h"
 #include "baselines/serf/serf_qt_linear_compressor.h"
 #include "baselines/serf/serf_qt_curve_compressor.h"
@@ -24,7 +29,11 @@
 #include <vector>
 #include <cmath>
 #include <chrono>
+#include <filesystem>
+#include <functional>
 #include <iomanip>
+#include <map>
+#include <random>
 
 using GpsPoint = TrajCompressSPCompressor::GpsPoint;
 using AdaptiveGpsPoint = TrajCompressSPAdaptiveCompressor::GpsPoint;
@@ -1821,6 +1830,845 @@ void TestAllDatasetsAndGenerateSummary(double epsilon) {
     }
 }
 
+// East and north error in meters on the WGS84 ellipsoid (radii of curvature at the original point)
+void CalculateErrorMeters(const CoSTGpsPoint& original, const CoSTGpsPoint& decompressed,
+                          double& east, double& north) {
+    const double kSemiMajorAxis = 6378137.0;
+    const double kFlattening = 1 / 298.257223563;
+    const double kRadiansPerDegree = std::acos(-1.0) / 180;
+    double e2 = kFlattening * (2 - kFlattening);
+    double phi = original.latitude * kRadiansPerDegree;
+    double w = 1 - e2 * std::sin(phi) * std::sin(phi);
+    double meridian_radius = kSemiMajorAxis * (1 - e2) / (w * std::sqrt(w));
+    double normal_radius = kSemiMajorAxis / std::sqrt(w);
+    east = std::fabs(original.longitude - decompressed.longitude) * kRadiansPerDegree * normal_radius * std::cos(phi);
+    north = std::fabs(original.latitude - decompressed.latitude) * kRadiansPerDegree * meridian_radius;
+}
+
+// One CoST round trip of the option modes below
+struct RoundTripResult {
+    std::vector<CoSTGpsPoint> decoded;
+    double bits_per_point = 0;
+    double decode_us_per_point = 0;
+    double max_error = 0;         // per axis: degrees, or meters with Options::epsilon_in_meters
+    int precision_switches = 0;
+    int segment_points = 0;
+    bool passed = false;          // every point decoded within its bound, timestamps intact
+};
+
+// Compress, decode and check each point against epsilon, or against the
+// epsilon of its cell in precision_map
+RoundTripResult RoundTrip(const std::vector<CoSTGpsPoint>& gps_data, double epsilon,
+                          const CoSTCompressor::Options& options, const PrecisionMap* precision_map = nullptr) {
+    RoundTripResult result;
+    CoSTCompressor compressor(gps_data.size(), epsilon, options);
+    if (precision_map != nullptr) compressor.SetPrecisionMap(precision_map);
+    for (const auto& point : gps_data) {
+        compressor.AddGpsPoint(point);
+    }
+    compressor.Close();
+    result.bits_per_point = static_cast<double>(compressor.GetCompressedSizeInBits()) / gps_data.size();
+    result.precision_switches = compressor.GetStats().precision_switches;
+    result.segment_points = compressor.GetStats().segment_points;
+    
+    Array<uint8_t> compressed = compressor.GetCompressedData();
+    result.decoded.reserve(gps_data.size());
+    auto decode_start = std::chrono::steady_clock::now();
+    CoSTDecompressor decompressor(compressed.begin(), compressed.length());
+    CoSTGpsPoint point;
+    while (result.decoded.size() < gps_data.size() && decompressor.ReadNextPoint(point)) {
+        result.decoded.push_back(point);
+    }
+    auto decode_end = std::chrono::steady_clock::now();
+    result.decode_us_per_point = std::chrono::duration<double, std::micro>(decode_end - decode_start).count() /
+                                 gps_data.size();
+    
+    result.passed = result.decoded.size() == gps_data.size();
+    for (size_t i = 0; i < result.decoded.size(); ++i) {
+        const CoSTGpsPoint& original = gps_data[i];
+        double error;
+        if (options.epsilon_in_meters) {
+            double east, north;
+            CalculateErrorMeters(original, result.decoded[i], east, north);
+            error = std::max(east, north);
+        } else {
+            error = std::max(std::fabs(original.longitude - result.decoded[i].longitude),
+                             std::fabs(original.latitude - result.decoded[i].latitude));
+        }
+        double bound = epsilon;
+        if (precision_map != nullptr) {
+            int level = precision_map->Lookup(original.longitude, original.latitude);
+            if (level != 0) bound = precision_map->GetEpsilons()[level - 1];
+        }
+        result.max_error = std::max(result.max_error, error);
+        result.passed &= error <= bound && result.decoded[i].timestamp == original.timestamp;
+    }
+    return result;
+}
+
+// Check decoded points against gps_data point by point (error per axis within
+// epsilon, timestamps intact); sets max_error and passed of result
+void CheckDecoded(const std::vector<CoSTGpsPoint>& gps_data, double epsilon, RoundTripResult& result) {
+    result.max_error = 0;
+    result.passed = result.decoded.size() == gps_data.size();
+    for (size_t i = 0; i < std::min(result.decoded.size(), gps_data.size()); ++i) {
+        double error = std::max(std::fabs(gps_data[i].longitude - result.decoded[i].longitude),
+                                std::fabs(gps_data[i].latitude - result.decoded[i].latitude));
+        result.max_error = std::max(result.max_error, error);
+        result.passed &= error <= epsilon && result.decoded[i].timestamp == gps_data[i].timestamp;
+    }
+}
+
+// Decode the closed stream of compressor, which holds gps_data, and check it
+RoundTripResult DecodeStream(const CoSTCompressor& compressor, const std::vector<CoSTGpsPoint>& gps_data,
+                             double epsilon, const RouteTemplateLibrary* route_templates = nullptr,
+                             const StreamProfileTable* stream_profiles = nullptr) {
+    RoundTripResult result;
+    result.bits_per_point = static_cast<double>(compressor.GetCompressedSizeInBits()) / gps_data.size();
+    result.segment_points = compressor.GetStats().segment_points;
+    ArrayView<const uint8_t> compressed = compressor.GetCompressedView();
+    CoSTDecompressor decompressor(compressed.begin(), compressed.length(), route_templates, stream_profiles);
+    CoSTGpsPoint point;
+    while (result.decoded.size() < gps_data.size() && decompressor.ReadNextPoint(point)) {
+        result.decoded.push_back(point);
+    }
+    CheckDecoded(gps_data, epsilon, result);
+    return result;
+}
+
+void PrintModeBanner(const std::string& title) {
+    std::cout << "\n" << std::string(100, '=') << std::endl;
+    std::cout << title << std::endl;
+    std::cout << std::string(100, '=') << std::endl;
+}
+
+// Run test on every dataset with at least two points; true if every run passed
+bool RunOnAllDatasets(const std::function<bool(const DatasetConfig&, const std::vector<CoSTGpsPoint>&)>& test) {
+    bool all_passed = true;
+    for (const DatasetConfig& dataset : GetAllDatasets()) {
+        auto gps_data = LoadGpsDataFromCSV(dataset.path);
+        if (gps_data.size() < 2) continue;
+        all_passed &= test(dataset, gps_data);
+    }
+    return all_passed;
+}
+
+// Metric bound: CoST with epsilon in meters (Options::epsilon_in_meters) against
+// the degree epsilon that meets the same bound at any latitude
+void MetricBoundTest(double epsilon_meters) {
+    std::ostringstream title;
+    title << "Metric bound: epsilon = " << std::fixed << std::setprecision(2) << epsilon_meters
+          << " m per axis (distance <= " << epsilon_meters * std::sqrt(2.0) << " m)";
+    PrintModeBanner(title.str());
+    std::cout << std::left << std::setw(44) << "Dataset" << std::setw(10) << "Bound" << std::right
+              << std::setw(10) << "Bits/pt" << std::setw(12) << "Max east" << std::setw(12) << "Max north"
+              << std::setw(12) << "Max dist" << "   Check" << std::endl;
+    
+    bool all_passed = RunOnAllDatasets([&](const DatasetConfig& dataset, const std::vector<CoSTGpsPoint>& gps_data) {
+        bool passed = true;
+        for (bool metric : {false, true}) {
+            CoSTCompressor::Options options;
+            options.epsilon_in_meters = metric;
+            double epsilon = metric ? epsilon_meters : epsilon_meters / CoSTCompressor::kMetersPerDegree;
+            RoundTripResult result = RoundTrip(gps_data, epsilon, options);
+            
+            double max_east = 0, max_north = 0, max_distance = 0;
+            for (size_t i = 0; i < result.decoded.size(); ++i) {
+                double east, north;
+                CalculateErrorMeters(gps_data[i], result.decoded[i], east, north);
+                max_east = std::max(max_east, east);
+                max_north = std::max(max_north, north);
+                max_distance = std::max(max_distance, std::sqrt(east * east + north * north));
+            }
+            bool run_passed = result.passed && max_east <= epsilon_meters && max_north <= epsilon_meters;
+            passed &= run_passed;
+            std::cout << std::left << std::setw(44) << dataset.name << std::setw(10) << (metric ? "meters" : "degrees")
+                      << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(10) << result.bits_per_point
+                      << std::setw(12) << max_east << std::setw(12) << max_north << std::setw(12) << max_distance
+                      << "   " << (run_passed ? "OK" : "FAIL") << std::endl;
+        }
+        return passed;
+    });
+    std::cout << (all_passed ? "✅ all errors within the metric bound" : "❌ metric bound exceeded") << std::endl;
+}
+
+// Precision map: epsilon / 10 at the sites where vehicles stop (cells of about
+// 500 m with at least 20 stationary fixes) and epsilon elsewhere, against both
+// epsilons everywhere. The map goes through a file and PrecisionMap::LoadFromFile
+void PrecisionMapTest(double epsilon) {
+    const double kSiteCellSize = 0.005;
+    const int kMinSiteFixes = 20;
+    double site_epsilon = epsilon / 10;
+    std::string map_path = (std::filesystem::temp_directory_path() / "cost_precision_map.txt").string();
+    
+    std::ostringstream title;
+    title << "Precision map: epsilon = " << epsilon << ", " << site_epsilon << " at stop sites";
+    PrintModeBanner(title.str());
+    std::cout << std::left << std::setw(44) << "Dataset" << std::setw(14) << "Epsilon" << std::right
+              << std::setw(10) << "Bits/pt" << std::setw(10) << "At sites" << std::setw(10) << "Switches"
+              << std::setw(14) << "Max err site" << std::setw(14) << "Max err else" << "   Check" << std::endl;
+    
+    bool all_passed = RunOnAllDatasets([&](const DatasetConfig& dataset, const std::vector<CoSTGpsPoint>& gps_data) {
+        double min_lon = gps_data[0].longitude, max_lon = min_lon, min_lat = gps_data[0].latitude, max_lat = min_lat;
+        for (const auto& point : gps_data) {
+            min_lon = std::min(min_lon, point.longitude);
+            max_lon = std::max(max_lon, point.longitude);
+            min_lat = std::min(min_lat, point.latitude);
+            max_lat = std::max(max_lat, point.latitude);
+        }
+        double cell_size = kSiteCellSize;
+        int columns, rows;
+        while (true) {
+            columns = static_cast<int>((max_lon - min_lon) / cell_size) + 1;
+            rows = static_cast<int>((max_lat - min_lat) / cell_size) + 1;
+            if (static_cast<int64_t>(columns) * rows <= PrecisionMap::kMaxCells) break;
+            cell_size *= 2;
+        }
+        std::map<std::pair<int, int>, int> stationary_fixes;
+        for (size_t i = 1; i < gps_data.size(); ++i) {
+            if (std::fabs(gps_data[i].longitude - gps_data[i - 1].longitude) <= 2 * epsilon &&
+                std::fabs(gps_data[i].latitude - gps_data[i - 1].latitude) <= 2 * epsilon) {
+                stationary_fixes[{static_cast<int>((gps_data[i].longitude - min_lon) / cell_size),
+                                  static_cast<int>((gps_data[i].latitude - min_lat) / cell_size)}]++;
+            }
+        }
+        {
+            std::ofstream map_file(map_path);
+            map_file << "# stop sites of " << dataset.name << std::endl << std::setprecision(17)
+                     << "grid " << min_lon << " " << min_lat << " " << cell_size << " " << columns << " " << rows << std::endl;
+            for (const auto& cell : stationary_fixes) {
+                if (cell.second >= kMinSiteFixes) {
+                    map_file << "cell " << cell.first.first << " " << cell.first.second << " " << site_epsilon << std::endl;
+                }
+            }
+        }
+        PrecisionMap precision_map = PrecisionMap::LoadFromFile(map_path);
+        
+        bool passed = true;
+        for (int run = 0; run < 3; ++run) {
+            double run_epsilon = run == 0 ? site_epsilon : epsilon;
+            RoundTripResult result = RoundTrip(gps_data, run_epsilon, CoSTCompressor::Options(),
+                                               run == 2 ? &precision_map : nullptr);
+            double max_site_error = 0, max_other_error = 0;
+            size_t site_points = 0;
+            for (size_t i = 0; i < result.decoded.size(); ++i) {
+                const CoSTGpsPoint& original = gps_data[i];
+                double error = std::max(std::fabs(original.longitude - result.decoded[i].longitude),
+                                        std::fabs(original.latitude - result.decoded[i].latitude));
+                if (precision_map.Lookup(original.longitude, original.latitude) != 0) {
+                    site_points++;
+                    max_site_error = std::max(max_site_error, error);
+                } else {
+                    max_other_error = std::max(max_other_error, error);
+                }
+            }
+            passed &= result.passed;
+            std::cout << std::left << std::setw(44) << dataset.name
+                      << std::setw(14) << (run == 0 ? "tight" : run == 1 ? "uniform" : "map")
+                      << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(10) << result.bits_per_point
+                      << std::setw(9) << std::setprecision(1) << 100.0 * site_points / gps_data.size() << "%"
+                      << std::setw(10) << result.precision_switches
+                      << std::scientific << std::setprecision(2)
+                      << std::setw(14) << max_site_error << std::setw(14) << max_other_error
+                      << "   " << (result.passed ? "OK" : "FAIL") << std::defaultfloat << std::endl;
+        }
+        return passed;
+    });
+    std::filesystem::remove(map_path);
+    std::cout << (all_passed ? "✅ all errors within the precision map" : "❌ precision map bound exceeded") << std::endl;
+}
+
+// Adaptive residuals: Elias-gamma residual classes against the context-adaptive
+// class codes of Options::adaptive_residuals, at epsilon and epsilon / 10
+void AdaptiveResidualTest(double epsilon) {
+    std::ostringstream title;
+    title << "Adaptive residuals: epsilon = " << epsilon << " and " << epsilon / 10;
+    PrintModeBanner(title.str());
+    std::cout << std::left << std::setw(44) << "Dataset" << std::setw(12) << "Epsilon" << std::right
+              << std::setw(14) << "Elias-gamma" << std::setw(12) << "Adaptive" << std::setw(10) << "Saving"
+              << std::setw(14) << "Max error" << "   Check" << std::endl;
+    
+    bool all_passed = RunOnAllDatasets([&](const DatasetConfig& dataset, const std::vector<CoSTGpsPoint>& gps_data) {
+        bool passed = true;
+        for (double run_epsilon : {epsilon, epsilon / 10}) {
+            CoSTCompressor::Options options;
+            RoundTripResult gamma = RoundTrip(gps_data, run_epsilon, options);
+            options.adaptive_residuals = true;
+            RoundTripResult adaptive = RoundTrip(gps_data, run_epsilon, options);
+            bool run_passed = gamma.passed && adaptive.passed;
+            passed &= run_passed;
+            std::cout << std::left << std::setw(44) << dataset.name << std::setw(12) << std::scientific
+                      << std::setprecision(0) << run_epsilon << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(14) << gamma.bits_per_point << std::setw(12) << adaptive.bits_per_point
+                      << std::setw(9) << std::setprecision(1)
+                      << 100 * (gamma.bits_per_point - adaptive.bits_per_point) / gamma.bits_per_point << "%"
+                      << std::scientific << std::setprecision(2) << std::setw(14) << adaptive.max_error
+                      << "   " << (run_passed ? "OK" : "FAIL") << std::defaultfloat << std::endl;
+        }
+        return passed;
+    });
+    std::cout << (all_passed ? "✅ all errors within epsilon" : "❌ epsilon exceeded") << std::endl;
+}
+
+// Block residual classes: Elias-gamma against the post-office classes of
+// Options::block_residual_classes at epsilon * 10, epsilon and epsilon / 10,
+// with the decoding time of each
+void BlockClassTest(double epsilon) {
+    std::ostringstream title;
+    title << "Block residual classes: epsilon = " << epsilon * 10 << ", " << epsilon << " and " << epsilon / 10;
+    PrintModeBanner(title.str());
+    std::cout << std::left << std::setw(44) << "Dataset" << std::setw(12) << "Epsilon" << std::right
+              << std::setw(14) << "Elias-gamma" << std::setw(12) << "Block" << std::setw(10) << "Saving"
+              << std::setw(14) << "Decode us/pt" << std::setw(12) << "Block us/pt" << "   Check" << std::endl;
+    
+    bool all_passed = RunOnAllDatasets([&](const DatasetConfig& dataset, const std::vector<CoSTGpsPoint>& gps_data) {
+        bool passed = true;
+        for (double run_epsilon : {epsilon * 10, epsilon, epsilon / 10}) {
+            CoSTCompressor::Options options;
+            RoundTripResult gamma = RoundTrip(gps_data, run_epsilon, options);
+            options.block_residual_classes = true;
+            RoundTripResult block = RoundTrip(gps_data, run_epsilon, options);
+            bool run_passed = gamma.passed && block.passed;
+            passed &= run_passed;
+            std::cout << std::left << std::setw(44) << dataset.name << std::setw(12) << std::scientific
+                      << std::setprecision(0) << run_epsilon << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(14) << gamma.bits_per_point << std::setw(12) << block.bits_per_point
+                      << std::setw(9) << std::setprecision(1)
+                      << 100 * (gamma.bits_per_point - block.bits_per_point) / gamma.bits_per_point << "%"
+                      << std::setprecision(3) << std::setw(14) << gamma.decode_us_per_point
+                      << std::setw(12) << block.decode_us_per_point
+                      << "   " << (run_passed ? "OK" : "FAIL") << std::defaultfloat << std::endl;
+        }
+        return passed;
+    });
+    std::cout << (all_passed ? "✅ all errors within epsilon" : "❌ epsilon exceeded") << std::endl;
+}
+
+// Segment mode: the default modes against Options::segment_mode at epsilon,
+// epsilon * 10 and epsilon * 100, with the share of points in segment tokens
+void SegmentModeTest(double epsilon) {
+    std::ostringstream title;
+    title << "Segment mode: epsilon = " << epsilon << ", " << epsilon * 10 << " and " << epsilon * 100;
+    PrintModeBanner(title.str());
+    std::cout << std::left << std::setw(44) << "Dataset" << std::setw(12) << "Epsilon" << std::right
+              << std::setw(10) << "Default" << std::setw(12) << "Segments" << std::setw(10) << "Saving"
+              << std::setw(12) << "Seg points" << std::setw(14) << "Max error" << "   Check" << std::endl;
+    
+    bool all_passed = RunOnAllDatasets([&](const DatasetConfig& dataset, const std::vector<CoSTGpsPoint>& gps_data) {
+        bool passed = true;
+        for (double run_epsilon : {epsilon, epsilon * 10, epsilon * 100}) {
+            CoSTCompressor::Options options;
+            RoundTripResult plain = RoundTrip(gps_data, run_epsilon, options);
+            options.segment_mode = true;
+            RoundTripResult segments = RoundTrip(gps_data, run_epsilon, options);
+            bool run_passed = plain.passed && segments.passed;
+            passed &= run_passed;
+            std::cout << std::left << std::setw(44) << dataset.name << std::setw(12) << std::scientific
+                      << std::setprecision(0) << run_epsilon << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(10) << plain.bits_per_point << std::setw(12) << segments.bits_per_point
+                      << std::setw(9) << std::setprecision(1)
+                      << 100 * (plain.bits_per_point - segments.bits_per_point) / plain.bits_per_point << "%"
+                      << std::setw(11) << 100.0 * segments.segment_points / gps_data.size() << "%"
+                      << std::scientific << std::setprecision(2) << std::setw(14) << segments.max_error
+                      << "   " << (run_passed ? "OK" : "FAIL") << std::defaultfloat << std::endl;
+        }
+        return passed;
+    });
+    std::cout << (all_passed ? "✅ all errors within epsilon" : "❌ epsilon exceeded") << std::endl;
+}
+
+// NetCoST: one packet per point and one per batch of 8 and 32 points, decoded
+// packet by packet, against the whole stream; packets count in whole bytes
+void NetCoSTTest(double epsilon) {
+    std::ostringstream title;
+    title << "NetCoST packets: epsilon = " << epsilon << ", batches of 1, 8 and 32 points";
+    PrintModeBanner(title.str());
+    std::cout << std::left << std::setw(44) << "Dataset" << std::setw(8) << "Batch" << std::right
+              << std::setw(10) << "Stream" << std::setw(12) << "Packets" << std::setw(10) << "Overhead"
+              << std::setw(14) << "Max error" << "   Check" << std::endl;
+    
+    bool all_passed = RunOnAllDatasets([&](const DatasetConfig& dataset, const std::vector<CoSTGpsPoint>& gps_data) {
+        RoundTripResult stream = RoundTrip(gps_data, epsilon, CoSTCompressor::Options());
+        bool passed = stream.passed;
+        for (int batch_size : {1, 8, 32}) {
+            NetCoSTCompressor compressor(epsilon, batch_size);
+            NetCoSTDecompressor decompressor;
+            RoundTripResult result;
+            std::vector<CoSTGpsPoint> points(batch_size);
+            size_t bytes = 0;
+            auto decode = [&](const Array<uint8_t>& packet, int point_count) {
+                bytes += packet.length();
+                int decoded = decompressor.Decompress(packet, point_count, points.data());
+                result.decoded.insert(result.decoded.end(), points.begin(), points.begin() + std::max(decoded, 0));
+            };
+            for (const auto& point : gps_data) {
+                Array<uint8_t> packet = compressor.Compress(point);
+                if (packet.length() > 0) decode(packet, batch_size);
+            }
+            Array<uint8_t> packet = compressor.Flush();
+            if (packet.length() > 0) decode(packet, static_cast<int>(gps_data.size() % batch_size));
+            result.bits_per_point = 8.0 * bytes / gps_data.size();
+            CheckDecoded(gps_data, epsilon, result);
+            passed &= result.passed;
+            std::cout << std::left << std::setw(44) << dataset.name << std::setw(8) << batch_size
+                      << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(10) << stream.bits_per_point << std::setw(12) << result.bits_per_point
+                      << std::setw(9) << std::setprecision(1)
+                      << 100 * (result.bits_per_point - stream.bits_per_point) / stream.bits_per_point << "%"
+                      << std::scientific << std::setprecision(2) << std::setw(14) << result.max_error
+                      << "   " << (result.passed ? "OK" : "FAIL") << std::defaultfloat << std::endl;
+        }
+        return passed;
+    });
+    std::cout << (all_passed ? "✅ all packets decoded within epsilon" : "❌ packet decoding failed") << std::endl;
+}
+
+// Framing under loss: one frame per point with the default FramingOptions,
+// dropping 1% and 5% of the frames (fixed seed, never resent). A frame must
+// decode exactly when no frame since its keyframe was lost, and the receiver
+// must count every gap it saw as lost and every undecodable frame as dropped
+void FramingLossTest(double epsilon) {
+    const unsigned kLossSeed = 1;
+    FramingOptions framing;
+    
+    std::ostringstream title;
+    title << "Framing under loss: epsilon = " << epsilon << ", keyframe every " << framing.keyframe_interval
+          << " frames, 1% and 5% loss";
+    PrintModeBanner(title.str());
+    std::cout << std::left << std::setw(44) << "Dataset" << std::setw(8) << "Loss" << std::right
+              << std::setw(10) << "Bits/pt" << std::setw(10) << "Decoded" << std::setw(10) << "Expected"
+              << std::setw(8) << "Lost" << std::setw(10) << "Dropped" << std::setw(14) << "Max error"
+              << "   Check" << std::endl;
+    
+    bool all_passed = RunOnAllDatasets([&](const DatasetConfig& dataset, const std::vector<CoSTGpsPoint>& gps_data) {
+        bool passed = true;
+        for (int loss_percent : {1, 5}) {
+            FramedNetCoSTCompressor compressor(epsilon, framing);
+            FramedNetCoSTDecompressor decompressor(framing.sequence_bits);
+            std::mt19937 rng(kLossSeed);
+            size_t bytes = 0;
+            int decoded = 0, expected_decoded = 0, expected_lost = 0, expected_dropped = 0;
+            int64_t last_received = -1, last_lost = -1;
+            double max_error = 0;
+            bool run_passed = true;
+            for (size_t i = 0; i < gps_data.size(); ++i) {
+                Array<uint8_t> frame = compressor.Compress(gps_data[i]);
+                bytes += frame.length();
+                if (static_cast<int>(rng() % 100) < loss_percent) {
+                    last_lost = i;
+                    continue;
+                }
+                // Gaps are counted when the next frame arrives; a frame decodes
+                // if its keyframe and every frame after it arrived
+                if (last_received >= 0) expected_lost += static_cast<int>(i - last_received - 1);
+                last_received = i;
+                bool decodable = last_lost < static_cast<int64_t>(i - i % framing.keyframe_interval);
+                if (decodable) {
+                    expected_decoded++;
+                } else {
+                    expected_dropped++;
+                }
+                
+                CoSTGpsPoint point;
+                bool ok = decompressor.Decompress(frame, point);
+                run_passed &= ok == decodable;
+                if (!ok) continue;
+                decoded++;
+                double error = std::max(std::fabs(gps_data[i].longitude - point.longitude),
+                                        std::fabs(gps_data[i].latitude - point.latitude));
+                max_error = std::max(max_error, error);
+                run_passed &= error <= epsilon && point.timestamp == gps_data[i].timestamp;
+            }
+            run_passed &= decompressor.GetLostFrames() == expected_lost &&
+                          decompressor.GetDroppedFrames() == expected_dropped;
+            passed &= run_passed;
+            std::cout << std::left << std::setw(44) << dataset.name << std::setw(8)
+                      << (std::to_string(loss_percent) + "%") << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(10) << 8.0 * bytes / gps_data.size()
+                      << std::setw(10) << decoded << std::setw(10) << expected_decoded
+                      << std::setw(8) << decompressor.GetLostFrames() << std::setw(10) << decompressor.GetDroppedFrames()
+                      << std::scientific << std::setprecision(2) << std::setw(14) << max_error
+                      << "   " << (run_passed ? "OK" : "FAIL") << std::defaultfloat << std::endl;
+        }
+        return passed;
+    });
+    std::cout << (all_passed ? "✅ every decodable frame decoded, losses counted" : "❌ framing check failed") << std::endl;
+}
+
+// Reset: the second half of each dataset after the first half, on a compressor
+// reused through Reset(), Reset(block_size, epsilon * 10) (keeps the stationary
+// runs of the constructor options) and Reset(block_size, epsilon, options)
+// (segment mode); each stream must match a fresh compressor byte for byte
+void ResetTest(double epsilon) {
+    std::ostringstream title;
+    title << "Reset: epsilon = " << epsilon << ", second half of each dataset on a reused compressor";
+    PrintModeBanner(title.str());
+    std::cout << std::left << std::setw(44) << "Dataset" << std::setw(24) << "Reset" << std::right
+              << std::setw(10) << "Bits/pt" << std::setw(12) << "Same bytes" << std::setw(14) << "Max error"
+              << "   Check" << std::endl;
+    
+    bool all_passed = RunOnAllDatasets([&](const DatasetConfig& dataset, const std::vector<CoSTGpsPoint>& gps_data) {
+        size_t half = gps_data.size() / 2;
+        std::vector<CoSTGpsPoint> first(gps_data.begin(), gps_data.begin() + half);
+        std::vector<CoSTGpsPoint> second(gps_data.begin() + half, gps_data.begin() + 2 * half);
+        CoSTCompressor::Options runs;
+        runs.stationary_runs = true;
+        CoSTCompressor::Options segments;
+        segments.segment_mode = true;
+        
+        CoSTCompressor compressor(first.size(), epsilon, runs);
+        for (const auto& point : first) compressor.AddGpsPoint(point);
+        compressor.Close();
+        
+        bool passed = true;
+        for (int run = 0; run < 3; ++run) {
+            double run_epsilon = run == 1 ? epsilon * 10 : epsilon;
+            const CoSTCompressor::Options& options = run == 2 ? segments : runs;
+            if (run == 0) {
+                compressor.Reset();
+            } else if (run == 1) {
+                compressor.Reset(second.size(), run_epsilon);
+            } else {
+                compressor.Reset(second.size(), run_epsilon, options);
+            }
+            for (const auto& point : second) compressor.AddGpsPoint(point);
+            compressor.Close();
+            RoundTripResult result = DecodeStream(compressor, second, run_epsilon);
+            
+            CoSTCompressor fresh(second.size(), run_epsilon, options);
+            for (const auto& point : second) fresh.AddGpsPoint(point);
+            fresh.Close();
+            ArrayView<const uint8_t> reused = compressor.GetCompressedView();
+            ArrayView<const uint8_t> expected = fresh.GetCompressedView();
+            bool same = reused.length() == expected.length() &&
+                        std::equal(reused.begin(), reused.end(), expected.begin());
+            bool run_passed = result.passed && same;
+            passed &= run_passed;
+            std::cout << std::left << std::setw(44) << dataset.name
+                      << std::setw(24) << (run == 0 ? "Reset()" : run == 1 ? "Reset(block, eps * 10)" : "Reset(block, eps, opts)")
+                      << std::right << std::fixed << std::setprecision(3) << std::setw(10) << result.bits_per_point
+                      << std::setw(12) << (same ? "yes" : "no")
+                      << std::scientific << std::setprecision(2) << std::setw(14) << result.max_error
+                      << "   " << (run_passed ? "OK" : "FAIL") << std::defaultfloat << std::endl;
+        }
+        return passed;
+    });
+    std::cout << (all_passed ? "✅ reused compressors match fresh ones" : "❌ reset check failed") << std::endl;
+}
+
+// Reorder buffer: each dataset with timestamps made increasing (gaps clamped to
+// [1, lateness] seconds so the order is unambiguous), then delivered with every
+// seventh pair swapped, every fiftieth point repeated and every 97th followed by
+// a glitch two hours ahead. The buffer must restore the stream exactly and
+// count each disturbance
+void ReorderTest(double epsilon) {
+    ReorderOptions reorder;
+    
+    std::ostringstream title;
+    title << "Reorder buffer: epsilon = " << epsilon << ", lateness " << reorder.lateness_seconds
+          << " s, max lead " << reorder.max_lead_seconds << " s";
+    PrintModeBanner(title.str());
+    std::cout << std::left << std::setw(44) << "Dataset" << std::right
+              << std::setw(10) << "Received" << std::setw(10) << "Passed" << std::setw(11) << "Reordered"
+              << std::setw(7) << "Late" << std::setw(12) << "Duplicates" << std::setw(10) << "Outliers"
+              << std::setw(10) << "Bits/pt" << "   Check" << std::endl;
+    
+    bool all_passed = RunOnAllDatasets([&](const DatasetConfig& dataset, const std::vector<CoSTGpsPoint>& gps_data) {
+        std::vector<CoSTGpsPoint> ordered = gps_data;
+        for (size_t i = 1; i < ordered.size(); ++i) {
+            uint64_t gap = gps_data[i].timestamp > gps_data[i - 1].timestamp ?
+                           gps_data[i].timestamp - gps_data[i - 1].timestamp : 1;
+            ordered[i].timestamp = ordered[i - 1].timestamp + std::min<uint64_t>(gap, reorder.lateness_seconds);
+        }
+        
+        std::vector<CoSTGpsPoint> arrivals;
+        int swaps = 0, repeats = 0, glitches = 0;
+        for (size_t i = 0; i < ordered.size(); ++i) {
+            if (i % 7 == 0 && i + 1 < ordered.size()) {
+                arrivals.push_back(ordered[i + 1]);
+                arrivals.push_back(ordered[i]);
+                swaps++;
+                i++;
+            } else {
+                arrivals.push_back(ordered[i]);
+            }
+            if (i % 50 == 0) {
+                arrivals.push_back(arrivals.back());
+                repeats++;
+            }
+            if (i % 97 == 0 && i + 1 < ordered.size()) {
+                CoSTGpsPoint glitch = arrivals.back();
+                glitch.timestamp += 2 * reorder.max_lead_seconds;
+                arrivals.push_back(glitch);
+                glitches++;
+            }
+        }
+        
+        CoSTCompressor compressor(ordered.size(), epsilon);
+        CoSTReorderBuffer buffer(compressor, reorder);
+        for (const auto& point : arrivals) buffer.AddGpsPoint(point);
+        buffer.Flush();
+        compressor.Close();
+        RoundTripResult result = DecodeStream(compressor, ordered, epsilon);
+        
+        const CoSTReorderBuffer::Stats& stats = buffer.GetStats();
+        bool passed = result.passed && stats.received == static_cast<int>(arrivals.size()) &&
+                      stats.passed == static_cast<int>(ordered.size()) && stats.reordered == swaps &&
+                      stats.late == 0 && stats.duplicates == repeats && stats.outliers == glitches;
+        std::cout << std::left << std::setw(44) << dataset.name << std::right
+                  << std::setw(10) << stats.received << std::setw(10) << stats.passed
+                  << std::setw(11) << stats.reordered << std::setw(7) << stats.late
+                  << std::setw(12) << stats.duplicates << std::setw(10) << stats.outliers
+                  << std::fixed << std::setprecision(3) << std::setw(10) << result.bits_per_point
+                  << "   " << (passed ? "OK" : "FAIL") << std::defaultfloat << std::endl;
+        return passed;
+    });
+    std::cout << (all_passed ? "✅ every stream restored in order" : "❌ reorder check failed") << std::endl;
+}
+
+// Stream profiles and predictor priors: each dataset cut into trips of 30
+// points (at most 200), coded with the full header, with a stream profile
+// (compact header, origin at the first point of the dataset) and with the
+// profile plus the prior learned from the previous trip
+void StreamProfileTest(double epsilon) {
+    const size_t kTripPoints = 30;
+    const size_t kMaxTrips = 200;
+    const int kProfileId = 1;
+    
+    std::ostringstream title;
+    title << "Stream profiles and priors: epsilon = " << epsilon << ", trips of " << kTripPoints << " points";
+    PrintModeBanner(title.str());
+    std::cout << std::left << std::setw(44) << "Dataset" << std::right << std::setw(8) << "Trips"
+              << std::setw(14) << "Full header" << std::setw(10) << "Profile" << std::setw(10) << "Prior"
+              << std::setw(10) << "Saving" << std::setw(14) << "Max error" << "   Check" << std::endl;
+    
+    bool all_passed = RunOnAllDatasets([&](const DatasetConfig& dataset, const std::vector<CoSTGpsPoint>& gps_data) {
+        StreamProfileTable table;
+        table.AddProfile(kProfileId, StreamProfile(epsilon, gps_data[0]));
+        bool passed = true, has_prior = false;
+        double bits[3] = {0, 0, 0}, max_error = 0;
+        size_t trips = 0;
+        for (; trips < kMaxTrips && (trips + 1) * kTripPoints <= gps_data.size(); ++trips) {
+            std::vector<CoSTGpsPoint> trip(gps_data.begin() + trips * kTripPoints,
+                                           gps_data.begin() + (trips + 1) * kTripPoints);
+            CoSTCompressor::PredictorPrior learned;
+            for (int run = 0; run < 3; ++run) {
+                CoSTCompressor compressor(trip.size(), epsilon);
+                if (run > 0) compressor.SetStreamProfile(&table, kProfileId);
+                if (run == 2 && has_prior) compressor.SetPredictorPrior(&table, kProfileId);
+                for (const auto& point : trip) compressor.AddGpsPoint(point);
+                compressor.Close();
+                RoundTripResult result = DecodeStream(compressor, trip, epsilon, nullptr, run > 0 ? &table : nullptr);
+                bits[run] += result.bits_per_point;
+                max_error = std::max(max_error, result.max_error);
+                passed &= result.passed;
+                if (run == 0) learned = compressor.GetPredictorPrior();
+            }
+            table.AddPrior(kProfileId, learned);
+            has_prior = true;
+        }
+        if (trips == 0) return true;
+        for (double& total : bits) total /= trips;
+        std::cout << std::left << std::setw(44) << dataset.name << std::right << std::setw(8) << trips
+                  << std::fixed << std::setprecision(3)
+                  << std::setw(14) << bits[0] << std::setw(10) << bits[1] << std::setw(10) << bits[2]
+                  << std::setw(9) << std::setprecision(1) << 100 * (bits[0] - bits[2]) / bits[0] << "%"
+                  << std::scientific << std::setprecision(2) << std::setw(14) << max_error
+                  << "   " << (passed ? "OK" : "FAIL") << std::defaultfloat << std::endl;
+        return passed;
+    });
+    std::cout << (all_passed ? "✅ all trips decoded with the shared table" : "❌ profile check failed") << std::endl;
+}
+
+// Route templates: the first 2000 points of each dataset as a trip, then the
+// same route a day later with every fix moved by up to epsilon, coded without
+// a template, with the reconstructed first trip as template and with the
+// template picked automatically
+void RouteTemplateTest(double epsilon) {
+    const size_t kTripPoints = 2000;
+    const uint16_t kRouteId = 1;
+    const uint64_t kDaySeconds = 86400;
+    
+    std::ostringstream title;
+    title << "Route templates: epsilon = " << epsilon << ", a trip of " << kTripPoints << " points driven again";
+    PrintModeBanner(title.str());
+    std::cout << std::left << std::setw(44) << "Dataset" << std::setw(12) << "Template" << std::right
+              << std::setw(10) << "Bits/pt" << std::setw(10) << "Saving" << std::setw(12) << "RT points"
+              << std::setw(14) << "Max error" << "   Check" << std::endl;
+    
+    bool all_passed = RunOnAllDatasets([&](const DatasetConfig& dataset, const std::vector<CoSTGpsPoint>& gps_data) {
+        std::vector<CoSTGpsPoint> trip(gps_data.begin(), gps_data.begin() + std::min(kTripPoints, gps_data.size()));
+        RoundTripResult first = RoundTrip(trip, epsilon, CoSTCompressor::Options());
+        RouteTemplateLibrary library;
+        library.AddTemplate(kRouteId, first.decoded);
+        
+        std::vector<CoSTGpsPoint> again = trip;
+        for (size_t i = 0; i < again.size(); ++i) {
+            again[i].longitude += epsilon * std::sin(0.7 * i);
+            again[i].latitude += epsilon * std::cos(1.3 * i);
+            again[i].timestamp += kDaySeconds;
+        }
+        
+        bool passed = first.passed;
+        double plain_bits = 0;
+        for (int run = 0; run < 3; ++run) {
+            CoSTCompressor compressor(again.size(), epsilon);
+            if (run == 1) compressor.SetRouteTemplateLibrary(&library, kRouteId);
+            if (run == 2) compressor.SetRouteTemplateLibrary(&library, CoSTCompressor::kAutoSelectRoute);
+            for (const auto& point : again) compressor.AddGpsPoint(point);
+            compressor.Close();
+            RoundTripResult result = DecodeStream(compressor, again, epsilon, &library);
+            if (run == 0) plain_bits = result.bits_per_point;
+            passed &= result.passed;
+            std::cout << std::left << std::setw(44) << dataset.name
+                      << std::setw(12) << (run == 0 ? "none" : run == 1 ? "route id" : "auto")
+                      << std::right << std::fixed << std::setprecision(3) << std::setw(10) << result.bits_per_point
+                      << std::setw(9) << std::setprecision(1)
+                      << 100 * (plain_bits - result.bits_per_point) / plain_bits << "%"
+                      << std::setw(12) << compressor.GetStats().rt_count
+                      << std::scientific << std::setprecision(2) << std::setw(14) << result.max_error
+                      << "   " << (result.passed ? "OK" : "FAIL") << std::defaultfloat << std::endl;
+        }
+        return passed;
+    });
+    std::cout << (all_passed ? "✅ all errors within epsilon" : "❌ epsilon exceeded") << std::endl;
+}
+
+// Attribute channels: heading (1 degree) and speed (0.1 m/s) derived from the
+// fixes, the same speed lossless and the integer seconds since the previous fix,
+// coded next to the positions; each channel is checked against its own bound
+void AttributeChannelTest(double epsilon) {
+    const int kChannels = 4;
+    
+    std::ostringstream title;
+    title << "Attribute channels: epsilon = " << epsilon
+          << ", heading 1 deg, speed 0.1 m/s, speed lossless, seconds since the previous fix";
+    PrintModeBanner(title.str());
+    std::cout << std::left << std::setw(44) << "Dataset" << std::right
+              << std::setw(10) << "Position" << std::setw(14) << "Attributes" << std::setw(14) << "Heading err"
+              << std::setw(12) << "Speed err" << std::setw(14) << "Max error" << "   Check" << std::endl;
+    
+    bool all_passed = RunOnAllDatasets([&](const DatasetConfig& dataset, const std::vector<CoSTGpsPoint>& gps_data) {
+        std::vector<double> attributes(gps_data.size() * kChannels, 0);
+        for (size_t i = 1; i < gps_data.size(); ++i) {
+            double east, north;
+            CalculateErrorMeters(gps_data[i - 1], gps_data[i], east, north);
+            double seconds = gps_data[i].timestamp > gps_data[i - 1].timestamp ?
+                             static_cast<double>(gps_data[i].timestamp - gps_data[i - 1].timestamp) : 0;
+            double heading = std::atan2(gps_data[i].longitude - gps_data[i - 1].longitude,
+                                        gps_data[i].latitude - gps_data[i - 1].latitude) * 180 / M_PI;
+            double* row = &attributes[i * kChannels];
+            row[0] = heading < 0 ? heading + 360 : heading;
+            row[1] = seconds > 0 ? std::sqrt(east * east + north * north) / seconds : 0;
+            row[2] = row[1];
+            row[3] = seconds;
+        }
+        
+        RoundTripResult plain = RoundTrip(gps_data, epsilon, CoSTCompressor::Options());
+        CoSTCompressor::Options options;
+        options.attributes = {AttributeChannel(AttributeChannel::HEADING, 1.0),
+                              AttributeChannel(AttributeChannel::SPEED, 0.1),
+                              AttributeChannel(AttributeChannel::SPEED, 0),
+                              AttributeChannel(AttributeChannel::CUSTOM, 0, true)};
+        CoSTCompressor compressor(gps_data.size(), epsilon, options);
+        for (size_t i = 0; i < gps_data.size(); ++i) {
+            compressor.AddGpsPoint(gps_data[i], &attributes[i * kChannels]);
+        }
+        compressor.Close();
+        
+        RoundTripResult result;
+        result.bits_per_point = static_cast<double>(compressor.GetCompressedSizeInBits()) / gps_data.size();
+        ArrayView<const uint8_t> compressed = compressor.GetCompressedView();
+        CoSTDecompressor decompressor(compressed.begin(), compressed.length());
+        CoSTGpsPoint point;
+        double row[kChannels];
+        double heading_error = 0, speed_error = 0;
+        bool exact = true;
+        while (result.decoded.size() < gps_data.size() && decompressor.ReadNextPoint(point, row)) {
+            const double* original = &attributes[result.decoded.size() * kChannels];
+            double turn = std::fabs(row[0] - original[0]);
+            heading_error = std::max(heading_error, std::min(turn, 360 - turn));
+            speed_error = std::max(speed_error, std::fabs(row[1] - original[1]));
+            exact &= row[2] == original[2] && row[3] == original[3];
+            result.decoded.push_back(point);
+        }
+        CheckDecoded(gps_data, epsilon, result);
+        
+        bool passed = plain.passed && result.passed && heading_error <= 1.0 && speed_error <= 0.1 && exact;
+        std::cout << std::left << std::setw(44) << dataset.name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(10) << plain.bits_per_point
+                  << std::setw(14) << result.bits_per_point - plain.bits_per_point
+                  << std::setw(14) << heading_error << std::setw(12) << speed_error
+                  << std::scientific << std::setprecision(2) << std::setw(14) << result.max_error
+                  << "   " << (passed ? "OK" : "FAIL") << std::defaultfloat << std::endl;
+        return passed;
+    });
+    std::cout << (all_passed ? "✅ all channels within their bounds" : "❌ attribute bound exceeded") << std::endl;
+}
+
+// Lossless: epsilon 0 at levels 1, 2 and 3; every coordinate must come back
+// bit for bit (raw fixes take 192 bits: two doubles and a 64-bit timestamp)
+void LosslessTest() {
+    PrintModeBanner("Lossless: epsilon = 0, levels 1, 2 and 3");
+    std::cout << std::left << std::setw(44) << "Dataset" << std::setw(8) << "Level" << std::right
+              << std::setw(10) << "Bits/pt" << std::setw(10) << "Ratio" << std::setw(14) << "Decode us/pt"
+              << "   Check" << std::endl;
+    
+    bool all_passed = RunOnAllDatasets([&](const DatasetConfig& dataset, const std::vector<CoSTGpsPoint>& gps_data) {
+        bool passed = true;
+        for (int level : {1, 2, 3}) {
+            CoSTCompressor::Options options;
+            options.level = level;
+            RoundTripResult result = RoundTrip(gps_data, 0, options);
+            passed &= result.passed;
+            std::cout << std::left << std::setw(44) << dataset.name << std::setw(8) << level
+                      << std::right << std::fixed << std::setprecision(3) << std::setw(10) << result.bits_per_point
+                      << std::setw(10) << 192 / result.bits_per_point
+                      << std::setw(14) << result.decode_us_per_point
+                      << "   " << (result.passed ? "OK" : "FAIL") << std::defaultfloat << std::endl;
+        }
+        return passed;
+    });
+    std::cout << (all_passed ? "✅ all points restored exactly" : "❌ lossless round trip failed") << std::endl;
+}
+
+// Integer grid: floating-point prediction against Options::integer_grid at
+// epsilon * 10, epsilon and epsilon / 10, with the decoding time of each
+void IntegerGridTest(double epsilon) {
+    std::ostringstream title;
+    title << "Integer grid: epsilon = " << epsilon * 10 << ", " << epsilon << " and " << epsilon / 10;
+    PrintModeBanner(title.str());
+    std::cout << std::left << std::setw(44) << "Dataset" << std::setw(12) << "Epsilon" << std::right
+              << std::setw(10) << "Float" << std::setw(10) << "Grid" << std::setw(10) << "Saving"
+              << std::setw(14) << "Decode us/pt" << std::setw(12) << "Grid us/pt" << std::setw(14) << "Max error"
+              << "   Check" << std::endl;
+    
+    bool all_passed = RunOnAllDatasets([&](const DatasetConfig& dataset, const std::vector<CoSTGpsPoint>& gps_data) {
+        bool passed = true;
+        for (double run_epsilon : {epsilon * 10, epsilon, epsilon / 10}) {
+            CoSTCompressor::Options options;
+            RoundTripResult floating = RoundTrip(gps_data, run_epsilon, options);
+            options.integer_grid = true;
+            RoundTripResult grid = RoundTrip(gps_data, run_epsilon, options);
+            bool run_passed = floating.passed && grid.passed;
+            passed &= run_passed;
+            std::cout << std::left << std::setw(44) << dataset.name << std::setw(12) << std::scientific
+                      << std::setprecision(0) << run_epsilon << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(10) << floating.bits_per_point << std::setw(10) << grid.bits_per_point
+                      << std::setw(9) << std::setprecision(1)
+                      << 100 * (floating.bits_per_point - grid.bits_per_point) / floating.bits_per_point << "%"
+                      << std::setprecision(3) << std::setw(14) << floating.decode_us_per_point
+                      << std::setw(12) << grid.decode_us_per_point
+                      << std::scientific << std::setprecision(2) << std::setw(14) << grid.max_error
+                      << "   " << (run_passed ? "OK" : "FAIL") << std::defaultfloat << std::endl;
+        }
+        return passed;
+    });
+    std::cout << (all_passed ? "✅ all errors within epsilon" : "❌ epsilon exceeded") << std::endl;
+}
+
 int main(int argc, char* argv[]) {
     double epsilon = 1e-5;   // 1e-5 1.1，GPS
     
@@ -1837,6 +2685,34 @@ int main(int argc, char* argv[]) {
                 epsilon = std::stod(argv[2]);
             }
             TestAllDatasetsAndGenerateSummary(epsilon);
+        } else if (mode == "metric") {
+            MetricBoundTest(argc > 2 ? std::stod(argv[2]) : 1.0);
+        } else if (mode == "precision") {
+            PrecisionMapTest(argc > 2 ? std::stod(argv[2]) : epsilon);
+        } else if (mode == "adaptive") {
+            AdaptiveResidualTest(argc > 2 ? std::stod(argv[2]) : epsilon);
+        } else if (mode == "block") {
+            BlockClassTest(argc > 2 ? std::stod(argv[2]) : epsilon);
+        } else if (mode == "segment") {
+            SegmentModeTest(argc > 2 ? std::stod(argv[2]) : epsilon);
+        } else if (mode == "netcost") {
+            NetCoSTTest(argc > 2 ? std::stod(argv[2]) : epsilon);
+        } else if (mode == "framing") {
+            FramingLossTest(argc > 2 ? std::stod(argv[2]) : epsilon);
+        } else if (mode == "reset") {
+            ResetTest(argc > 2 ? std::stod(argv[2]) : epsilon);
+        } else if (mode == "reorder") {
+            ReorderTest(argc > 2 ? std::stod(argv[2]) : epsilon);
+        } else if (mode == "profile") {
+            StreamProfileTest(argc > 2 ? std::stod(argv[2]) : epsilon);
+        } else if (mode == "route") {
+            RouteTemplateTest(argc > 2 ? std::stod(argv[2]) : epsilon);
+        } else if (mode == "attributes") {
+            AttributeChannelTest(argc > 2 ? std::stod(argv[2]) : epsilon);
+        } else if (mode == "lossless") {
+            LosslessTest();
+        } else if (mode == "grid") {
+            IntegerGridTest(argc > 2 ? std::stod(argv[2]) : epsilon);
         } else if (mode == "single") {
             // Test single dataset (with timestamp)
             std::string dataset_path = "../../data/Geolife_100k_with_id.csv";
@@ -1875,6 +2751,20 @@ int main(int argc, char* argv[]) {
             std::cout << ":" << std::endl;
             std::cout << "  : " << argv[0] << " all [epsilon]" << std::endl;
             std::cout << "  : " << argv[0] << " single <> [] [epsilon]" << std::endl;
+            std::cout << "  Metric bound: " << argv[0] << " metric [epsilon_meters]" << std::endl;
+            std::cout << "  Precision map: " << argv[0] << " precision [epsilon]" << std::endl;
+            std::cout << "  Adaptive residuals: " << argv[0] << " adaptive [epsilon]" << std::endl;
+            std::cout << "  Block classes: " << argv[0] << " block [epsilon]" << std::endl;
+            std::cout << "  Segment mode: " << argv[0] << " segment [epsilon]" << std::endl;
+            std::cout << "  NetCoST packets: " << argv[0] << " netcost [epsilon]" << std::endl;
+            std::cout << "  Framing under loss: " << argv[0] << " framing [epsilon]" << std::endl;
+            std::cout << "  Reset: " << argv[0] << " reset [epsilon]" << std::endl;
+            std::cout << "  Reorder buffer: " << argv[0] << " reorder [epsilon]" << std::endl;
+            std::cout << "  Stream profiles and priors: " << argv[0] << " profile [epsilon]" << std::endl;
+            std::cout << "  Route templates: " << argv[0] << " route [epsilon]" << std::endl;
+            std::cout << "  Attribute channels: " << argv[0] << " attributes [epsilon]" << std::endl;
+            std::cout << "  Lossless: " << argv[0] << " lossless" << std::endl;
+            std::cout << "  Integer grid: " << argv[0] << " grid [epsilon]" << std::endl;
             std::cout << "\n:" << std::endl;
             std::cout << "  " << argv[0] << " all 1e-5" << std::endl;
             std::cout << "  " << argv[0] << " single test/data_set/Geolife_100k_longitude_latitude.csv 10000 1e-5" << std::endl;
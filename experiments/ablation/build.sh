@@ -25,6 +25,11 @@ g++ -std=c++17 -O3 \
     ../../baselines/trajcompress/trajcompress_sp_compressor.cc \
     ../../baselines/trajcompress/trajcompress_sp_adaptive_compressor.cc \
     ../../algorithm/cost_compressor.cc \
+    ../../algorithm/net_cost_compressor.cc \
+    ../../algorithm/reorder_buffer.cc \
+    ../../algorithm/route_template_library.cc \
+    ../../algorithm/precision_map.cc \
+    ../../algorithm/attribute_channel_codec.cc \
     ../../baselines/serf/serf_qt_compressor.cc \
     ../../baselines/serf/serf_qt_linear_compressor.cc \
     ../../baselines/serf/serf_qt_curve_compressor.cc \
@@ -34,6 +39,7 @@ g++ -std=c++17 -O3 \
     ../../utils/output_bit_stream.cc \
     ../../utils/input_bit_stream.cc \
     ../../utils/elias_gamma_codec.cc \
+    ../../utils/post_office_solver.cc \
     -I../../ \
     -o ablation_test \
     -lm
@@ -44,6 +50,20 @@ if [ $? -eq 0 ]; then
     echo "Usage:"
     echo "  ./ablation_test all              # Test all datasets"
     echo "  ./ablation_test single <path>    # Test single dataset"
+    echo "  ./ablation_test metric [meters]  # Error bound in meters vs degrees"
+    echo "  ./ablation_test precision [eps]  # Precision map: eps / 10 at stop sites"
+    echo "  ./ablation_test adaptive [eps]   # Context-adaptive residual classes vs Elias-gamma"
+    echo "  ./ablation_test block [eps]      # Post-office residual classes per block vs Elias-gamma"
+    echo "  ./ablation_test segment [eps]    # Segment mode vs the default modes at eps, eps * 10, eps * 100"
+    echo "  ./ablation_test netcost [eps]    # NetCoST packets of 1, 8 and 32 points vs the whole stream"
+    echo "  ./ablation_test framing [eps]    # Framed packets with 1% and 5% loss, loss counters checked"
+    echo "  ./ablation_test reset [eps]      # Reset() streams vs fresh compressors, byte for byte"
+    echo "  ./ablation_test reorder [eps]    # Reorder buffer on swapped, repeated and glitched arrivals"
+    echo "  ./ablation_test profile [eps]    # Compact headers and predictor priors on 30-point trips"
+    echo "  ./ablation_test route [eps]      # A trip driven again, with and without its route template"
+    echo "  ./ablation_test attributes [eps] # Heading, speed and fix interval channels within their bounds"
+    echo "  ./ablation_test lossless         # Epsilon 0 at levels 1 to 3, restored bit for bit"
+    echo "  ./ablation_test grid [eps]       # Integer grid vs floating point at eps * 10, eps, eps / 10"
     echo ""
     echo "Output: compression_results_YYYYMMDD_HHMMSS.csv"
     echo "        paper_comparison_table_YYYYMMDD_HHMMSS.csv"
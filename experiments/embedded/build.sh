@@ -0,0 +1,41 @@
+#!/bin/bash
+
+echo "======================================"
+echo "Building Embedded Encoder Benchmark"
+echo "======================================"
+
+# Navigate to script directory
+cd "$(dirname "$0")"
+
+# The encoder header must build without the hosted runtime
+echo "Checking freestanding build of embedded_cost_encoder.h..."
+echo '#include "algorithm/embedded_cost_encoder.h"' | \
+    g++ -std=c++17 -ffreestanding -fno-exceptions -fno-rtti -fsyntax-only -x c++ -I../../ -
+if [ $? -ne 0 ]; then
+    echo "✗ Freestanding check failed!"
+    exit 1
+fi
+
+# Compile
+g++ -std=c++17 -O3 \
+    embedded_benchmark.cc \
+    ../../algorithm/cost_compressor.cc \
+    ../../algorithm/route_template_library.cc \
+    ../../algorithm/attribute_channel_codec.cc \
+    ../../utils/output_bit_stream.cc \
+    ../../utils/input_bit_stream.cc \
+    ../../utils/elias_gamma_codec.cc \
+    ../../utils/post_office_solver.cc \
+    -I../../ \
+    -o embedded_benchmark \
+    -lm
+
+if [ $? -eq 0 ]; then
+    echo "✓ Build successful!"
+    echo ""
+    echo "Usage:"
+    echo "  ./embedded_benchmark [buffer_bytes] [epsilon]   # defaults: 1024 1e-5"
+else
+    echo "✗ Build failed!"
+    exit 1
+fi
@@ -0,0 +1,168 @@
+/**
+ * Host-side benchmark for EmbeddedCoSTEncoder
+ *
+ * Reports the static RAM footprint of the encoder, encode time per point (ns
+ * and, on x86, TSC cycles), and compression ratio, encoding each dataset into
+ * fixed-size buffers the way a tracker fills its uplink packets. Every buffer
+ * is decoded with CoSTDecompressor and checked against the error bound.
+ *
+ * Usage: ./embedded_benchmark [buffer_bytes] [epsilon]
+ */
+#include "algorithm/cost_compressor.h"
+#include "algorithm/embedded_cost_encoder.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define COST_HAS_TSC 1
+#endif
+
+using GpsPoint = CoSTCompressor::GpsPoint;
+
+namespace {
+
+uint64_t ParseTimestamp(const std::string& ts_str) {
+    std::tm tm = {};
+    std::istringstream ss(ts_str);
+    ss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+    if (ss.fail()) return 0;
+    return static_cast<uint64_t>(timegm(&tm));
+}
+
+std::vector<GpsPoint> LoadGpsDataFromCSV(const std::string& filename) {
+    std::vector<GpsPoint> points;
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Cannot open " << filename << std::endl;
+        return points;
+    }
+
+    std::string line;
+    std::getline(file, line);  // header
+    while (std::getline(file, line)) {
+        std::stringstream ss(line);
+        std::string lon_str, lat_str, ts_str;
+        if (std::getline(ss, lon_str, ',') && std::getline(ss, lat_str, ',') && std::getline(ss, ts_str, ',')) {
+            points.emplace_back(std::stod(lon_str), std::stod(lat_str), ParseTimestamp(ts_str));
+        }
+    }
+    return points;
+}
+
+struct BufferRange {
+    size_t first_point;
+    size_t point_count;
+    int bytes;
+};
+
+void RunDataset(const std::string& path, int buffer_bytes, double epsilon) {
+    std::vector<GpsPoint> points = LoadGpsDataFromCSV(path);
+    if (points.empty()) return;
+
+    // Encode: fill a buffer, finish it, start the next one at the same point
+    std::vector<uint8_t> storage;
+    std::vector<BufferRange> ranges;
+    std::vector<uint8_t> buffer(buffer_bytes);
+    EmbeddedCoSTEncoder encoder(epsilon);
+    encoder.Reset(buffer.data(), buffer_bytes);
+    size_t first_point = 0;
+
+    auto close_buffer = [&](size_t end) {
+        int bytes = encoder.Finish();
+        ranges.push_back({first_point, end - first_point, bytes});
+        storage.insert(storage.end(), buffer.begin(), buffer.begin() + bytes);
+        encoder.Reset(buffer.data(), buffer_bytes);
+        first_point = end;
+    };
+
+    // Timed as a whole (includes the buffer hand-off), per-point clock reads would dominate
+    auto start = std::chrono::steady_clock::now();
+#ifdef COST_HAS_TSC
+    uint64_t start_tsc = __rdtsc();
+#endif
+    for (size_t i = 0; i < points.size();) {
+        const GpsPoint& p = points[i];
+        if (encoder.AddGpsPoint(p.longitude, p.latitude, p.timestamp)) {
+            ++i;
+        } else if (encoder.GetPointCount() == 0) {
+            std::cerr << "Buffer too small for the stream header" << std::endl;
+            return;
+        } else {
+            close_buffer(i);
+        }
+    }
+    if (first_point < points.size()) close_buffer(points.size());
+#ifdef COST_HAS_TSC
+    uint64_t cycles = __rdtsc() - start_tsc;
+#endif
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Decode every buffer with the standard decompressor
+    double max_error = 0;
+    bool timestamps_ok = true;
+    size_t offset = 0;
+    for (const BufferRange& range : ranges) {
+        CoSTDecompressor decompressor(storage.data() + offset, range.bytes);
+        offset += range.bytes;
+        // The header carries the point count (EmbeddedCoSTEncoder::Finish)
+        std::vector<GpsPoint> decoded_points = decompressor.ReadAllPoints();
+        if (decoded_points.size() != range.point_count) timestamps_ok = false;
+        for (size_t i = 0; i < std::min(decoded_points.size(), range.point_count); ++i) {
+            const GpsPoint& decoded = decoded_points[i];
+            const GpsPoint& original = points[range.first_point + i];
+            max_error = std::max(max_error, std::max(std::fabs(decoded.longitude - original.longitude),
+                                                     std::fabs(decoded.latitude - original.latitude)));
+            timestamps_ok &= decoded.timestamp == original.timestamp;
+        }
+    }
+
+    double n = static_cast<double>(points.size());
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    std::cout << std::left << std::setw(44) << name << std::right << std::fixed
+              << std::setw(8) << points.size()
+              << std::setw(7) << ranges.size()
+              << std::setw(10) << std::setprecision(2) << storage.size() * 8.0 / n
+              << std::setw(9) << std::setprecision(1) << seconds * 1e9 / n;
+#ifdef COST_HAS_TSC
+    std::cout << std::setw(10) << std::setprecision(1) << cycles / n;
+#else
+    std::cout << std::setw(10) << "n/a";
+#endif
+    std::cout << "   " << ((max_error <= epsilon && timestamps_ok) ? "OK" : "FAIL") << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int buffer_bytes = argc > 1 ? std::atoi(argv[1]) : 1024;
+    double epsilon = argc > 2 ? std::atof(argv[2]) : 1e-5;
+
+    std::cout << "EmbeddedCoSTEncoder footprint" << std::endl;
+    std::cout << "  sizeof(EmbeddedCoSTEncoder) = " << sizeof(EmbeddedCoSTEncoder) << " bytes" << std::endl;
+    std::cout << "  sizeof(CompactCoSTState)    = " << sizeof(CompactCoSTState) << " bytes" << std::endl;
+    std::cout << "  output buffer               = " << buffer_bytes << " bytes" << std::endl;
+    std::cout << "  stack scratch (worst case)  = " << CompactCoSTEncoder::kMaxBytesPerPoint + sizeof(CompactCoSTState)
+              << " bytes" << std::endl;
+    std::cout << "  epsilon                     = " << epsilon << std::endl << std::endl;
+
+    std::cout << std::left << std::setw(44) << "Dataset" << std::right
+              << std::setw(8) << "Points" << std::setw(7) << "Bufs" << std::setw(10) << "Bits/pt"
+              << std::setw(9) << "ns/pt" << std::setw(10) << "cyc/pt" << "   Check" << std::endl;
+
+    const std::string base_path = "../../data/";
+    for (const char* name : {"Geolife_100k_with_id_downsample_5x.csv", "Geolife_100k_with_id_downsample_40x.csv",
+                             "Trajtory_100k_with_id_downsample_5x.csv", "Trajtory_100k_with_id_downsample_40x.csv",
+                             "WX_taxi_100k_with_id_downsample_5x.csv", "WX_taxi_100k_with_id_downsample_40x.csv"}) {
+        RunDataset(base_path + name, buffer_bytes, epsilon);
+    }
+    return 0;
+}
@@ -15,6 +15,8 @@ echo ""
 g++ -std=c++17 -O3 -Wno-register \
     comprehensive_perf_test_v3.cc \
     ../../algorithm/cost_compressor.cc \
+    ../../algorithm/route_template_library.cc \
+    ../../algorithm/attribute_channel_codec.cc \
     ../../utils/output_bit_stream.cc \
     ../../utils/input_bit_stream.cc \
     ../../utils/elias_gamma_codec.cc \
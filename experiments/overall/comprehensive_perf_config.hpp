@@ -72,6 +72,9 @@ constexpr int kSerfXORWindowSize = 1000;
 // Simple 算法配置
 constexpr int kCoSTEvaluationWindow = 96;
 constexpr bool kCoSTUseTimeWindow = false;
+// CoST compression levels to report (CoSTCompressor::Options::level); the
+// default level is reported as "CoST", the others as "CoST-L<level>"
+const std::vector<int> kCoSTLevelList = {1, 2, 3, 4, 5};
 
 // SerfQt/SerfXOR 压缩模式配置
 // 流式算法使用全数据集压缩（block_size = 数据集大小）
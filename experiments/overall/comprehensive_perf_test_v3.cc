@@ -1099,7 +1099,7 @@ void PerfNetSerfXOR(std::ifstream &data_set_input_stream_ref, double max_diff, i
 // ：Simple，
 // ：（blockHuffman）
 void PerfCoST(std::ifstream &data_set_input_stream_ref, double max_diff, int block_size,
-                const std::string &data_set, PerfRecord &perf_record) {
+                const std::string &data_set, int level, PerfRecord &perf_record) {
     // （）
     std::vector<CoSTCompressor::GpsPoint> original_data;
     std::string line;
@@ -1131,11 +1131,14 @@ void PerfCoST(std::ifstream &data_set_input_stream_ref, double max_diff, int blo
     }
     
     // 
+    CoSTCompressor::Options options;
+    options.evaluation_window = kCoSTEvaluationWindow;
+    options.use_time_window = kCoSTUseTimeWindow;
+    options.level = level;
     CoSTCompressor cost_compressor(
         original_data.size(),        // block_size = 
         max_diff,                    // epsilon
-        kCoSTEvaluationWindow,     // evaluation_window
-        kCoSTUseTimeWindow         // use_time_window
+        options
     );
     
     auto compression_start_time = std::chrono::steady_clock::now();
@@ -1327,19 +1330,19 @@ void RunComprehensiveTest() {
         
         // Simple（2D）
         std::cout << "   CoST...\n"; std::cout.flush();
-        PerfRecord cost_record;
-        {
+        std::map<int, PerfRecord> cost_records;
+        for (int level : kCoSTLevelList) {
             std::ifstream cost_stream(config.path);
             if (!cost_stream.is_open()) {
                 std::cerr << "    ❌ : " << config.path << "\n";
-            } else {
-                std::string header;
-                std::getline(cost_stream, header);
-                // Simple  block_size
-                PerfCoST(cost_stream, kMaxDiffOverall, streaming_block_size, config.name, cost_record);
-                cost_stream.close();
-                std::cout << "  ✅ CoST \n"; std::cout.flush();
+                break;
             }
+            std::string header;
+            std::getline(cost_stream, header);
+            // Simple  block_size
+            PerfCoST(cost_stream, kMaxDiffOverall, streaming_block_size, config.name, level, cost_records[level]);
+            cost_stream.close();
+            std::cout << "  ✅ CoST (level " << level << ")\n"; std::cout.flush();
         }
         
         // （）- 
@@ -1386,22 +1389,28 @@ void RunComprehensiveTest() {
                      << avg_cr << "," << bpp << "," << avg_ct_per_point << "," << avg_dt_per_point << "\n";
         }
         
-        // Simple（2D）
-        // ：Simple， CompressionRatioByPoints()
-        double cost_cr = cost_record.CompressionRatioByPoints();
-        double cost_bpp = cost_record.BitsPerPoint();
-        // （）
-        double cost_ct_per_point = cost_record.AvgCompressionTimePerPoint();
-        double cost_dt_per_point = cost_record.AvgDecompressionTimePerPoint();
-        
-        std::cout << "    CoST: CR=" << std::fixed << std::setprecision(2) << cost_cr 
-                  << " (BPP=" << std::setprecision(2) << cost_bpp << ")"
-                  << ", CT=" << std::setprecision(4) << cost_ct_per_point << "μs"
-                  << ", DT=" << std::setprecision(4) << cost_dt_per_point << "μs\n";
-        
-        // Simple （）
-        csv_file << "CoST," << config.name << "," << streaming_block_size << "," << kMaxDiffOverall << ","
-                 << cost_cr << "," << cost_bpp << "," << cost_ct_per_point << "," << cost_dt_per_point << "\n";
+        // Simple（2D）, one row per compression level
+        for (const auto& entry : cost_records) {
+            const PerfRecord& cost_record = entry.second;
+            std::string method = entry.first == CoSTCompressor::kDefaultLevel
+                ? "CoST" : "CoST-L" + std::to_string(entry.first);
+            
+            // ：Simple， CompressionRatioByPoints()
+            double cost_cr = cost_record.CompressionRatioByPoints();
+            double cost_bpp = cost_record.BitsPerPoint();
+            // （）
+            double cost_ct_per_point = cost_record.AvgCompressionTimePerPoint();
+            double cost_dt_per_point = cost_record.AvgDecompressionTimePerPoint();
+            
+            std::cout << "    " << method << ": CR=" << std::fixed << std::setprecision(2) << cost_cr 
+                      << " (BPP=" << std::setprecision(2) << cost_bpp << ")"
+                      << ", CT=" << std::setprecision(4) << cost_ct_per_point << "μs"
+                      << ", DT=" << std::setprecision(4) << cost_dt_per_point << "μs\n";
+            
+            // Simple （）
+            csv_file << method << "," << config.name << "," << streaming_block_size << "," << kMaxDiffOverall << ","
+                     << cost_cr << "," << cost_bpp << "," << cost_ct_per_point << "," << cost_dt_per_point << "\n";
+        }
     }  // end of dataset loop
     
     csv_file.close();
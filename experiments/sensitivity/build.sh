@@ -18,10 +18,13 @@ fi
 g++ -std=c++17 -O3 \
     sensitivity_test.cc \
     ../../algorithm/cost_compressor.cc \
+    ../../algorithm/route_template_library.cc \
+    ../../algorithm/attribute_channel_codec.cc \
     ../../baselines/serf/serf_qt_compressor.cc \
     ../../baselines/serf/serf_qt_decompressor.cc \
     ../../utils/elias_delta_codec.cc \
     ../../utils/elias_gamma_codec.cc \
+    ../../utils/post_office_solver.cc \
     ../../utils/output_bit_stream.cc \
     ../../utils/input_bit_stream.cc \
     -I../../ \
@@ -37,6 +37,18 @@ class Array {
     return *this;
   }
 
+  // Moves take the storage and leave other empty
+  Array<T>(Array<T> &&other) noexcept : length_(other.length_), data_(std::move(other.data_)) {
+    other.length_ = 0;
+  }
+
+  Array<T> &operator=(Array<T> &&right) noexcept {
+    length_ = right.length_;
+    data_ = std::move(right.data_);
+    right.length_ = 0;
+    return *this;
+  }
+
   T &operator[](int index) const {
     return data_[index];
   }
@@ -58,4 +70,39 @@ class Array {
   std::unique_ptr<T[]> data_ = nullptr;
 };
 
+// Non-owning view of length contiguous elements (valid while the owner lives)
+template<typename T>
+class ArrayView {
+ public:
+  ArrayView<T>() = default;
+
+  ArrayView<T>(T *data, int length) : data_(data), length_(length) {}
+
+  template<typename U>
+  ArrayView<T>(const Array<U> &array) : data_(array.begin()), length_(array.length()) {}
+
+  template<typename U>
+  ArrayView<T>(const std::vector<U> &vec) : data_(vec.data()), length_(static_cast<int>(vec.size())) {}
+
+  T &operator[](int index) const {
+    return data_[index];
+  }
+
+  T *begin() const {
+    return data_;
+  }
+
+  T *end() const {
+    return data_ + length_;
+  }
+
+  int length() const {
+    return length_;
+  }
+
+ private:
+  T *data_ = nullptr;
+  int length_ = 0;
+};
+
 #endif  // SERF_ARRAY_H
@@ -1,12 +1,11 @@
 #include "utils/input_bit_stream.h"
 
 InputBitStream::InputBitStream(uint8_t *raw_data, size_t size) {
-  data_ = Array<uint32_t>(std::ceil(static_cast<double>(size) / sizeof(uint32_t)));
-  __builtin_memcpy(data_.begin(), raw_data, size);
-  for (auto &blk : data_) blk = be32toh(blk);
-  buffer_ = (static_cast<uint64_t>(data_[0])) << 32;
-  cursor_ = 1;
-  bit_in_buffer_ = 32;
+  SetBuffer(ArrayView<const uint8_t>(raw_data, size));
+}
+
+InputBitStream::InputBitStream(ArrayView<const uint8_t> bytes) {
+  SetBuffer(bytes);
 }
 
 uint64_t InputBitStream::Peek(size_t len) {
@@ -47,11 +46,15 @@ uint32_t InputBitStream::ReadBit() {
   return ret;
 }
 
-void InputBitStream::SetBuffer(const Array<uint8_t> &new_buffer) {
-  data_ = Array<uint32_t>(std::ceil(static_cast<double>(new_buffer.length()) / sizeof(uint32_t)));
+void InputBitStream::SetBuffer(ArrayView<const uint8_t> new_buffer) {
+  int words = (new_buffer.length() + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+  if (data_.length() < words) data_ = Array<uint32_t>(words);
+  // A reused buffer reads as zeros past the stream, like one of the exact size
+  int full_words = new_buffer.length() / sizeof(uint32_t);
+  std::fill(data_.begin() + full_words, data_.end(), 0);
   __builtin_memcpy(data_.begin(), new_buffer.begin(), new_buffer.length());
-  for (auto &blk : data_) blk = be32toh(blk);
-  if (data_.length() > 0) {
+  for (int i = 0; i < words; ++i) data_[i] = be32toh(data_[i]);
+  if (words > 0) {
     buffer_ = (static_cast<uint64_t>(data_[0])) << 32;
     cursor_ = 1;
     bit_in_buffer_ = 32;
@@ -62,17 +65,10 @@ void InputBitStream::SetBuffer(const Array<uint8_t> &new_buffer) {
   }
 }
 
+void InputBitStream::SetBuffer(const Array<uint8_t> &new_buffer) {
+  SetBuffer(ArrayView<const uint8_t>(new_buffer));
+}
+
 void InputBitStream::SetBuffer(const std::vector<uint8_t> &new_buffer) {
-  data_ = Array<uint32_t>(std::ceil(static_cast<double>(new_buffer.size()) / sizeof(uint32_t)));
-  __builtin_memcpy(data_.begin(), new_buffer.data(), new_buffer.size());
-  for (auto &blk : data_) blk = be32toh(blk);
-  if (data_.length() > 0) {
-    buffer_ = (static_cast<uint64_t>(data_[0])) << 32;
-    cursor_ = 1;
-    bit_in_buffer_ = 32;
-  } else {
-    buffer_ = 0;
-    cursor_ = 0;
-    bit_in_buffer_ = 0;
-  }
+  SetBuffer(ArrayView<const uint8_t>(new_buffer));
 }
@@ -24,12 +24,19 @@ class InputBitStream {
 
   InputBitStream(uint8_t *raw_data, size_t size);
 
+  // Const bytes as a view, so that (nullptr, 0) still picks the overload above
+  explicit InputBitStream(ArrayView<const uint8_t> bytes);
+
   uint64_t ReadLong(size_t len);
 
   uint32_t ReadInt(size_t len);
 
   uint32_t ReadBit();
 
+  // Copies the bytes; the word buffer is reused when it is large enough
+  void SetBuffer(ArrayView<const uint8_t> new_buffer);
+
+  // The Array and vector overloads forward to the view
   void SetBuffer(const Array<uint8_t> &new_buffer);
 
   void SetBuffer(const std::vector<uint8_t> &new_buffer);
@@ -38,7 +45,9 @@ class InputBitStream {
   void Forward(size_t len);
   uint64_t Peek(size_t len);
 
-  Array<uint32_t> data_;
+  // The gorilla, chimp and fpc baselines declare these members in their own
+  // copies of this header and link this file, so the layout must not change
+  Array<uint32_t> data_;  // words past the stream are zero
   uint64_t buffer_ = 0;
   uint64_t cursor_ = 0;
   uint64_t bit_in_buffer_ = 0;
@@ -12,7 +12,7 @@ uint32_t OutputBitStream::Write(uint64_t content, uint32_t len) {
   buffer_ |= (content >> bit_in_buffer_);
   bit_in_buffer_ += len;
   if (bit_in_buffer_ >= 32) {
-    data_[cursor_++] = (buffer_ >> 32);
+    data_[cursor_++] = htobe32(buffer_ >> 32);
     buffer_ <<= 32;
     bit_in_buffer_ -= 32;
   }
@@ -37,16 +37,45 @@ uint32_t OutputBitStream::WriteBit(bool bit) {
   return Write(static_cast<uint64_t>(bit), 1);
 }
 
-Array<uint8_t> OutputBitStream::GetBuffer(uint32_t len) {
+void OutputBitStream::WriteAt(uint32_t position, uint64_t content, uint32_t len) {
+  if (len > 32) {
+    WriteAt(position, content >> (len - 32), 32);
+    WriteAt(position + 32, content, len - 32);
+    return;
+  }
+  // The two words the bits may span, as one big-endian 64-bit value
+  uint32_t word = position / 32;
+  uint32_t shift = 64 - (position % 32) - len;
+  uint64_t mask = ((1ull << len) - 1) << shift;
+  bool spans = (position % 32) + len > 32;
+  uint64_t pair = static_cast<uint64_t>(be32toh(data_[word])) << 32;
+  if (spans) pair |= be32toh(data_[word + 1]);
+  pair = (pair & ~mask) | ((content << shift) & mask);
+  data_[word] = htobe32(pair >> 32);
+  if (spans) data_[word + 1] = htobe32(static_cast<uint32_t>(pair));
+}
+
+Array<uint8_t> OutputBitStream::GetBuffer(uint32_t len) const {
   Array<uint8_t> ret(len);
-  for (auto &blk : data_) blk = htobe32(blk);
-  __builtin_memcpy(ret.begin(), data_.begin(), len);
+  CopyBuffer(ret.begin(), len);
   return ret;
 }
 
+Array<uint8_t> OutputBitStream::GetBuffer(uint32_t len) {
+  return static_cast<const OutputBitStream *>(this)->GetBuffer(len);
+}
+
+void OutputBitStream::CopyBuffer(uint8_t *out, uint32_t len) const {
+  __builtin_memcpy(out, data_.begin(), len);
+}
+
+ArrayView<const uint8_t> OutputBitStream::GetView(uint32_t len) const {
+  return ArrayView<const uint8_t>(reinterpret_cast<const uint8_t *>(data_.begin()), len);
+}
+
 void OutputBitStream::Flush() {
   if (bit_in_buffer_) {
-    data_[cursor_++] = buffer_ >> 32;
+    data_[cursor_++] = htobe32(buffer_ >> 32);
     buffer_ = 0;
     bit_in_buffer_ = 0;
   }
@@ -25,14 +25,27 @@ class OutputBitStream {
 
   uint32_t WriteBit(bool bit);
 
+  // Overwrite len <= 64 bits at a bit position that has been flushed
+  void WriteAt(uint32_t position, uint64_t content, uint32_t len);
+
   void Flush();
 
+  Array<uint8_t> GetBuffer(uint32_t len) const;
+
+  // Same as the const overload; the gorilla, chimp and fpc baselines declare
+  // this one in their own copies of this header and link this file
   Array<uint8_t> GetBuffer(uint32_t len);
 
+  // Copy the first len bytes to out
+  void CopyBuffer(uint8_t *out, uint32_t len) const;
+
+  // The first len bytes in place, valid until the next write or Refresh()
+  ArrayView<const uint8_t> GetView(uint32_t len) const;
+
   void Refresh();
 
  private:
-  Array<uint32_t> data_;
+  Array<uint32_t> data_;  // big-endian words, so the bytes are the stream
   uint32_t cursor_;
   uint32_t bit_in_buffer_;
   uint64_t buffer_;
@@ -1,15 +1,18 @@
 #ifndef SERF_POST_OFFICE_RESULT_H
 #define SERF_POST_OFFICE_RESULT_H
 
+#include <utility>
+
 #include "array.h"
 
 class PostOfficeResult {
  public:
-  PostOfficeResult(const Array<int> &office_positions, int total_app_cost) :
-      office_positions_(office_positions),
+  PostOfficeResult(Array<int> office_positions, int total_app_cost) :
+      office_positions_(std::move(office_positions)),
       total_app_cost_(total_app_cost) {}
 
-  Array<int> office_positions() {
+  // Move from the result to keep the positions without a copy
+  Array<int> &office_positions() {
     return office_positions_;
   }
 
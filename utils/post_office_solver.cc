@@ -1,31 +1,33 @@
 #include <algorithm>
+#include <utility>
 
 #include "utils/post_office_solver.h"
 
 Array<int>
-PostOfficeSolver::InitRoundAndRepresentation(Array<int> &distribution, Array<int> &representation, Array<int> &round) {
+PostOfficeSolver::InitRoundAndRepresentation(ArrayView<const int> distribution, ArrayView<int> representation,
+                                             ArrayView<int> round) {
   // 当前及前面的非零个数（包括当前）
   Array<int> pre_non_zeros_count(distribution.length());
   // 当前后面的非零个数（不包括当前）
   Array<int> post_non_zeros_count(distribution.length());
-  Array<int> total_count_and_non_zeros_counts = CalTotalCountAndNonZerosCounts(distribution, pre_non_zeros_count,
-                                                                               post_non_zeros_count);
+  int total_count, non_zeros_count;
+  CalTotalCountAndNonZerosCounts(distribution, pre_non_zeros_count, post_non_zeros_count, total_count,
+                                 non_zeros_count);
 
-  int max_z = std::min(kPositionLength2Bits[total_count_and_non_zeros_counts[1]], 5);  // 最多用5个bit来表示
+  int max_z = std::min(kPositionLength2Bits[non_zeros_count], 5);  // 最多用5个bit来表示
   int total_cost = std::numeric_limits<int>::max();
   Array<int> positions = {};
 
   int present_cost;
-  for (int z = 0; z <= max_z && (present_cost = total_count_and_non_zeros_counts[0] * z) < total_cost; ++z) {
+  for (int z = 0; z <= max_z && (present_cost = total_count * z) < total_cost; ++z) {
     // 邮局的总数量
     int num = PostOfficeSolver::kPow2z[z];
-    PostOfficeResult por = PostOfficeSolver::BuildPostOffice(distribution, num,
-                                                             total_count_and_non_zeros_counts[1],
+    PostOfficeResult por = PostOfficeSolver::BuildPostOffice(distribution, num, non_zeros_count,
                                                              pre_non_zeros_count, post_non_zeros_count);
     int temp_total_cost = por.total_app_cost() + present_cost;
     if (temp_total_cost < total_cost) {
       total_cost = temp_total_cost;
-      positions = por.office_positions();
+      positions = std::move(por.office_positions());
     }
   }
 
@@ -51,9 +53,10 @@ PostOfficeSolver::InitRoundAndRepresentation(Array<int> &distribution, Array<int
   return positions;
 }
 
-Array<int>
-PostOfficeSolver::CalTotalCountAndNonZerosCounts(Array<int> &arr, Array<int> &out_pre_non_zeros_count,
-                                                 Array<int> &out_post_non_zeros_count) {
+void
+PostOfficeSolver::CalTotalCountAndNonZerosCounts(ArrayView<const int> arr, ArrayView<int> out_pre_non_zeros_count,
+                                                 ArrayView<int> out_post_non_zeros_count, int &out_total_count,
+                                                 int &out_non_zeros_count) {
   int non_zeros_count = arr.length();
   int total_count = arr[0];
   out_pre_non_zeros_count[0] = 1;            // 第一个视为非零
@@ -74,11 +77,13 @@ PostOfficeSolver::CalTotalCountAndNonZerosCounts(Array<int> &arr, Array<int> &ou
   for (int i = 0; i < arr.length(); ++i) {
     out_post_non_zeros_count[i] = non_zeros_count - out_pre_non_zeros_count[i];
   }
-  return Array<int>{total_count, non_zeros_count};
+  out_total_count = total_count;
+  out_non_zeros_count = non_zeros_count;
 }
 
-PostOfficeResult PostOfficeSolver::BuildPostOffice(Array<int> &arr, int num, int non_zeros_count,
-                                                   Array<int> &pre_non_zeros_count, Array<int> &post_non_zeros_count) {
+PostOfficeResult PostOfficeSolver::BuildPostOffice(ArrayView<const int> arr, int num, int non_zeros_count,
+                                                   ArrayView<const int> pre_non_zeros_count,
+                                                   ArrayView<const int> post_non_zeros_count) {
   int original_num = num;
   num = std::min(num, non_zeros_count);
 
@@ -179,13 +184,13 @@ PostOfficeResult PostOfficeSolver::BuildPostOffice(Array<int> &arr, int num, int
         ++k;
       }
     }
-    office_positions = modifying_office_positions;
+    office_positions = std::move(modifying_office_positions);
   }
 
-  return {office_positions, temp_total_app_cost};
+  return {std::move(office_positions), temp_total_app_cost};
 }
 
-int PostOfficeSolver::WritePositions(Array<int> &positions, OutputBitStream *out) {
+int PostOfficeSolver::WritePositions(ArrayView<const int> positions, OutputBitStream *out) {
   int this_size = out->WriteInt(static_cast<int>(positions.length()), 5);
   for (const auto &position : positions)
     this_size += out->WriteInt(position, 6);
@@ -20,16 +20,19 @@ class PostOfficeSolver {
       6, 6, 6, 6, 6, 6, 6, 6
   };
 
-  static Array<int> InitRoundAndRepresentation(Array<int> &distribution, Array<int> &representation, Array<int> &round);
+  static Array<int> InitRoundAndRepresentation(ArrayView<const int> distribution, ArrayView<int> representation,
+                                               ArrayView<int> round);
 
-  static int WritePositions(Array<int> &positions, OutputBitStream *out);
+  static int WritePositions(ArrayView<const int> positions, OutputBitStream *out);
 
  private:
   constexpr static int kPow2z[] = {1, 2, 4, 8, 16, 32};
-  static Array<int> CalTotalCountAndNonZerosCounts(Array<int> &arr, Array<int> &out_pre_non_zeros_count,
-                                                   Array<int> &out_post_non_zeros_count);
-  static PostOfficeResult BuildPostOffice(Array<int> &arr, int num, int non_zeros_count,
-                                          Array<int> &pre_non_zeros_count, Array<int> &post_non_zeros_count);
+  static void CalTotalCountAndNonZerosCounts(ArrayView<const int> arr, ArrayView<int> out_pre_non_zeros_count,
+                                             ArrayView<int> out_post_non_zeros_count, int &out_total_count,
+                                             int &out_non_zeros_count);
+  static PostOfficeResult BuildPostOffice(ArrayView<const int> arr, int num, int non_zeros_count,
+                                          ArrayView<const int> pre_non_zeros_count,
+                                          ArrayView<const int> post_non_zeros_count);
 };
 
 #endif  // SERF_POST_OFFICE_SOLVER_H
@@ -0,0 +1,42 @@
+#ifndef SERF_XOR_RESIDUAL_CODEC_H
+#define SERF_XOR_RESIDUAL_CODEC_H
+
+#include <cstdint>
+
+#include "utils/output_bit_stream.h"
+#include "utils/input_bit_stream.h"
+
+/*
+ * Lossless residual of a prediction: the XOR of the IEEE-754 bits of the value
+ * and of its prediction. Stateless Gorilla-style layout:
+ *   0                                      exact prediction
+ *   1 | lead (6) | length - 1 (6) | bits   meaningful bits of the XOR
+ */
+class XorResidualCodec {
+ public:
+  static inline int Encode(uint64_t xor_value, OutputBitStream *output_bit_stream_ptr) {
+    if (xor_value == 0) return output_bit_stream_ptr->WriteBit(false);
+    int lead = __builtin_clzll(xor_value);
+    int trail = __builtin_ctzll(xor_value);
+    int length = 64 - lead - trail;
+    int compressed_size_in_bits = output_bit_stream_ptr->WriteBit(true);
+    compressed_size_in_bits += output_bit_stream_ptr->WriteInt(lead, 6);
+    compressed_size_in_bits += output_bit_stream_ptr->WriteInt(length - 1, 6);
+    compressed_size_in_bits += output_bit_stream_ptr->WriteLong(xor_value >> trail, length);
+    return compressed_size_in_bits;
+  }
+
+  static inline uint64_t Decode(InputBitStream *input_bit_stream_ptr) {
+    if (!input_bit_stream_ptr->ReadBit()) return 0;
+    int lead = input_bit_stream_ptr->ReadInt(6);
+    int length = input_bit_stream_ptr->ReadInt(6) + 1;
+    return input_bit_stream_ptr->ReadLong(length) << (64 - lead - length);
+  }
+
+  static inline int EstimateBits(uint64_t xor_value) {
+    if (xor_value == 0) return 1;
+    return 13 + 64 - __builtin_clzll(xor_value) - __builtin_ctzll(xor_value);
+  }
+};
+
+#endif  // SERF_XOR_RESIDUAL_CODEC_H